@@ -1,5 +1,112 @@
 #include "3Dmaths.hpp"
 
+#ifdef MATHS_SSE
+//Shuffle lanes x, y from a and z, w from b.
+#define SSE_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+
+//Load four consecutive Vec3s and transpose them into x, y and z lanes.
+static inline void sse_loadVec3x4(const Vec3* u, __m128& x, __m128& y, __m128& z){
+	const float* p = &u[0].x;
+	__m128 a = _mm_loadu_ps(p);		//x0 y0 z0 x1
+	__m128 b = _mm_loadu_ps(p + 4);	//y1 z1 x2 y2
+	__m128 c = _mm_loadu_ps(p + 8);	//z2 x3 y3 z3
+
+	x = SSE_SHUFFLE(a, SSE_SHUFFLE(b, c, 2, 2, 1, 1), 0, 3, 0, 2);
+	y = SSE_SHUFFLE(SSE_SHUFFLE(a, b, 1, 1, 0, 0), SSE_SHUFFLE(b, c, 3, 3, 2, 2), 0, 2, 0, 2);
+	z = SSE_SHUFFLE(SSE_SHUFFLE(a, b, 2, 2, 1, 1), c, 0, 2, 0, 3);
+}
+
+//Row combination r0 * x + r1 * y + r2 * z + r3 * w.
+static inline __m128 sse_combineRows(const float m[4][4], float x, float y, float z, float w){
+	__m128 r = _mm_mul_ps(_mm_loadu_ps(m[0]), _mm_set1_ps(x));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m[1]), _mm_set1_ps(y)));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m[2]), _mm_set1_ps(z)));
+	return _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m[3]), _mm_set1_ps(w)));
+}
+
+//Matrix product a * b into result. Same operation order as the scalar version.
+static inline void sse_multiply(const float a[4][4], const float b[4][4], float result[4][4]){
+	__m128 rows[4];
+	for(unsigned int i=0;i<4;i++){
+		rows[i] = sse_combineRows(b, a[i][0], a[i][1], a[i][2], a[i][3]);
+	}
+	for(unsigned int i=0;i<4;i++){
+		_mm_storeu_ps(result[i], rows[i]);
+	}
+}
+
+//2x2 matrix product a * b. Matrices are stored as row major in lanes.
+static inline __m128 sse_mat2Mul(__m128 a, __m128 b){
+	return _mm_add_ps(
+		_mm_mul_ps(a, SSE_SHUFFLE(b, b, 0, 3, 0, 3)),
+		_mm_mul_ps(SSE_SHUFFLE(a, a, 1, 0, 3, 2), SSE_SHUFFLE(b, b, 2, 1, 2, 1)));
+}
+
+//2x2 matrix product adjugate(a) * b.
+static inline __m128 sse_mat2AdjMul(__m128 a, __m128 b){
+	return _mm_sub_ps(
+		_mm_mul_ps(SSE_SHUFFLE(a, a, 3, 3, 0, 0), b),
+		_mm_mul_ps(SSE_SHUFFLE(a, a, 1, 1, 2, 2), SSE_SHUFFLE(b, b, 2, 3, 0, 1)));
+}
+
+//2x2 matrix product a * adjugate(b).
+static inline __m128 sse_mat2MulAdj(__m128 a, __m128 b){
+	return _mm_sub_ps(
+		_mm_mul_ps(a, SSE_SHUFFLE(b, b, 3, 0, 3, 0)),
+		_mm_mul_ps(SSE_SHUFFLE(a, a, 1, 0, 3, 2), SSE_SHUFFLE(b, b, 2, 1, 2, 1)));
+}
+
+//Inverse of a 4x4 matrix using 2x2 blocks.
+static inline void sse_inverse(const float m[4][4], float result[4][4]){
+	__m128 r0 = _mm_loadu_ps(m[0]);
+	__m128 r1 = _mm_loadu_ps(m[1]);
+	__m128 r2 = _mm_loadu_ps(m[2]);
+	__m128 r3 = _mm_loadu_ps(m[3]);
+
+	//Blocks A B / C D.
+	__m128 A = _mm_movelh_ps(r0, r1);
+	__m128 B = _mm_movehl_ps(r1, r0);
+	__m128 C = _mm_movelh_ps(r2, r3);
+	__m128 D = _mm_movehl_ps(r3, r2);
+
+	//Block determinants |A| |B| |C| |D|.
+	__m128 dets = _mm_sub_ps(
+		_mm_mul_ps(SSE_SHUFFLE(r0, r2, 0, 2, 0, 2), SSE_SHUFFLE(r1, r3, 1, 3, 1, 3)),
+		_mm_mul_ps(SSE_SHUFFLE(r0, r2, 1, 3, 1, 3), SSE_SHUFFLE(r1, r3, 0, 2, 0, 2)));
+	__m128 detA = SSE_SHUFFLE(dets, dets, 0, 0, 0, 0);
+	__m128 detB = SSE_SHUFFLE(dets, dets, 1, 1, 1, 1);
+	__m128 detC = SSE_SHUFFLE(dets, dets, 2, 2, 2, 2);
+	__m128 detD = SSE_SHUFFLE(dets, dets, 3, 3, 3, 3);
+
+	__m128 DC = sse_mat2AdjMul(D, C);
+	__m128 AB = sse_mat2AdjMul(A, B);
+
+	//Adjugates of the result blocks X Y / Z W.
+	__m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), sse_mat2Mul(B, DC));
+	__m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), sse_mat2Mul(C, AB));
+	__m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), sse_mat2MulAdj(D, AB));
+	__m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), sse_mat2MulAdj(A, DC));
+
+	//|M| = |A||D| + |B||C| - tr(AB * DC).
+	__m128 tr = _mm_mul_ps(AB, SSE_SHUFFLE(DC, DC, 0, 2, 1, 3));
+	tr = _mm_add_ps(tr, SSE_SHUFFLE(tr, tr, 2, 3, 0, 1));
+	tr = _mm_add_ps(tr, SSE_SHUFFLE(tr, tr, 1, 0, 3, 2));
+	__m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+
+	__m128 invDet = _mm_div_ps(_mm_setr_ps(1.0, -1.0, -1.0, 1.0), det);
+	X = _mm_mul_ps(X, invDet);
+	Y = _mm_mul_ps(Y, invDet);
+	Z = _mm_mul_ps(Z, invDet);
+	W = _mm_mul_ps(W, invDet);
+
+	//Undo the adjugates while storing.
+	_mm_storeu_ps(result[0], SSE_SHUFFLE(X, Y, 3, 1, 3, 1));
+	_mm_storeu_ps(result[1], SSE_SHUFFLE(X, Y, 2, 0, 2, 0));
+	_mm_storeu_ps(result[2], SSE_SHUFFLE(Z, W, 3, 1, 3, 1));
+	_mm_storeu_ps(result[3], SSE_SHUFFLE(Z, W, 2, 0, 2, 0));
+}
+#endif
+
 //Vec3 default constructor.
 Vec3::Vec3(){
 	x = 0;
@@ -95,6 +202,45 @@ Vec3 Vec3::interpolate(Vec3 u, Vec3 v, float t){
 	return u * (1 - time) + v * time;
 }
 
+//Batch Vec3 dot product.
+void Vec3::dot(const Vec3* u, const Vec3* v, float* result, unsigned int count){
+	unsigned int i = 0;
+#ifdef MATHS_SSE
+	__m128 ux, uy, uz, vx, vy, vz;
+	for(;i+4<=count;i+=4){
+		sse_loadVec3x4(&u[i], ux, uy, uz);
+		sse_loadVec3x4(&v[i], vx, vy, vz);
+		__m128 r = _mm_add_ps(_mm_mul_ps(ux, vx), _mm_mul_ps(uy, vy));
+		_mm_storeu_ps(&result[i], _mm_add_ps(r, _mm_mul_ps(uz, vz)));
+	}
+#endif
+	for(;i<count;i++){
+		result[i] = Vec3::dot(u[i], v[i]);
+	}
+}
+
+//Batch Vec3 cross product.
+void Vec3::cross(const Vec3* u, const Vec3* v, Vec3* result, unsigned int count){
+	unsigned int i = 0;
+#ifdef MATHS_SSE
+	__m128 ux, uy, uz, vx, vy, vz;
+	float x[4], y[4], z[4];
+	for(;i+4<=count;i+=4){
+		sse_loadVec3x4(&u[i], ux, uy, uz);
+		sse_loadVec3x4(&v[i], vx, vy, vz);
+		_mm_storeu_ps(x, _mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy)));
+		_mm_storeu_ps(y, _mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz)));
+		_mm_storeu_ps(z, _mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx)));
+		for(unsigned int j=0;j<4;j++){
+			result[i + j] = Vec3(x[j], y[j], z[j]);
+		}
+	}
+#endif
+	for(;i<count;i++){
+		result[i] = Vec3::cross(u[i], v[i]);
+	}
+}
+
 Vec3 Vec3::max(const Vec3 u, const Vec3 v){
 	return Vec3(std::max(u.x, v.x), std::max(u.y, v.y), std::max(u.z, v.z));
 }
@@ -182,34 +328,51 @@ Mat4::~Mat4(){
 
 //Mat4 operator *.
 Mat4 Mat4::operator*(const Mat4& b){
-	float a[16] = {};
+	Mat4 result;
+#ifdef MATHS_SSE
+	sse_multiply(m, b.m, result.m);
+#else
 	for(unsigned int i=0;i<4;i++){
 		for(unsigned int j=0;j<4;j++){
-			a[i * 4 + j] = m[i][0]*b.m[0][j] + m[i][1]*b.m[1][j] + m[i][2]*b.m[2][j] + m[i][3]*b.m[3][j]; 
+			result.m[i][j] = m[i][0]*b.m[0][j] + m[i][1]*b.m[1][j] + m[i][2]*b.m[2][j] + m[i][3]*b.m[3][j]; 
 		}
 	}
-	return Mat4(a);
+#endif
+	return result;
 }
 
 //Mat4 * Vec3
 Vec3 Mat4::operator*(const Vec3& u){
+#ifdef MATHS_SSE
+	float p[4];
+	_mm_storeu_ps(p, sse_combineRows(m, u.x, u.y, u.z, 1.0));
+	return Vec3(p[0], p[1], p[2]);
+#else
 	Vec3 a(0, 0, 0);
 	float* p = a.ptr();
 	for(unsigned int i=0;i<3;i++){
 		p[i] = m[0][i] * u.x + m[1][i] * u.y + m[2][i] * u.z + m[3][i];
 	}
 	return a;
+#endif
 }
 
 //Mat4 * Vec3 also calculates w
 Vec3 Mat4::transform(const Vec3& u, float W, float& w){
+#ifdef MATHS_SSE
+	float p[4];
+	_mm_storeu_ps(p, sse_combineRows(m, u.x, u.y, u.z, W));
+	w = p[3];
+	return Vec3(p[0], p[1], p[2]);
+#else
 	Vec3 a(0, 0, 0);
 	float* p = a.ptr();
 	for(unsigned int i=0;i<3;i++){
 		p[i] = m[0][i] * u.x + m[1][i] * u.y + m[2][i] * u.z + m[3][i] * W;
-		w = m[0][3] * u.x + m[1][3] * u.y + m[2][3] * u.z + m[3][3] * W;
 	}
+	w = m[0][3] * u.x + m[1][3] * u.y + m[2][3] * u.z + m[3][3] * W;
 	return a;
+#endif
 }
 
 //Mat4 * float.
@@ -334,17 +497,119 @@ Mat4 Mat4::transpose(const Mat4& M){
 	return Mat4(arr);
 }
 
+//Batch matrix multiplication result[i] = a[i] * b[i].
+void Mat4::multiply(const Mat4* a, const Mat4* b, Mat4* result, unsigned int count){
+	float r[4][4];
+	for(unsigned int n=0;n<count;n++){
+#ifdef MATHS_SSE
+		sse_multiply(a[n].m, b[n].m, r);
+#else
+		for(unsigned int i=0;i<4;i++){
+			for(unsigned int j=0;j<4;j++){
+				r[i][j] = a[n].m[i][0]*b[n].m[0][j] + a[n].m[i][1]*b[n].m[1][j] + a[n].m[i][2]*b[n].m[2][j] + a[n].m[i][3]*b[n].m[3][j];
+			}
+		}
+#endif
+		memcpy(result[n].m, r, 16 * sizeof(float));
+	}
+}
+
+//Batch transform of points by their own matrices result[i] = M[i] * u[i].
+void Mat4::transform(const Mat4* M, const Vec3* u, Vec3* result, unsigned int count){
+	for(unsigned int n=0;n<count;n++){
+#ifdef MATHS_SSE
+		float p[4];
+		_mm_storeu_ps(p, sse_combineRows(M[n].m, u[n].x, u[n].y, u[n].z, 1.0));
+		result[n] = Vec3(p[0], p[1], p[2]);
+#else
+		float p[3];
+		for(unsigned int i=0;i<3;i++){
+			p[i] = M[n].m[0][i] * u[n].x + M[n].m[1][i] * u[n].y + M[n].m[2][i] * u[n].z + M[n].m[3][i];
+		}
+		result[n] = Vec3(p[0], p[1], p[2]);
+#endif
+	}
+}
+
 //Standard matrix multiplication, but changes the current matrix.
 void Mat4::transform(const Mat4& M){
-	float a[16] = {};
+	float a[4][4];
+#ifdef MATHS_SSE
+	sse_multiply(m, M.m, a);
+#else
 	for(unsigned int i=0;i<4;i++){
 		for(unsigned int j=0;j<4;j++){
-			a[i * 4 + j] = m[i][0]*M.m[0][j] + m[i][1]*M.m[1][j] + m[i][2]*M.m[2][j] + m[i][3]*M.m[3][j]; 
+			a[i][j] = m[i][0]*M.m[0][j] + m[i][1]*M.m[1][j] + m[i][2]*M.m[2][j] + m[i][3]*M.m[3][j]; 
 		}
 	}
+#endif
 	memcpy(this->m, a, 16 * sizeof(float));
 }
 
+//Transform an array of points (w = 1).
+void Mat4::transform(const Vec3* u, Vec3* result, unsigned int count){
+	for(unsigned int n=0;n<count;n++){
+#ifdef MATHS_SSE
+		float p[4];
+		_mm_storeu_ps(p, sse_combineRows(m, u[n].x, u[n].y, u[n].z, 1.0));
+		result[n] = Vec3(p[0], p[1], p[2]);
+#else
+		float p[3];
+		for(unsigned int i=0;i<3;i++){
+			p[i] = m[0][i] * u[n].x + m[1][i] * u[n].y + m[2][i] * u[n].z + m[3][i];
+		}
+		result[n] = Vec3(p[0], p[1], p[2]);
+#endif
+	}
+}
+
+//Transform points stored as separate x, y and z arrays (w = 1).
+void Mat4::transform(const float* x, const float* y, const float* z, float* rx, float* ry, float* rz, unsigned int count){
+	unsigned int n = 0;
+#ifdef MATHS_SSE
+	for(;n+4<=count;n+=4){
+		__m128 vx = _mm_loadu_ps(&x[n]);
+		__m128 vy = _mm_loadu_ps(&y[n]);
+		__m128 vz = _mm_loadu_ps(&z[n]);
+		__m128 r[3];
+		for(unsigned int i=0;i<3;i++){
+			r[i] = _mm_mul_ps(_mm_set1_ps(m[0][i]), vx);
+			r[i] = _mm_add_ps(r[i], _mm_mul_ps(_mm_set1_ps(m[1][i]), vy));
+			r[i] = _mm_add_ps(r[i], _mm_mul_ps(_mm_set1_ps(m[2][i]), vz));
+			r[i] = _mm_add_ps(r[i], _mm_set1_ps(m[3][i]));
+		}
+		_mm_storeu_ps(&rx[n], r[0]);
+		_mm_storeu_ps(&ry[n], r[1]);
+		_mm_storeu_ps(&rz[n], r[2]);
+	}
+#endif
+	for(;n<count;n++){
+		float px = m[0][0] * x[n] + m[1][0] * y[n] + m[2][0] * z[n] + m[3][0];
+		float py = m[0][1] * x[n] + m[1][1] * y[n] + m[2][1] * z[n] + m[3][1];
+		float pz = m[0][2] * x[n] + m[1][2] * y[n] + m[2][2] * z[n] + m[3][2];
+		rx[n] = px;
+		ry[n] = py;
+		rz[n] = pz;
+	}
+}
+
+//Transform an array of points (w = 1) and divide the results by w.
+void Mat4::project(const Vec3* u, Vec3* result, unsigned int count){
+	for(unsigned int n=0;n<count;n++){
+#ifdef MATHS_SSE
+		float p[4];
+		__m128 r = sse_combineRows(m, u[n].x, u[n].y, u[n].z, 1.0);
+		_mm_storeu_ps(p, _mm_div_ps(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3))));
+		result[n] = Vec3(p[0], p[1], p[2]);
+#else
+		//W has to be written before it is read, so the divide is its own statement.
+		float w;
+		Vec3 r = transform(u[n], 1.0, w);
+		result[n] = r / w;
+#endif
+	}
+}
+
 //Transposes a matrix.
 void Mat4::transpose(){
 	float arr[4][4];
@@ -453,10 +718,16 @@ Mat4 Mat4::cofactor(){
 
 //Calculate inverse of matrix.
 Mat4 Mat4::inverse(){
+#ifdef MATHS_SSE
+	Mat4 result;
+	sse_inverse(m, result.m);
+	return result;
+#else
 	float det = determinant();
 	Mat4 cof = cofactor();
 	cof.transpose();
 	return cof * (1 / det);
+#endif
 }
 
 //Prints all values.
@@ -566,24 +837,19 @@ void Quat::normalize(){
 }
 
 //Make a rotation matrix out of the quat.
+//Expanded form of the product of the left and right multiplication matrices of the quat.
 Mat4 Quat::toMatrix(){
-	float arrA[16] = {
-		 w, z,-y, x,
-		-z, w, x, y,
-		 y,-x, w, z,
-		-x,-y,-z, w
-	};
-	Mat4 a = Mat4(arrA);
+	float ww = w * w, xx = x * x, yy = y * y, zz = z * z;
+	float wx = w * x, wy = w * y, wz = w * z;
+	float xy = x * y, xz = x * z, yz = y * z;
 
-	float arrB[16] = {
-		 w, z,-y,-x,
-		-z, w, x,-y,
-		 y,-x, w,-z,
-		 x, y, z, w
+	float a[16] = {
+		ww + xx - yy - zz, 2 * (xy + wz), 2 * (xz - wy), 0.0,
+		2 * (xy - wz), ww - xx + yy - zz, 2 * (yz + wx), 0.0,
+		2 * (xz + wy), 2 * (yz - wx), ww - xx - yy + zz, 0.0,
+		0.0, 0.0, 0.0, ww + xx + yy + zz
 	};
-	Mat4 b = Mat4(arrB);
-
-	return a * b;
+	return Mat4(a);
 }
 
 //Return pointer to the beginning of quat members.
@@ -5,6 +5,13 @@
 #include <cstring>
 #include <algorithm>
 
+//SSE kernels are used for Mat4 and batch Vec3 math when available.
+//Define MATHS_SCALAR to build the plain scalar versions instead.
+#if defined(__SSE__) && !defined(MATHS_SCALAR)
+	#define MATHS_SSE
+	#include <xmmintrin.h>
+#endif
+
 //A three dimentional vector.
 struct Vec3{
 	Vec3();
@@ -29,6 +36,10 @@ struct Vec3{
 	static Vec3 max(const Vec3 u, const Vec3 v);
 	static Vec3 min(const Vec3 u, const Vec3 v);
 
+	//Batch functions over arrays of count vectors.
+	static void dot(const Vec3* u, const Vec3* v, float* result, unsigned int count);
+	static void cross(const Vec3* u, const Vec3* v, Vec3* result, unsigned int count);
+
 	//Internal functions.
 	void normalize();
 	void makeMax(Vec3 u);
@@ -69,10 +80,17 @@ struct Mat4{
 
 	//Static functions
 	static Mat4 transpose(const Mat4& M);
+
+	//Batch functions over arrays of count elements. Results may alias the inputs.
+	static void multiply(const Mat4* a, const Mat4* b, Mat4* result, unsigned int count);
+	static void transform(const Mat4* M, const Vec3* u, Vec3* result, unsigned int count);
 	
 	//Internal functions
 	void transform(const Mat4& M);
 	Vec3 transform(const Vec3& u, float W, float& w);
+	void transform(const Vec3* u, Vec3* result, unsigned int count);
+	void transform(const float* x, const float* y, const float* z, float* rx, float* ry, float* rz, unsigned int count);
+	void project(const Vec3* u, Vec3* result, unsigned int count);
 	void transpose();
 
 	//Getters
@@ -196,93 +196,163 @@ Polyedge Polyface::getEdge(unsigned int edgei){
 	}
 }
 
-//Polytope constructor. For in use with the EPA algorithm.
-Polytope::Polytope(){
-	vertices.reserve(10);
-	faces.reserve(20);
-}
-
-//Re initialize the polytope.
+//Re initialize the polytope with a tetrahedron.
 void Polytope::reset(Vec3* points){
-	vertices.clear();
-	vertices.insert(vertices.end(), points, points+4);
+	for(unsigned int i=0;i<4;i++){
+		vertices[i] = points[i];
+	}
+	numVertices = 4;
+	numFaces = 0;
+	heapSize = 0;
+	numFree = 0;
+
+	addFace(0, 1, 2);
+	addFace(0, 3, 1);
+	addFace(0, 2, 3);
+	addFace(1, 3, 2);
+}
+
+//Make a face, find its plane and push it onto the heap. False when out of face slots.
+bool Polytope::addFace(unsigned int a, unsigned int b, unsigned int c){
+	unsigned int facei;
+	if(numFree > 0){
+		facei = freeFaces[--numFree];
+	}else if(numFaces < EPA_MAX_FACES){
+		facei = numFaces++;
+	}else{
+		return false;
+	}
 
-	faces.clear();
-	faces.push_back(Polyface(0, 1, 2));
-	faces.push_back(Polyface(0, 3, 1));
-	faces.push_back(Polyface(0, 2, 3));
-	faces.push_back(Polyface(1, 3, 2));
+	Polyface& face = faces[facei];
+	face.a = a;
+	face.b = b;
+	face.c = c;
+
+	Vec3 norm = Vec3::cross(vertices[b] - vertices[a], vertices[c] - vertices[a]);
+	float length = norm.length();
+	if(length > 0){
+		norm = norm * (1.0f / length);
+	}
+	float dist = Vec3::dot(norm, vertices[a]);
+	if(dist < 0){
+		norm = norm * (-1);
+		dist = dist * (-1);
+	}
+	face.normal = norm;
+	//Degenerate faces sort last instead of carrying a broken normal to the top.
+	face.distance = length > 0 ? dist : FLT_MAX;
+
+	heap[heapSize] = facei;
+	face.heapIndex = heapSize;
+	siftUp(heapSize++);
+	return true;
 }
 
-//Get a faces normal and distance form origin.
-void Polytope::faceNormal(unsigned int facei, Vec3& normal, float& distance){
-	Vec3 ab = vertices[faces[facei].b] - vertices[faces[facei].a];
-	Vec3 ac = vertices[faces[facei].c] - vertices[faces[facei].a];
+//Take a face off the heap and free its slot.
+void Polytope::removeFace(unsigned int facei){
+	unsigned int index = faces[facei].heapIndex;
+	unsigned int last = heap[--heapSize];
+	if(index < heapSize){
+		heap[index] = last;
+		faces[last].heapIndex = index;
+		siftDown(index);
+		siftUp(faces[last].heapIndex);
+	}
+	freeFaces[numFree++] = facei;
+}
 
-	Vec3 norm = Vec3::cross(ab, ac);
-	norm.normalize();
-	float dist = Vec3::dot(norm, vertices[faces[facei].a]);
+//Move a heap entry up while it is closer than its parent.
+void Polytope::siftUp(unsigned int index){
+	unsigned int facei = heap[index];
+	while(index > 0){
+		unsigned int parent = (index - 1) / 2;
+		if(faces[heap[parent]].distance <= faces[facei].distance){
+			break;
+		}
+		heap[index] = heap[parent];
+		faces[heap[index]].heapIndex = index;
+		index = parent;
+	}
+	heap[index] = facei;
+	faces[facei].heapIndex = index;
+}
 
-	if(dist < 0){
-		normal = norm * (-1);
-		distance = dist * (-1);
-	}else{
-		normal = norm;
-		distance = dist;
+//Move a heap entry down while a child is closer.
+void Polytope::siftDown(unsigned int index){
+	unsigned int facei = heap[index];
+	while(true){
+		unsigned int child = index * 2 + 1;
+		if(child >= heapSize){
+			break;
+		}
+		if(child + 1 < heapSize && faces[heap[child + 1]].distance < faces[heap[child]].distance){
+			child++;
+		}
+		if(faces[facei].distance <= faces[heap[child]].distance){
+			break;
+		}
+		heap[index] = heap[child];
+		faces[heap[index]].heapIndex = index;
+		index = child;
 	}
+	heap[index] = facei;
+	faces[facei].heapIndex = index;
 }
 
-//Determine the face closest to origin and get its normal and distance.
+//Get the face closest to origin with its normal and distance, the top of the heap.
 void Polytope::closestFace(unsigned int& facei, Vec3& normal, float& distance){
-	unsigned int topFacei = 0;
-	Vec3 norm, topNorm;
-	float dist, topDist;
-	faceNormal(0, topNorm, topDist);
-	for(unsigned int i=1;i<faces.size();i++){
-		faceNormal(i, norm, dist);
-		if(dist < topDist){
-			topFacei = i;
-			topNorm = norm;
-			topDist = dist;
+	facei = heap[0];
+	normal = faces[facei].normal;
+	distance = faces[facei].distance;
+}
+
+//Append a new point onto the polytope and repair all affected faces. Faces the point lies in front of are
+//removed and the hole is closed with faces from its border to the point. False when out of capacity.
+bool Polytope::expand(Vec3 point){
+	if(numVertices == EPA_MAX_VERTICES){
+		return false;
+	}
+
+	unsigned int visible[EPA_MAX_FACES];
+	unsigned int numVisible = 0;
+	for(unsigned int i=0;i<heapSize;i++){
+		Polyface& face = faces[heap[i]];
+		if(Vec3::dot(face.normal, point) > face.distance){
+			visible[numVisible++] = heap[i];
 		}
 	}
-	facei = topFacei;
-	normal = topNorm;
-	distance = topDist;
-}
+	if(numVisible == 0){
+		return false;
+	}
 
-//Append a new point onto the polygon and repair all affected faces.
-void Polytope::expand(Vec3 point){
-	Vec3 norm;
-	float dist;
-	Polyedge tempEdge;
-	std::vector<Polyedge> uniqueEdges;
-	uniqueEdges.reserve(12);
-	
-	for(int i=faces.size()-1;i>=0;i--){
-		faceNormal(i, norm, dist);
-		if(Vec3::dot(norm, point) > 0){
-			for(unsigned int j=0;j<3;j++){
-				tempEdge = faces[i].getEdge(j);
-				bool exists = false;
-				for(int k=uniqueEdges.size()-1;k>=0;k--){
-					if(Polyedge::isReverse(tempEdge, uniqueEdges[k])){
-						uniqueEdges.erase(uniqueEdges.begin() + k);
-						exists = true;
-					}
-				}
-				if(!exists){
-					uniqueEdges.push_back(tempEdge);
+	//Edges shared by two removed faces cancel out, the rest form the border of the hole.
+	Polyedge uniqueEdges[EPA_MAX_EDGES];
+	unsigned int numEdges = 0;
+	for(unsigned int i=0;i<numVisible;i++){
+		for(unsigned int j=0;j<3;j++){
+			Polyedge tempEdge = faces[visible[i]].getEdge(j);
+			bool exists = false;
+			for(unsigned int k=0;k<numEdges;k++){
+				if(Polyedge::isReverse(tempEdge, uniqueEdges[k])){
+					uniqueEdges[k] = uniqueEdges[--numEdges];
+					exists = true;
+					break;
 				}
 			}
-			faces.erase(faces.begin() + i);
+			if(!exists){
+				uniqueEdges[numEdges++] = tempEdge;
+			}
 		}
+		removeFace(visible[i]);
 	}
 
-	vertices.push_back(point);
-	for(unsigned int i=0;i<uniqueEdges.size();i++){
-		faces.push_back(Polyface(uniqueEdges[i].a, uniqueEdges[i].b, vertices.size()-1));
+	vertices[numVertices++] = point;
+	for(unsigned int i=0;i<numEdges;i++){
+		if(!addFace(uniqueEdges[i].a, uniqueEdges[i].b, numVertices - 1)){
+			return false;
+		}
 	}
+	return true;
 }
 
 //------------------------------------------------------------------------------------
@@ -300,6 +370,235 @@ bool AABB::intersect(AABB& a, AABB& b){
 		(a.min.z <= b.max.z && a.max.z >= b.min.z);
 }
 
+//Smallest AABB containing both AABBs.
+AABB AABB::combine(AABB& a, AABB& b){
+	return AABB(Vec3::min(a.min, b.min), Vec3::max(a.max, b.max));
+}
+
+//Grow AABB by margin in every direction.
+void AABB::expand(float margin){
+	min = min - Vec3(margin, margin, margin);
+	max = max + Vec3(margin, margin, margin);
+}
+
+//Center point of AABB.
+Vec3 AABB::center(){
+	return (min + max) * 0.5;
+}
+
+//------------------------------------------------------------------------------------
+
+//Frustum from a projection view matrix. The planes bound the volume the matrix maps into clip space.
+Frustum::Frustum(Mat4 projView){
+	for(unsigned int i=0;i<3;i++){
+		for(unsigned int j=0;j<2;j++){
+			float sign = j == 0 ? 1.0 : -1.0;
+			unsigned int plane = i * 2 + j;
+			a[plane] = projView.m[0][3] + projView.m[0][i] * sign;
+			b[plane] = projView.m[1][3] + projView.m[1][i] * sign;
+			c[plane] = projView.m[2][3] + projView.m[2][i] * sign;
+			d[plane] = projView.m[3][3] + projView.m[3][i] * sign;
+		}
+	}
+
+	//Normalized planes give distances, which the sphere test needs.
+	for(unsigned int i=0;i<6;i++){
+		float length = sqrt(a[i] * a[i] + b[i] * b[i] + c[i] * c[i]);
+		a[i] /= length;
+		b[i] /= length;
+		c[i] /= length;
+		d[i] /= length;
+	}
+}
+
+//Frustum intersect sphere. False only if the sphere is fully behind a plane.
+bool Frustum::intersect(Vec3 center, float radius){
+	for(unsigned int i=0;i<6;i++){
+		if(a[i] * center.x + b[i] * center.y + c[i] * center.z + d[i] < -radius){
+			return false;
+		}
+	}
+	return true;
+}
+
+//Frustum intersect AABB. Tests the box corner furthest along each plane normal.
+bool Frustum::intersect(AABB& box){
+	for(unsigned int i=0;i<6;i++){
+		float x = a[i] >= 0.0 ? box.max.x : box.min.x;
+		float y = b[i] >= 0.0 ? box.max.y : box.min.y;
+		float z = c[i] >= 0.0 ? box.max.z : box.min.z;
+		if(a[i] * x + b[i] * y + c[i] * z + d[i] < 0.0){
+			return false;
+		}
+	}
+	return true;
+}
+
+//Frustum contains AABB. Tests the box corner nearest along each plane normal.
+bool Frustum::contains(AABB& box){
+	for(unsigned int i=0;i<6;i++){
+		float x = a[i] >= 0.0 ? box.min.x : box.max.x;
+		float y = b[i] >= 0.0 ? box.min.y : box.max.y;
+		float z = c[i] >= 0.0 ? box.min.z : box.max.z;
+		if(a[i] * x + b[i] * y + c[i] * z + d[i] < 0.0){
+			return false;
+		}
+	}
+	return true;
+}
+
+//Frustum intersect spheres given as component arrays. Result is 1 for spheres touching the frustum, 0 otherwise.
+void Frustum::intersect(const float* x, const float* y, const float* z, const float* radius, Uint8* result, Uint32 count){
+	unsigned int n = 0;
+#ifdef MATHS_SSE
+	for(;n+4<=count;n+=4){
+		__m128 px = _mm_loadu_ps(&x[n]);
+		__m128 py = _mm_loadu_ps(&y[n]);
+		__m128 pz = _mm_loadu_ps(&z[n]);
+		__m128 r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[n]));
+		__m128 inside = _mm_cmpeq_ps(r, r);
+		for(unsigned int i=0;i<6;i++){
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(a[i])), _mm_mul_ps(py, _mm_set1_ps(b[i]))),
+				_mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(c[i])), _mm_set1_ps(d[i])));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, r));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for(unsigned int i=0;i<4;i++){
+			result[n + i] = (mask >> i) & 1;
+		}
+	}
+#endif
+	for(;n<count;n++){
+		result[n] = intersect(Vec3(x[n], y[n], z[n]), radius[n]);
+	}
+}
+
+//Frustum intersect AABBs given as component arrays. Result is 1 for boxes touching the frustum, 0 otherwise.
+void Frustum::intersect(const float* minX, const float* minY, const float* minZ,
+	const float* maxX, const float* maxY, const float* maxZ, Uint8* result, Uint32 count){
+
+	unsigned int n = 0;
+#ifdef MATHS_SSE
+	for(;n+4<=count;n+=4){
+		__m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+		for(unsigned int i=0;i<6;i++){
+			//The furthest corner only depends on the plane, so every lane reads the same side.
+			__m128 px = _mm_loadu_ps(a[i] >= 0.0 ? &maxX[n] : &minX[n]);
+			__m128 py = _mm_loadu_ps(b[i] >= 0.0 ? &maxY[n] : &minY[n]);
+			__m128 pz = _mm_loadu_ps(c[i] >= 0.0 ? &maxZ[n] : &minZ[n]);
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(a[i])), _mm_mul_ps(py, _mm_set1_ps(b[i]))),
+				_mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(c[i])), _mm_set1_ps(d[i])));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for(unsigned int i=0;i<4;i++){
+			result[n + i] = (mask >> i) & 1;
+		}
+	}
+#endif
+	for(;n<count;n++){
+		AABB box(Vec3(minX[n], minY[n], minZ[n]), Vec3(maxX[n], maxY[n], maxZ[n]));
+		result[n] = intersect(box);
+	}
+}
+
+//------------------------------------------------------------------------------------
+
+//Build the tree top down by splitting convexes at the median of the longest axis.
+void AABBTree::build(BoundingConvex* convexes, unsigned int numConvexes){
+	nodes.clear();
+	indices.clear();
+	if(numConvexes == 0){
+		return;
+	}
+
+	std::vector<AABB> boxes;
+	boxes.reserve(numConvexes);
+	indices.reserve(numConvexes);
+	for(unsigned int i=0;i<numConvexes;i++){
+		boxes.push_back(convexes[i].createBox());
+		indices.push_back(i);
+	}
+
+	nodes.reserve(numConvexes * 2);
+	split(boxes.data(), 0, numConvexes);
+}
+
+//Create a node for a range of indices and recursively split it. Returns the index of the node.
+Uint32 AABBTree::split(AABB* boxes, Uint32 first, Uint32 count){
+	Uint32 nodei = nodes.size();
+	nodes.push_back(AABBNode());
+
+	AABB box = boxes[indices[first]];
+	AABB centers(box.center(), box.center());
+	for(unsigned int i=first+1;i<first+count;i++){
+		box = AABB::combine(box, boxes[indices[i]]);
+		centers.min.makeMin(boxes[indices[i]].center());
+		centers.max.makeMax(boxes[indices[i]].center());
+	}
+	nodes[nodei].box = box;
+
+	if(count <= AABB_TREE_LEAF_SIZE){
+		nodes[nodei].left = 0;
+		nodes[nodei].right = 0;
+		nodes[nodei].first = first;
+		nodes[nodei].count = count;
+		return nodei;
+	}
+
+	Vec3 extent = centers.max - centers.min;
+	unsigned int axis = 0;
+	if(extent.y > extent.x){axis = 1;}
+	if(extent.z > extent.ptr()[axis]){axis = 2;}
+
+	Uint32 half = count / 2;
+	std::nth_element(indices.begin() + first, indices.begin() + first + half, indices.begin() + first + count,
+		[boxes, axis](Uint32 a, Uint32 b){
+			return boxes[a].center().ptr()[axis] < boxes[b].center().ptr()[axis];
+		}
+	);
+
+	Uint32 left = split(boxes, first, half);
+	Uint32 right = split(boxes, first + half, count - half);
+
+	nodes[nodei].left = left;
+	nodes[nodei].right = right;
+	nodes[nodei].first = 0;
+	nodes[nodei].count = 0;
+	return nodei;
+}
+
+//Collect the indices of all convexes whose AABB overlaps the given AABB.
+//Result is sorted so contacts resolve in the same order as a linear scan would.
+void AABBTree::query(AABB& box, std::vector<Uint32>& result){
+	result.clear();
+	if(nodes.empty()){
+		return;
+	}
+
+	Uint32 stack[AABB_TREE_STACK_SIZE];
+	unsigned int top = 0;
+	stack[top++] = 0;
+
+	while(top > 0){
+		AABBNode& node = nodes[stack[--top]];
+		if(!AABB::intersect(node.box, box)){
+			continue;
+		}
+
+		if(node.count > 0){
+			for(unsigned int i=0;i<node.count;i++){
+				result.push_back(indices[node.first + i]);
+			}
+		}else{
+			stack[top++] = node.left;
+			stack[top++] = node.right;
+		}
+	}
+
+	std::sort(result.begin(), result.end());
+}
+
 //------------------------------------------------------------------------------------
 
 //Sphere collider
@@ -348,6 +647,17 @@ Vec3 SweptSphere::furthest(Vec3 direction){
 	}
 }
 
+//AABB containing both spheres of the sweep.
+AABB SweptSphere::createBox(){
+	Vec3 extent0(colliders[0].radius, colliders[0].radius, fabs(colliders[0].radius * colliders[0].verticalAspect));
+	AABB box0(colliders[0].center - extent0, colliders[0].center + extent0);
+
+	Vec3 extent1(colliders[1].radius, colliders[1].radius, fabs(colliders[1].radius * colliders[1].verticalAspect));
+	AABB box1(colliders[1].center - extent1, colliders[1].center + extent1);
+
+	return AABB::combine(box0, box1);
+}
+
 BoundingSphere* SweptSphere::getNext(){
 	return &colliders[toggle];
 }
@@ -365,14 +675,55 @@ void SweptSphere::swapSpheres(){
 
 //------------------------------------------------------------------------------------
 
+//Swept convex collider.
+SweptConvex::SweptConvex(BoundingConvex* shape, Vec3 position){
+	this->shape = shape;
+	bounds = shape->createBox();
+	positions[0] = position;
+	positions[1] = position;
+	toggle = 1;
+}
+
+//Swept convex furthest point, from whichever end of the sweep reaches further.
+Vec3 SweptConvex::furthest(Vec3 direction){
+	Vec3 position = Vec3::dot(direction, positions[0]) >= Vec3::dot(direction, positions[1]) ? positions[0] : positions[1];
+	return shape->furthest(direction) + position;
+}
+
+//Create an AABB for the swept convex.
+AABB SweptConvex::createBox(){
+	AABB box0(bounds.min + positions[0], bounds.max + positions[0]);
+	AABB box1(bounds.min + positions[1], bounds.max + positions[1]);
+	return AABB::combine(box0, box1);
+}
+
+Vec3* SweptConvex::getNext(){
+	return &positions[toggle];
+}
+
+Vec3* SweptConvex::getPrev(){
+	return &positions[(1 - toggle)];
+}
+
+void SweptConvex::swapPositions(){
+	toggle = 1 - toggle;
+}
+
+//------------------------------------------------------------------------------------
+
 //Convex collider.
 BoundingConvex::BoundingConvex(Vec3* start, unsigned int numVertices){
 	vertices = start;
 	this->numVertices = numVertices;
 }
 
-//Convex furthest point.
+//Convex furthest point. Climbs from the seed when the convex has adjacency.
 Vec3 BoundingConvex::furthest(Vec3 direction){
+	if(neighbors != nullptr){
+		Uint16 start = seed;
+		return furthest(direction, start);
+	}
+
 	float dist = Vec3::dot(direction, vertices[0]);
 	float topDist = dist;
 	unsigned int top = 0;
@@ -386,6 +737,206 @@ Vec3 BoundingConvex::furthest(Vec3 direction){
 	return vertices[top];
 }
 
+//Support point found by climbing to neighbors further along the direction until none is. On a convex hull
+//the first vertex without a better neighbor is the furthest. When a neighbor is as far within rounding, the
+//top is flat and could end on any of its vertices, so every vertex is scanned for the first furthest one.
+//Either way the vertex found does not depend on the start. Start is updated to it.
+Vec3 BoundingConvex::furthest(Vec3 direction, Uint16& start){
+	if(neighbors == nullptr){
+		return furthest(direction);
+	}
+
+	Uint32 current = offsets[start] == offsets[start + 1] ? seed : start;
+	float topDist = Vec3::dot(direction, vertices[current]);
+	float nextDist = -FLT_MAX;	//Furthest neighbor of the top once nothing moves.
+	bool moved = true;
+	while(moved){
+		moved = false;
+		nextDist = -FLT_MAX;
+		Uint32 first = offsets[current], end = offsets[current + 1];
+		for(unsigned int i=first;i<end;i++){
+			float dist = Vec3::dot(direction, vertices[neighbors[i]]);
+			if(dist > topDist){
+				topDist = dist;
+				current = neighbors[i];
+				moved = true;
+			}else{
+				nextDist = std::max(nextDist, dist);
+			}
+		}
+	}
+
+	Vec3 top = vertices[current];
+	float tolerance = (fabs(direction.x * top.x) + fabs(direction.y * top.y) + fabs(direction.z * top.z)) * 1e-5f;
+	if(nextDist >= topDist - tolerance){
+		for(unsigned int i=0;i<numVertices;i++){
+			float dist = Vec3::dot(direction, vertices[i]);
+			if(dist > topDist || (dist == topDist && i < current)){
+				topDist = dist;
+				current = i;
+			}
+		}
+	}
+	start = current;
+	return vertices[current];
+}
+
+//Hull face used while building adjacency. The normal faces out of the hull.
+struct HullFace{
+	Uint32 a, b, c;
+	Vec3 normal;
+	float distance;
+};
+
+//Face through three points with its plane.
+static HullFace hullFace(Vec3* vertices, Uint32 a, Uint32 b, Uint32 c){
+	HullFace face = {a, b, c, Vec3::cross(vertices[b] - vertices[a], vertices[c] - vertices[a]), 0.0};
+	float length = face.normal.length();
+	face.normal = length > 0 ? face.normal * (1.0f / length) : face.normal;
+	face.distance = Vec3::dot(face.normal, vertices[a]);
+	return face;
+}
+
+//Find the hull of a convex's vertices by adding them one by one, the way EPA grows its polytope, and append
+//the neighbors of every vertex along the hull edges. Appends numVertices + 1 offsets, counted from the
+//convex's first neighbor, and as many neighbors as the hull has. Returns false, appending nothing, for flat
+//or degenerate point sets and for convexes with more vertices than neighbors can index.
+bool BoundingConvex::buildAdjacency(Vec3* vertices, Uint32 numVertices, std::vector<Uint32>& offsets, std::vector<Uint16>& neighbors){
+	if(numVertices < 4 || numVertices > 65536){
+		return false;
+	}
+
+	//Tolerance relative to the size of the convex, so points on a face count as inside.
+	AABB box = BoundingConvex(vertices, numVertices).createBox();
+	Vec3 extent = box.max - box.min;
+	float epsilon = std::max(std::max(extent.x, extent.y), extent.z) * 1e-5f;
+
+	//Start from a tetrahedron spanning the points as widely as found cheaply.
+	Uint32 a = 0, b = 0, c = 0, d = 0;
+	for(unsigned int i=1;i<numVertices;i++){
+		if(vertices[i].x < vertices[a].x){a = i;}
+	}
+	float top = 0.0;
+	for(unsigned int i=0;i<numVertices;i++){
+		float dist = (vertices[i] - vertices[a]).length();
+		if(dist > top){top = dist; b = i;}
+	}
+	top = 0.0;
+	for(unsigned int i=0;i<numVertices;i++){
+		float dist = Vec3::cross(vertices[b] - vertices[a], vertices[i] - vertices[a]).length();
+		if(dist > top){top = dist; c = i;}
+	}
+	HullFace base = hullFace(vertices, a, b, c);
+	top = 0.0;
+	for(unsigned int i=0;i<numVertices;i++){
+		float dist = fabs(Vec3::dot(base.normal, vertices[i]) - base.distance);
+		if(dist > top){top = dist; d = i;}
+	}
+	if(top <= epsilon){
+		return false;
+	}
+	if(Vec3::dot(base.normal, vertices[d]) > base.distance){
+		std::swap(b, c);
+	}
+
+	std::vector<HullFace> faces = {hullFace(vertices, a, b, c), hullFace(vertices, a, d, b),
+		hullFace(vertices, b, d, c), hullFace(vertices, c, d, a)};
+	std::vector<HullFace> kept;
+	std::vector<Polyedge> horizon;
+	for(unsigned int i=0;i<numVertices;i++){
+		if(i == a || i == b || i == c || i == d){
+			continue;
+		}
+
+		//Faces the point is in front of are replaced by faces from their border to the point.
+		kept.clear();
+		horizon.clear();
+		for(unsigned int j=0;j<faces.size();j++){
+			HullFace& face = faces[j];
+			if(Vec3::dot(face.normal, vertices[i]) - face.distance <= epsilon){
+				kept.push_back(face);
+				continue;
+			}
+			Polyedge edges[3] = {Polyedge(face.a, face.b), Polyedge(face.b, face.c), Polyedge(face.c, face.a)};
+			for(unsigned int k=0;k<3;k++){
+				bool exists = false;
+				for(unsigned int l=0;l<horizon.size();l++){
+					if(Polyedge::isReverse(edges[k], horizon[l])){
+						horizon[l] = horizon.back();
+						horizon.pop_back();
+						exists = true;
+						break;
+					}
+				}
+				if(!exists){
+					horizon.push_back(edges[k]);
+				}
+			}
+		}
+		if(horizon.empty()){
+			continue;
+		}
+		for(unsigned int j=0;j<horizon.size();j++){
+			kept.push_back(hullFace(vertices, horizon[j].a, horizon[j].b, i));
+		}
+		faces.swap(kept);
+	}
+
+	//Every hull edge is in two faces, once in each direction, so each face adds its edges one way.
+	std::vector<std::vector<Uint16>> adjacent(numVertices);
+	for(unsigned int i=0;i<faces.size();i++){
+		adjacent[faces[i].a].push_back(faces[i].b);
+		adjacent[faces[i].b].push_back(faces[i].c);
+		adjacent[faces[i].c].push_back(faces[i].a);
+	}
+	Uint32 count = 0;
+	for(unsigned int i=0;i<numVertices;i++){
+		offsets.push_back(count);
+		neighbors.insert(neighbors.end(), adjacent[i].begin(), adjacent[i].end());
+		count += adjacent[i].size();
+	}
+	offsets.push_back(count);
+	return true;
+}
+
+//Support point of a convex, warm started from the last one found.
+Vec3 WarmConvex::furthest(Vec3 direction){
+	return convex.furthest(direction, start);
+}
+
+//True when the last query separated the pair by more than the collider has moved since, given the centers
+//of both ends of its sweep. The swept shape reaches no further than the old one by the distance from each
+//end to the nearest old one, whichever end of the sweep each is now, and the convex does not move.
+bool CachedContact::separated(Vec3 first, Vec3 second){
+	if(gjk.separation <= 0){
+		return false;
+	}
+	float motion = std::max(std::min((first - centers[0]).length(), (first - centers[1]).length()),
+		std::min((second - centers[0]).length(), (second - centers[1]).length()));
+	return gjk.separation > motion + CONTACT_CACHE_MARGIN;
+}
+
+//Remember where the collider was for the query being made.
+void CachedContact::anchor(Vec3 first, Vec3 second){
+	centers[0] = first;
+	centers[1] = second;
+}
+
+//Last query on a convex. Convexes not remembered take a slot with nothing known about them.
+CachedContact& ContactCache::find(BoundingConvex& convex){
+	for(unsigned int i=0;i<CONTACT_CACHE_SIZE;i++){
+		if(contacts[i].convex == &convex){
+			return contacts[i];
+		}
+	}
+	CachedContact& contact = contacts[next];
+	next = (next + 1) % CONTACT_CACHE_SIZE;
+	contact.convex = &convex;
+	contact.vertex = convex.seed;
+	contact.gjk = GjkCache();
+	return contact;
+}
+
 //Create an approximate AABB for convex.
 AABB BoundingConvex::createBox(){
 	Vec3 min = vertices[0];
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <cfloat>
 
 #include "3Dmaths.hpp"
 #include "loaders.hpp"
@@ -11,12 +12,30 @@
 #define GJK_THRESHOLD 0.1
 #define EPA_THRESHOLD 0.1
 
+//Polytope capacity. Each iteration adds a point, and a closed convex triangle mesh of n points has 2n - 4 faces.
+#define EPA_MAX_VERTICES (4 + EPA_MAX_ITER)
+#define EPA_MAX_FACES (2 * EPA_MAX_VERTICES - 4)
+#define EPA_MAX_EDGES (3 * EPA_MAX_FACES)		//Horizon edges gathered from the faces seen by a new point.
+
+#define CONVEX_CLIMB_MIN_VERTICES 32	//Smaller convexes find support points by scanning every vertex.
+#define CONTACT_CACHE_SIZE 16			//Convexes a body remembers its last query on.
+#define CONTACT_CACHE_MARGIN 0.05		//Gap a cached separation must keep before it rejects a pair. Stretched spheres
+										//reach up to 4% of their radius past their furthest point, so less proves nothing.
+
+#define AABB_TREE_LEAF_SIZE 4
+#define AABB_TREE_STACK_SIZE 64
+
 //AABB collider for broad checks
 struct AABB{
+	AABB(){};
 	AABB(Vec3 min, Vec3 max);
 	~AABB(){};
 
 	static bool intersect(AABB& a, AABB& b);
+	static AABB combine(AABB& a, AABB& b);
+
+	void expand(float margin);
+	Vec3 center();
 
 	Vec3 min, max;
 };
@@ -41,6 +60,7 @@ struct SweptSphere{
 	~SweptSphere(){};
 
 	Vec3 furthest(Vec3 direction);
+	AABB createBox();
 	BoundingSphere* getNext();
 	BoundingSphere* getPrev();
 	void swapSpheres();
@@ -49,17 +69,129 @@ struct SweptSphere{
 	Uint8 toggle;
 };
 
-//Convex collider for GJK / EPA
+//Convex collider for GJK / EPA. Convexes with adjacency find support points by hill climbing along the
+//edges of their hull, from the vertex found last or from a hull vertex. Others scan every vertex.
 struct BoundingConvex{
 	BoundingConvex(){};
 	BoundingConvex(Vec3* start, unsigned int numVertices);
 	~BoundingConvex(){};
 
+	static bool buildAdjacency(Vec3* vertices, Uint32 numVertices, std::vector<Uint32>& offsets, std::vector<Uint16>& neighbors);
+
 	Vec3 furthest(Vec3 direction);
+	Vec3 furthest(Vec3 direction, Uint16& start);
 	AABB createBox();
 
 	Vec3* vertices;
 	unsigned int numVertices;
+	Uint32* offsets = nullptr;		//Range of neighbors of every vertex, null without adjacency.
+	Uint16* neighbors = nullptr;	//Hull neighbors of every vertex. Vertices inside the hull have none.
+	Uint16 seed = 0;				//A vertex on the hull to start climbing from.
+};
+
+//Swept convex that moves without turning. The shape's vertices are around the body's origin.
+struct SweptConvex{
+	SweptConvex(){};
+	SweptConvex(BoundingConvex* shape, Vec3 position);
+	~SweptConvex(){};
+
+	Vec3 furthest(Vec3 direction);
+	AABB createBox();
+	Vec3* getNext();
+	Vec3* getPrev();
+	void swapPositions();
+
+	BoundingConvex* shape;
+	AABB bounds;		//Box of the shape around the origin.
+	Vec3 positions[2];
+	Uint8 toggle;
+};
+
+//A convex together with the vertex a body found last on it, so support searches start close to the answer.
+struct WarmConvex{
+	WarmConvex(BoundingConvex& convex, Uint16& start) : convex(convex), start(start){};
+	~WarmConvex(){};
+
+	Vec3 furthest(Vec3 direction);
+
+	BoundingConvex& convex;
+	Uint16& start;
+};
+
+//What a GJK query found about the gap between a pair. The separating axis is kept as proof: while the
+//support point along it still separates the pair, the next query ends there. That holds whatever was cached
+//before, and queries it does not settle run from initDir as a first one would.
+struct GjkCache{
+	GjkCache(){};
+	~GjkCache(){};
+
+	Vec3 axis = Vec3(0, 0, 0);	//Last separating axis, zero when the pair touched.
+	float separation = 0.0;		//Gap along the separating axis when last separated, 0 when touching.
+	Uint32 iterations = 0;		//Support points the last query took.
+};
+
+//A body's last query on one convex.
+struct CachedContact{
+	CachedContact(){};
+	~CachedContact(){};
+
+	bool separated(Vec3 first, Vec3 second);
+	void anchor(Vec3 first, Vec3 second);
+
+	BoundingConvex* convex = nullptr;
+	Uint16 vertex = 0;	//Last support vertex on the convex, where climbs start.
+	GjkCache gjk;
+	Vec3 centers[2];	//Centers of both ends of the collider's sweep at the last query.
+};
+
+//Last queries of a body on the convexes near it, replaced round robin.
+struct ContactCache{
+	ContactCache(){};
+	~ContactCache(){};
+
+	CachedContact& find(BoundingConvex& convex);
+
+	CachedContact contacts[CONTACT_CACHE_SIZE];
+	Uint32 next = 0;
+};
+
+//View frustum as six inward facing planes a*x + b*y + c*z + d >= 0, for culling against a camera or light.
+//Tests are conservative: shapes near a corner outside the frustum may still pass.
+struct Frustum{
+	Frustum(){};
+	Frustum(Mat4 projView);
+	~Frustum(){};
+
+	bool intersect(Vec3 center, float radius);
+	bool intersect(AABB& box);
+	bool contains(AABB& box);
+	void intersect(const float* x, const float* y, const float* z, const float* radius, Uint8* result, Uint32 count);
+	void intersect(const float* minX, const float* minY, const float* minZ,
+		const float* maxX, const float* maxY, const float* maxZ, Uint8* result, Uint32 count);
+
+	float a[6], b[6], c[6], d[6];
+};
+
+//Node of a static AABB tree. Leaves point to a range of the trees index list.
+struct AABBNode{
+	AABB box;
+	Uint32 left, right;		//Child nodes. Unused in leaves.
+	Uint32 first, count;	//Range of indices in leaves. Count is 0 for inner nodes.
+};
+
+//Static AABB tree over convexes for broad phase queries.
+struct AABBTree{
+	AABBTree(){};
+	void build(BoundingConvex* convexes, unsigned int numConvexes);
+	~AABBTree(){};
+
+	void query(AABB& box, std::vector<Uint32>& result);
+
+	private:
+	Uint32 split(AABB* boxes, Uint32 first, Uint32 count);
+
+	std::vector<AABBNode> nodes;
+	std::vector<Uint32> indices;
 };
 
 //GJK Simplex
@@ -99,7 +231,7 @@ struct Polyedge{
 	unsigned int a, b;
 };
 
-//EPA Face
+//EPA Face. Its plane is found once, when the face is made.
 struct Polyface{
 	Polyface(){};
 	Polyface(unsigned int a, unsigned int b, unsigned int c);
@@ -108,21 +240,35 @@ struct Polyface{
 	Polyedge getEdge(unsigned int edgei);
 
 	unsigned int a, b, c;
+	Vec3 normal;			//Unit normal facing away from the origin.
+	float distance;			//Distance of the face's plane from the origin.
+	unsigned int heapIndex;	//Position in the polytope's face heap.
 };
 
-//EPA Polytope
+//EPA Polytope in fixed storage, so it lives on the stack of the EPA call. Faces sit in a min-heap on their
+//distance, so the closest is always at the top. Slots of faces removed by an expansion are reused.
 struct Polytope{
-	Polytope();
+	Polytope(){};
 	~Polytope(){};
 
 	void reset(Vec3* points);
-	void faceNormal(unsigned int facei, Vec3& normal, float& distance);
 	void closestFace(unsigned int& facei, Vec3& normal, float& distance);
-	void expand(Vec3 point);
+	bool expand(Vec3 point);
 
 	private:
-	std::vector<Vec3> vertices;
-	std::vector<Polyface> faces;
+	bool addFace(unsigned int a, unsigned int b, unsigned int c);
+	void removeFace(unsigned int facei);
+	void siftUp(unsigned int index);
+	void siftDown(unsigned int index);
+
+	Vec3 vertices[EPA_MAX_VERTICES];
+	Polyface faces[EPA_MAX_FACES];
+	unsigned int heap[EPA_MAX_FACES];		//Face indices ordered by distance.
+	unsigned int freeFaces[EPA_MAX_FACES];	//Face slots left by removed faces.
+	unsigned int numVertices = 0;
+	unsigned int numFaces = 0;				//Face slots ever used.
+	unsigned int heapSize = 0;
+	unsigned int numFree = 0;
 };
 
 //GJK support point function.
@@ -151,7 +297,9 @@ void epa(Simplex& simplex, T& a, U& b, Vec3& normal, float& distance){
 			&& dot < dist + EPA_THRESHOLD){
 			break;
 		}
-		polytope.expand(newPoint);
+		if(!polytope.expand(newPoint)){
+			break;
+		}
 	}
 	normal = norm * (-1);
 	distance = dist;
@@ -180,26 +328,62 @@ bool gjk(T& a, U& b, Vec3 initDir = Vec3(1, 0, 0)){
 	return false;
 }
 
-//GJK collision detection function.
+//GJK collision detection function, first trying the separating axis in cache. A support point along it
+//that still separates the pair by CONTACT_CACHE_MARGIN proves them apart. Separated pairs store the axis and
+//the gap along it.
 template<typename T, typename U>
-bool gjk(T& a, U& b, Vec3& normal, float& distance, Vec3 initDir = Vec3(1, 0, 0)){
+bool gjk(T& a, U& b, Vec3& normal, float& distance, Vec3 initDir, GjkCache& cache){
 	Simplex simplex;
 
+	cache.iterations = 0;
+	if(cache.axis.length() > 0){
+		Vec3 certificate = support(a, b, cache.axis);
+		cache.iterations++;
+		float gap = -Vec3::dot(certificate, cache.axis) / cache.axis.length();
+		if(gap > CONTACT_CACHE_MARGIN){
+			cache.separation = gap;
+			return false;
+		}
+	}
+
 	Vec3 direction = initDir;
 	Vec3 newPoint = support(a, b, direction);
+	cache.iterations++;
+	if(Vec3::dot(newPoint, direction) < 0){
+		cache.axis = direction;
+		cache.separation = -Vec3::dot(newPoint, direction) / direction.length();
+		return false;
+	}
 	simplex.append(newPoint);
 
 	direction = newPoint * (-1);
 
 	for(unsigned int i=0;i<GJK_MAX_ITER;i++){
 		newPoint = support(a, b, direction);
-		if(Vec3::dot(newPoint, direction) <= 0){return false;}
+		cache.iterations++;
+		if(Vec3::dot(newPoint, direction) <= 0){
+			float length = direction.length();
+			cache.axis = direction;
+			cache.separation = length > 0 ? -Vec3::dot(newPoint, direction) / length : 0.0f;
+			return false;
+		}
 
 		if(simplex.expand(newPoint, direction)){
 			epa(simplex, a, b, normal, distance);
+			cache.axis = Vec3(0, 0, 0);
+			cache.separation = 0.0;
 			return true;
 		}
 	}
 
+	cache.axis = Vec3(0, 0, 0);
+	cache.separation = 0.0;
 	return false;
 }
+
+//GJK collision detection function.
+template<typename T, typename U>
+bool gjk(T& a, U& b, Vec3& normal, float& distance, Vec3 initDir = Vec3(1, 0, 0)){
+	GjkCache cache;
+	return gjk(a, b, normal, distance, initDir, cache);
+}
@@ -0,0 +1,91 @@
+//Benchmark: memory and decode cost of compressed animation clips against the raw joint format.
+//Raw clips hold ten floats per bone on every frame and decode by copying a frame into the pose streams.
+//Compressed clips keep the keyframes, tracks and quantized rotations the loader leaves. Decode times are per
+//bone of a keyframe, error is the largest joint matrix difference over the clip sampled at every frame.
+
+#include "models.hpp"
+
+#include <chrono>
+#include <vector>
+#include <cstdio>
+
+#define BENCH_REPEATS 20
+#define BENCH_DECODES 10000
+
+typedef std::chrono::steady_clock BenchClock;
+
+//Copy a frame of interleaved joints into pose streams, as the raw format decodes.
+static void decodeRaw(const float* joints, Uint32 jointFloats, Uint32 frame, Pose& pose){
+	pose.identity();
+	for(unsigned int i=0;i<pose.numBones;i++){
+		const float* joint = &joints[(frame * pose.numBones + i) * jointFloats];
+		for(unsigned int c=0;c<jointFloats;c++){
+			pose.channels[c * pose.stride + i] = joint[c];
+		}
+	}
+}
+
+//Nanoseconds per bone of the best run.
+template<typename Function> static double perBone(Function function, Uint32 numBones){
+	double best = 1e9;
+	for(unsigned int r=0;r<BENCH_REPEATS;r++){
+		auto start = BenchClock::now();
+		for(unsigned int i=0;i<BENCH_DECODES;i++){
+			function(i);
+		}
+		best = std::min(best, std::chrono::duration<double, std::nano>(BenchClock::now() - start).count());
+	}
+	return best / BENCH_DECODES / numBones;
+}
+
+int main(){
+	const char* clips[5] = {"res/animation_demo.ad", "res/test_walk_newer_0.ad", "res/test_inflate.ad",
+		"res/animated_multi_test.ad", "res/animation_test_3b.ad"};
+
+	printf("Best of %u. Bytes per clip, ns per bone of a decoded keyframe:\n", BENCH_REPEATS);
+	printf("%-28s %6s %5s %5s %11s %7s %7s %6s %7s %7s %10s\n", "clip", "frames", "bones", "keys", "tracks t/r/s",
+		"raw B", "clip B", "ratio", "raw ns", "clip ns", "max error");
+	for(unsigned int c=0;c<5;c++){
+		AnimationLoader file(clips[c]);
+		if(!file.loaded || file.compressed){
+			printf("%-28s needs an uncompressed file\n", clips[c]);
+			continue;
+		}
+		Uint32 numBones = file.numBones;
+		Uint32 rawBytes = file.numFrames * numBones * file.jointFloats * sizeof(float);
+		Uint32 clipBytes = file.clip.size;
+		char tracks[32];
+		snprintf(tracks, sizeof(tracks), "%u/%u/%u", file.clip.numTracks[0], file.clip.numTracks[1], file.clip.numTracks[2]);
+
+		Animation* anim = new Animation;
+		anim->init(file);
+
+		std::vector<float> storage(POSE_FLOATS(numBones));
+		Pose pose;
+		pose.init(numBones, storage.data());
+		double rawNs = perBone([&](Uint32 i){
+			decodeRaw(file.animation, file.jointFloats, i % file.numFrames, pose);
+		}, numBones);
+		double clipNs = perBone([&](Uint32 i){
+			anim->decode(i % anim->clip.numKeys, pose);
+		}, numBones);
+
+		//Reference palettes straight from the raw frames.
+		std::vector<Mat4> expected(numBones), palette(numBones);
+		float maxError = 0.0;
+		for(unsigned int f=0;f<file.numFrames;f++){
+			decodeRaw(file.animation, file.jointFloats, f, pose);
+			pose.toMatrices(expected.data());
+			anim->calcJointTransforms(palette.data(), f / (24.0f / anim->animRate));
+			for(unsigned int j=0;j<numBones;j++){
+				for(unsigned int k=0;k<16;k++){
+					maxError = std::max(maxError, fabsf(expected[j].m[k / 4][k % 4] - palette[j].m[k / 4][k % 4]));
+				}
+			}
+		}
+
+		printf("%-28s %6u %5u %5u %11s %7u %7u %5.1f%% %7.2f %7.2f %10.2e\n", clips[c], file.numFrames, numBones,
+			anim->clip.numKeys, tracks, rawBytes, clipBytes, 100.0 * clipBytes / rawBytes, rawNs, clipNs, maxError);
+	}
+	return 0;
+}
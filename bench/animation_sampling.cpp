@@ -0,0 +1,112 @@
+//Benchmark: cost of a joint palette for the clip sampling paths.
+//Compares per bone slerp over the file's interleaved joints, as animations were sampled before, with the
+//compressed clip decoded into channel streams and interpolated four bones at a time, and with the player
+//blending a cross-fade and an additive layer on top. Also reports the largest matrix difference between the old and new sampling.
+
+#include "models.hpp"
+
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#define BENCH_REPEATS 20
+#define BENCH_POSES 1000
+
+typedef std::chrono::steady_clock BenchClock;
+
+//Joint palette from interleaved joints, with a slerp per bone.
+static void referencePose(Joint* joints, Uint32 numFrames, Uint32 numBones, Uint32 animRate, float time, Mat4* result){
+	float frameTime = time * (24.0 / animRate);
+	double keyIndex = 0;
+	float fraction = modf(frameTime, &keyIndex);
+	Uint32 last = std::min((Uint32)keyIndex, numFrames - 1) * numBones;
+	Uint32 next = std::min((Uint32)keyIndex + 1, numFrames - 1) * numBones;
+
+	for(unsigned int i=0;i<numBones;i++){
+		Vec3 position = Vec3::interpolate(joints[last + i].translation, joints[next + i].translation, fraction);
+		Quat rotation = Quat::slerp(joints[last + i].rotation, joints[next + i].rotation, fraction);
+		Vec3 scale = Vec3::interpolate(joints[last + i].scaling, joints[next + i].scaling, fraction);
+		result[i] = Mat4::scale(scale) * rotation.toMatrix() * Mat4::translation(position);
+	}
+}
+
+//Nanoseconds per pose of the best run.
+template<typename Function> static double perPose(Function function){
+	double best = 1e9;
+	for(unsigned int r=0;r<BENCH_REPEATS;r++){
+		auto start = BenchClock::now();
+		for(unsigned int i=0;i<BENCH_POSES;i++){
+			function(i);
+		}
+		best = std::min(best, std::chrono::duration<double, std::nano>(BenchClock::now() - start).count());
+	}
+	return best / BENCH_POSES;
+}
+
+int main(){
+	const char* clips[3] = {"res/animation_demo.ad", "res/test_walk_newer_0.ad", "res/test_inflate.ad"};
+	Animation* anims[3];
+	for(unsigned int i=0;i<3;i++){
+		anims[i] = new Animation;
+		if(!anims[i]->init(clips[i])){
+			printf("Could not load %s\n", clips[i]);
+			return 1;
+		}
+	}
+
+	printf("Best of %u, ns per pose:\n", BENCH_REPEATS);
+	printf("%-28s %6s %9s %9s %9s %9s %10s\n", "clip", "bones", "slerp", "streams", "fade", "+layer", "max error");
+	for(unsigned int c=0;c<3;c++){
+		Animation& anim = *anims[c];
+		//Interleaved joints as the file holds them, older files leave out the scale.
+		AnimationLoader file(clips[c]);
+		Uint32 jointFloats = file.jointFloats;
+		std::vector<Joint> interleaved(anim.numFrames * anim.numBones);
+		for(unsigned int i=0;i<interleaved.size();i++){
+			float values[ANIM_CHANNELS] = {0, 0, 0, 1, 0, 0, 0, 1, 1, 1};
+			memcpy(values, &file.animation[i * jointFloats], jointFloats * sizeof(float));
+			interleaved[i].translation = Vec3(values[0], values[1], values[2]);
+			interleaved[i].rotation = Quat(values[3], values[4], values[5], values[6]);
+			interleaved[i].scaling = Vec3(values[7], values[8], values[9]);
+		}
+		Joint* joints = interleaved.data();
+		std::vector<Mat4> expected(anim.numBones), palette(anim.numBones);
+
+		float maxError = 0.0;
+		for(unsigned int i=0;i<BENCH_POSES;i++){
+			float time = anim.duration * i / BENCH_POSES;
+			referencePose(joints, anim.numFrames, anim.numBones, anim.animRate, time, expected.data());
+			anim.calcJointTransforms(palette.data(), time);
+			for(unsigned int j=0;j<anim.numBones;j++){
+				for(unsigned int k=0;k<16;k++){
+					maxError = std::max(maxError, fabsf(expected[j].m[k / 4][k % 4] - palette[j].m[k / 4][k % 4]));
+				}
+			}
+		}
+
+		double slerpNs = perPose([&](Uint32 i){
+			referencePose(joints, anim.numFrames, anim.numBones, anim.animRate, anim.duration * i / BENCH_POSES, expected.data());
+		});
+		double streamNs = perPose([&](Uint32 i){
+			anim.calcJointTransforms(palette.data(), anim.duration * i / BENCH_POSES);
+		});
+
+		AnimationPlayer player;
+		player.play(anims[(c + 1) % 3]);
+		player.update(0.1);
+		player.play(&anim, 1e6);	//Still fading for every run.
+		double fadeNs = perPose([&](Uint32 i){
+			player.update(0.001);
+			player.calcJointTransforms(palette.data(), anim.numBones);
+		});
+		player.playLayer(0, anims[(c + 2) % 3], 0.5);
+		double layerNs = perPose([&](Uint32 i){
+			player.update(0.001);
+			player.calcJointTransforms(palette.data(), anim.numBones);
+		});
+
+		printf("%-28s %6u %9.1f %9.1f %9.1f %9.1f %10.2e\n", clips[c], anim.numBones, slerpNs, streamNs, fadeNs, layerNs, maxError);
+	}
+	return 0;
+}
@@ -0,0 +1,205 @@
+//Benchmark: load time and peak resident memory of the level assets.
+//Compares the mapped loaders against the old ifstream + malloc path.
+//Each load runs in a forked process so peak RSS is measured in isolation.
+
+#include "models.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define BENCH_REPEATS 5
+
+//Old loading path: every section read into its own heap buffer.
+namespace reference{
+	//Old StaticModelLoader. Returns a checksum of what would be uploaded to GL.
+	static float loadStaticModel(const char* filename){
+		std::ifstream file(filename, std::ios::in|std::ios::binary);
+		if(!file.is_open()){return 0.0;}
+
+		Uint32 attribLength, texWidth, texHeight, texDepth, diffColorsLength, diffIndicesLength, metalRoughLength;
+		float centroid[3];
+		float cullRadius;
+
+		file.read((char*)&attribLength, 4);
+		float* attributes = (float*)malloc(attribLength);
+		file.read((char*)attributes, attribLength);
+
+		file.read((char*)&texWidth, 4);
+		file.read((char*)&texHeight, 4);
+		file.read((char*)&texDepth, 4);
+
+		file.read((char*)&diffColorsLength, 4);
+		float* diffColors = (float*)malloc(diffColorsLength);
+		file.read((char*)diffColors, diffColorsLength);
+
+		file.read((char*)&diffIndicesLength, 4);
+		Uint16* diffIndices = (Uint16*)malloc(diffIndicesLength);
+		file.read((char*)diffIndices, diffIndicesLength);
+
+		file.read((char*)&metalRoughLength, 4);
+		float* metalRough = (float*)malloc(metalRoughLength);
+		file.read((char*)metalRough, metalRoughLength);
+
+		file.read((char*)centroid, 12);
+		file.read((char*)&cullRadius, 4);
+
+		Uint32 numTexels = texWidth * texHeight * texDepth;
+		float* diffuse = (float*)malloc(numTexels * 4 * sizeof(float));
+		for(unsigned int i=0;i<numTexels;i++){
+			memcpy(&diffuse[i*4], &diffColors[diffIndices[i]*4], 4 * sizeof(float));
+		}
+		free(diffColors);
+		free(diffIndices);
+
+		float sum = 0.0;
+		for(unsigned int i=0;i<attribLength/4;i++){sum += attributes[i];}
+		for(unsigned int i=0;i<numTexels*4;i++){sum += diffuse[i];}
+		for(unsigned int i=0;i<metalRoughLength/4;i++){sum += metalRough[i];}
+
+		free(attributes);
+		free(diffuse);
+		free(metalRough);
+		return sum;
+	}
+
+	//Old PhysicsMeshLoader followed by the copies PhysicsMesh::init made.
+	static float loadPhysicsMesh(const char* filename){
+		std::ifstream file(filename, std::ios::in|std::ios::binary);
+		if(!file.is_open()){return 0.0;}
+
+		Uint32 numConvexes, vertsLength, indsLength;
+		file.read((char*)&numConvexes, 4);
+		file.read((char*)&vertsLength, 4);
+		float* fileVertices = (float*)malloc(vertsLength);
+		file.read((char*)fileVertices, vertsLength);
+		file.read((char*)&indsLength, 4);
+		Uint16* fileIndices = (Uint16*)malloc(indsLength);
+		file.read((char*)fileIndices, indsLength);
+
+		Vec3* vertices = (Vec3*)malloc(vertsLength);
+		memcpy(vertices, fileVertices, vertsLength);
+		Uint16* indices = (Uint16*)malloc(indsLength);
+		memcpy(indices, fileIndices, indsLength);
+		free(fileVertices);
+		free(fileIndices);
+
+		float sum = 0.0;
+		for(unsigned int i=0;i<vertsLength/12;i++){sum += vertices[i].x;}
+
+		free(vertices);
+		free(indices);
+		return sum;
+	}
+};
+
+//Mapped loading path. Returns a checksum of what would be uploaded to GL.
+static float loadStaticModel(const char* filename){
+	StaticModelLoader file(filename);
+	if(!file.loaded){return 0.0;}
+
+	Uint32 numTexels = file.texWidth * file.texHeight * file.texDepth;
+	float sum = 0.0;
+	for(unsigned int i=0;i<file.attribLength/4;i++){sum += file.attributes[i];}
+	for(unsigned int i=0;i<numTexels*4;i++){sum += file.diffuse[i];}
+	for(unsigned int i=0;i<file.metalRoughLength/4;i++){sum += file.metalRough[i];}
+	return sum;
+}
+
+static float loadPhysicsMesh(const char* filename){
+	PhysicsMesh mesh;
+	if(!mesh.init(filename)){return 0.0;}
+
+	float sum = 0.0;
+	for(unsigned int i=0;i<mesh.numConvexes;i++){
+		for(unsigned int j=0;j<mesh.convexes[i].numVertices;j++){
+			sum += mesh.convexes[i].vertices[j].x;
+		}
+	}
+	return sum;
+}
+
+//Read a value in kB from /proc/self/status.
+static long readStatus(const char* key){
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while(std::getline(status, line)){
+		if(line.compare(0, strlen(key), key) == 0){
+			return atol(line.c_str() + strlen(key));
+		}
+	}
+	return 0;
+}
+
+//Run a load in a child process. Reports milliseconds and peak RSS growth in kB.
+static void measure(float (*load)(const char*), const char* filename, double& ms, long& peakKb){
+	int pipes[2];
+	if(pipe(pipes) != 0){return;}
+
+	pid_t pid = fork();
+	if(pid == 0){
+		close(pipes[0]);
+
+		//Reset the peak RSS counter.
+		std::ofstream clear("/proc/self/clear_refs");
+		clear<<"5";
+		clear.close();
+
+		long before = readStatus("VmRSS:");
+		auto start = std::chrono::steady_clock::now();
+		volatile float sum = load(filename);
+		auto end = std::chrono::steady_clock::now();
+		long peak = readStatus("VmHWM:");
+
+		double result[2] = {std::chrono::duration<double, std::milli>(end - start).count(), (double)(peak - before)};
+		if(write(pipes[1], result, sizeof(result)) != sizeof(result)){_exit(1);}
+		_exit(sum == sum ? 0 : 1);
+	}
+
+	close(pipes[1]);
+	double result[2] = {0.0, 0.0};
+	if(read(pipes[0], result, sizeof(result)) != sizeof(result)){
+		std::cout<<"WARNING: Measurement failed for "<<filename<<std::endl;
+	}
+	close(pipes[0]);
+	waitpid(pid, nullptr, 0);
+
+	ms = result[0];
+	peakKb = (long)result[1];
+}
+
+//Best of several runs. The first run also warms the page cache.
+static void report(const char* name, float (*oldLoad)(const char*), float (*newLoad)(const char*), const char* filename){
+	double oldMs = 1e9, newMs = 1e9, ms;
+	long oldKb = 0, newKb = 0, kb;
+	for(unsigned int i=0;i<BENCH_REPEATS;i++){
+		measure(oldLoad, filename, ms, kb);
+		oldMs = std::min(oldMs, ms);
+		oldKb = std::max(oldKb, kb);
+		measure(newLoad, filename, ms, kb);
+		newMs = std::min(newMs, ms);
+		newKb = std::max(newKb, kb);
+	}
+
+	std::ifstream file(filename, std::ios::in|std::ios::binary|std::ios::ate);
+	long sizeKb = file.is_open() ? (long)file.tellg() / 1024 : 0;
+
+	printf("%-26s %8ld %10.3f %10.3f %10ld %10ld\n", name, sizeKb, oldMs, newMs, oldKb, newKb);
+}
+
+int main(){
+	const char* levels[2] = {"res/castle_level", "res/tech_demo"};
+
+	printf("%-26s %8s %10s %10s %10s %10s\n", "asset", "file kB", "old ms", "mapped ms", "old kB", "mapped kB");
+	for(unsigned int i=0;i<2;i++){
+		std::string sm = std::string(levels[i]) + ".sm";
+		std::string pm = std::string(levels[i]) + ".pm";
+		report(sm.c_str(), reference::loadStaticModel, loadStaticModel, sm.c_str());
+		report(pm.c_str(), reference::loadPhysicsMesh, loadPhysicsMesh, pm.c_str());
+	}
+
+	return 0;
+}
@@ -0,0 +1,148 @@
+//Benchmark: clustered light assignment against light count.
+//Generates scenes of random pointlights over the castle level and reports the CPU time of
+//binning them, how many lights a shaded cluster visits compared to the full light loop, and
+//the frame time of the level with those lights when a GL context is available.
+
+#include "renderer.hpp"
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdio>
+
+#define BENCH_REPEATS 200
+#define BENCH_FRAMES 60
+#define BENCH_WARMUP_FRAMES 10
+
+typedef std::chrono::steady_clock BenchClock;
+
+//Camera used for both the CPU and the GL runs.
+static const Vec3 camPosition(-4.0, 30.0, 3.0);
+static const float camYaw = 1.5708;
+static const float camPitch = -0.1;
+
+//Random pointlights spread over the castle level.
+static std::vector<Pointlight> generateLights(Uint32 count, Uint32 seed){
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> x(-40.0, 30.0), y(10.0, 85.0), z(1.0, 12.0);
+	std::uniform_real_distribution<float> radius(3.0, 10.0), color(0.0, 3.0);
+
+	std::vector<Pointlight> lights(count);
+	for(unsigned int i=0;i<count;i++){
+		lights[i].position = Vec3(x(rng), y(rng), z(rng));
+		lights[i].radius = radius(rng);
+		lights[i].diffuse = Vec3(color(rng), color(rng), color(rng));
+	}
+	return lights;
+}
+
+//Milliseconds since start.
+static double since(BenchClock::time_point start){
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+//Time the CPU binning of a scene and print the cluster statistics.
+static void benchBinning(const std::vector<Pointlight>& lights, Mat4 view, Mat4 proj, float near, float far){
+	Uint32 count = lights.size();
+	std::vector<float> x(count), y(count), z(count), radius(count);
+	for(unsigned int i=0;i<count;i++){
+		x[i] = lights[i].position.x;
+		y[i] = lights[i].position.y;
+		z[i] = lights[i].position.z;
+		radius[i] = lights[i].radius;
+	}
+
+	FrameArena arena;
+	arena.init(256 * 1024);
+	LightClusters clusters;
+
+	double best = 1e9;
+	for(unsigned int i=0;i<BENCH_REPEATS;i++){
+		auto start = BenchClock::now();
+		clusters.build(view, proj, near, far, x.data(), y.data(), z.data(), radius.data(), count, 0, arena);
+		best = std::min(best, since(start));
+		if(i + 1 < BENCH_REPEATS){
+			arena.reset();
+		}
+	}
+
+	Uint32 numShaded = 0, mostLights = 0;
+	for(unsigned int i=0;i<NUM_CLUSTERS;i++){
+		Uint32 numLights = clusters.cells[i * 2 + 1] & 0xFFFF;
+		if(numLights > 0){
+			numShaded++;
+			mostLights = std::max(mostLights, numLights);
+		}
+	}
+
+	printf("%8u %10.3f %10u %12.2f %12u\n", count, best * 1000.0, clusters.numIndices,
+		numShaded ? (double)clusters.numIndices / numShaded : 0.0, mostLights);
+}
+
+int main(){
+	const Uint32 lightCounts[6] = {16, 64, 128, 256, 512, 1024};
+	float near = 0.1, far = 100.0;
+
+	Vec3 direction(cos(camYaw) * cos(camPitch), sin(camYaw) * cos(camPitch), sin(camPitch));
+	Mat4 view = Mat4::lookAt(camPosition, Vec3(camPosition) + direction, Vec3(0.0, 0.0, 1.0));
+	Mat4 proj = Mat4::perspective(1.7, 16.0 / 9.0, near, far);
+
+	//Without clusters every pixel visits every light.
+	printf("Binning %u clusters, best of %u:\n", NUM_CLUSTERS, BENCH_REPEATS);
+	printf("%8s %10s %10s %12s %12s\n", "lights", "build us", "indices", "avg/cluster", "max/cluster");
+	for(unsigned int i=0;i<6;i++){
+		benchBinning(generateLights(lightCounts[i], i), view, proj, near, far);
+	}
+	printf("\n");
+
+	if(SDL_Init(SDL_INIT_VIDEO) != 0){
+		printf("No GL context (%s), frame times skipped.\n", SDL_GetError());
+		return 0;
+	}
+
+	RendererSettings settings;
+	settings.windowFlags = SDL_WINDOW_HIDDEN;
+	settings.windowVsync = 0;
+	settings.rendererMaxPointlights = lightCounts[5];
+	settings.cameraNear = near;
+	settings.cameraFar = far;
+
+	Renderer* renderer = new Renderer;
+	if(renderer->init(settings) != 0){
+		printf("No GL context, frame times skipped.\n");
+		return 0;
+	}
+
+	StaticModel* level = new StaticModel;
+	level->init("res/castle_level.sm");
+
+	renderer->uniforms.common.camPosition = camPosition;
+	renderer->setCameraView(camYaw, camPitch);
+	renderer->uniforms.lights.sun.direction = Vec3(1.0, 0.5, 2.0);
+	renderer->uniforms.lights.sun.ambient = Vec3(0.4, 0.4, 0.5);
+
+	printf("Frame time of the castle level, mean of %u frames:\n", BENCH_FRAMES);
+	printf("%8s %10s\n", "lights", "frame ms");
+	for(unsigned int i=0;i<6;i++){
+		std::vector<Pointlight> lights = generateLights(lightCounts[i], i);
+
+		double total = 0.0;
+		for(unsigned int frame=0;frame<BENCH_WARMUP_FRAMES+BENCH_FRAMES;frame++){
+			auto start = BenchClock::now();
+			for(unsigned int j=0;j<lights.size();j++){
+				renderer->pushLight(lights[j]);
+			}
+			renderer->drawModel(level, Mat4::identity());
+			renderer->displayFrame();
+			glFinish();
+			if(frame >= BENCH_WARMUP_FRAMES){
+				total += since(start);
+			}
+		}
+		printf("%8u %10.3f\n", lightCounts[i], total / BENCH_FRAMES);
+	}
+
+	delete level;
+	delete renderer;
+	return 0;
+}
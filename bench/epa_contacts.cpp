@@ -0,0 +1,218 @@
+//Benchmark: contact generation with the fixed storage EPA against the vector based one it replaced.
+//Collects swept spheres overlapping convexes of a physics mesh, then times GJK with EPA on every pair.
+//The old polytope is kept here as it was: vectors sized per contact, an edge vector per expansion,
+//faces erased from the middle and every face normal recomputed to find the closest. Separated counts the
+//contacts whose push out along the returned normal and depth clears the convex.
+
+#include "models.hpp"
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include <cstdio>
+
+#define BENCH_REPEATS 20
+#define BENCH_CONTACTS 4000
+
+typedef std::chrono::steady_clock BenchClock;
+
+//EPA polytope before fixed storage.
+struct ReferencePolytope{
+	ReferencePolytope(){
+		vertices.reserve(10);
+		faces.reserve(20);
+	}
+
+	void reset(Vec3* points){
+		vertices.assign(points, points + 4);
+		faces.clear();
+		faces.push_back(Polyface(0, 1, 2));
+		faces.push_back(Polyface(0, 3, 1));
+		faces.push_back(Polyface(0, 2, 3));
+		faces.push_back(Polyface(1, 3, 2));
+	}
+
+	void faceNormal(unsigned int facei, Vec3& normal, float& distance){
+		Vec3 ab = vertices[faces[facei].b] - vertices[faces[facei].a];
+		Vec3 ac = vertices[faces[facei].c] - vertices[faces[facei].a];
+		Vec3 norm = Vec3::cross(ab, ac);
+		norm.normalize();
+		float dist = Vec3::dot(norm, vertices[faces[facei].a]);
+		normal = dist < 0 ? norm * (-1) : norm;
+		distance = fabs(dist);
+	}
+
+	void closestFace(Vec3& normal, float& distance){
+		Vec3 norm;
+		float dist;
+		faceNormal(0, normal, distance);
+		for(unsigned int i=1;i<faces.size();i++){
+			faceNormal(i, norm, dist);
+			if(dist < distance){
+				normal = norm;
+				distance = dist;
+			}
+		}
+	}
+
+	void expand(Vec3 point){
+		Vec3 norm;
+		float dist;
+		std::vector<Polyedge> uniqueEdges;
+		uniqueEdges.reserve(12);
+		for(int i=faces.size()-1;i>=0;i--){
+			faceNormal(i, norm, dist);
+			if(Vec3::dot(norm, point) > 0){
+				for(unsigned int j=0;j<3;j++){
+					Polyedge tempEdge = faces[i].getEdge(j);
+					bool exists = false;
+					for(int k=uniqueEdges.size()-1;k>=0;k--){
+						if(Polyedge::isReverse(tempEdge, uniqueEdges[k])){
+							uniqueEdges.erase(uniqueEdges.begin() + k);
+							exists = true;
+						}
+					}
+					if(!exists){
+						uniqueEdges.push_back(tempEdge);
+					}
+				}
+				faces.erase(faces.begin() + i);
+			}
+		}
+		vertices.push_back(point);
+		for(unsigned int i=0;i<uniqueEdges.size();i++){
+			faces.push_back(Polyface(uniqueEdges[i].a, uniqueEdges[i].b, vertices.size() - 1));
+		}
+	}
+
+	std::vector<Vec3> vertices;
+	std::vector<Polyface> faces;
+};
+
+//GJK followed by the old EPA.
+static bool referenceContact(SweptSphere& a, BoundingConvex& b, Vec3& normal, float& distance){
+	Simplex simplex;
+	Vec3 direction(1, 0, 0);
+	Vec3 newPoint = support(a, b, direction);
+	simplex.append(newPoint);
+	direction = newPoint * (-1);
+
+	for(unsigned int i=0;i<GJK_MAX_ITER;i++){
+		newPoint = support(a, b, direction);
+		if(Vec3::dot(newPoint, direction) <= 0){return false;}
+		if(simplex.expand(newPoint, direction)){
+			ReferencePolytope polytope;
+			polytope.reset(simplex.ptr());
+			Vec3 norm;
+			float dist;
+			for(unsigned int j=0;j<EPA_MAX_ITER;j++){
+				polytope.closestFace(norm, dist);
+				newPoint = support(a, b, norm);
+				float dot = Vec3::dot(norm, newPoint);
+				if(dist - EPA_THRESHOLD < dot && dot < dist + EPA_THRESHOLD){
+					break;
+				}
+				polytope.expand(newPoint);
+			}
+			normal = norm * (-1);
+			distance = dist;
+			return true;
+		}
+	}
+	return false;
+}
+
+//True when pushing the sphere out along the contact leaves it clear of the convex.
+static bool separates(SweptSphere sphere, BoundingConvex& convex, Vec3 normal, float distance){
+	for(unsigned int i=0;i<2;i++){
+		sphere.colliders[i].center = sphere.colliders[i].center + normal * (distance + 0.01f);
+	}
+	return !gjk(sphere, convex);
+}
+
+struct Contact{
+	SweptSphere sphere;
+	Uint32 convex;
+};
+
+//Contacts per second of the best run.
+template<typename Function> static double contactsPerSecond(std::vector<Contact>& contacts, Function function){
+	double best = 1e9;
+	for(unsigned int r=0;r<BENCH_REPEATS;r++){
+		auto start = BenchClock::now();
+		for(unsigned int i=0;i<contacts.size();i++){
+			function(contacts[i]);
+		}
+		best = std::min(best, std::chrono::duration<double>(BenchClock::now() - start).count());
+	}
+	return contacts.size() / best;
+}
+
+int main(int argc, const char* argv[]){
+	const char* filename = argc > 1 ? argv[1] : "res/tech_demo.pm";
+	PhysicsMesh mesh;
+	if(!mesh.init(filename) || mesh.numConvexes == 0){
+		printf("Could not load %s\n", filename);
+		return 1;
+	}
+
+	AABB bounds = mesh.convexes[0].createBox();
+	for(unsigned int i=1;i<mesh.numConvexes;i++){
+		AABB box = mesh.convexes[i].createBox();
+		bounds = AABB::combine(bounds, box);
+	}
+
+	//Player sized spheres scattered over the mesh, kept where they overlap a convex.
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(0.0, 1.0);
+	std::vector<Contact> contacts;
+	std::vector<Uint32> candidates;
+	Vec3 size = bounds.max - bounds.min;
+	for(unsigned int attempt=0;attempt<BENCH_CONTACTS * 100 && contacts.size()<BENCH_CONTACTS;attempt++){
+		Vec3 center = bounds.min + Vec3(size.x * unit(random), size.y * unit(random), size.z * unit(random));
+		Contact contact;
+		contact.sphere = SweptSphere(center, 1.2, 1.65);
+		contact.sphere.getNext()->center = center + Vec3(unit(random) - 0.5f, unit(random) - 0.5f, -unit(random) * 0.5f);
+		AABB box = contact.sphere.createBox();
+		mesh.tree.query(box, candidates);
+		for(unsigned int i=0;i<candidates.size() && contacts.size()<BENCH_CONTACTS;i++){
+			if(gjk(contact.sphere, mesh.convexes[candidates[i]])){
+				contact.convex = candidates[i];
+				contacts.push_back(contact);
+			}
+		}
+	}
+
+	//Both versions on every contact, for how far their answers are apart.
+	float maxDepth = 0.0, maxAngle = 0.0, meanDepth = 0.0;
+	Uint32 separated = 0, oldSeparated = 0;
+	for(unsigned int i=0;i<contacts.size();i++){
+		Vec3 normal, oldNormal;
+		float distance = 0.0, oldDistance = 0.0;
+		gjk(contacts[i].sphere, mesh.convexes[contacts[i].convex], normal, distance);
+		referenceContact(contacts[i].sphere, mesh.convexes[contacts[i].convex], oldNormal, oldDistance);
+		separated += separates(contacts[i].sphere, mesh.convexes[contacts[i].convex], normal, distance);
+		oldSeparated += separates(contacts[i].sphere, mesh.convexes[contacts[i].convex], oldNormal, oldDistance);
+		maxDepth = std::max(maxDepth, (float)fabs(distance - oldDistance));
+		meanDepth += fabs(distance - oldDistance) / contacts.size();
+		maxAngle = std::max(maxAngle, (float)acos(std::min(Vec3::dot(normal, oldNormal), 1.0f)));
+	}
+
+	double oldRate = contactsPerSecond(contacts, [&](Contact& contact){
+		Vec3 normal;
+		float distance;
+		referenceContact(contact.sphere, mesh.convexes[contact.convex], normal, distance);
+	});
+	double newRate = contactsPerSecond(contacts, [&](Contact& contact){
+		Vec3 normal;
+		float distance;
+		gjk(contact.sphere, mesh.convexes[contact.convex], normal, distance);
+	});
+
+	printf("%s, %zu contacts, best of %u\n", filename, contacts.size(), BENCH_REPEATS);
+	printf("%-24s %14s %10s %8s\n", "", "contacts/s", "separated", "speedup");
+	printf("%-24s %14.0f %9.1f%%\n", "vector polytope", oldRate, 100.0 * oldSeparated / contacts.size());
+	printf("%-24s %14.0f %9.1f%% %7.2fx\n", "fixed polytope + heap", newRate, 100.0 * separated / contacts.size(), newRate / oldRate);
+	printf("depth difference mean %.4f max %.4f, normal angle max %.2f deg\n", meanDepth, maxDepth, maxAngle * 180.0 / M_PI);
+	return 0;
+}
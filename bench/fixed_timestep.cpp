@@ -0,0 +1,116 @@
+//Benchmark: frame rate dependence of the physics world, stepped by frame time against fixed steps.
+//Drops spheres over a level and runs three seconds of frames at steady rates and at a jittery rate with
+//slow frames in it. Stepped by frame time, as the game did, each frame steps the smoothed and clamped frame
+//time; fixed, frames feed the accumulator. Reports steps run, bodies lost below the level, off its edges
+//or through it, and how far the final positions are from the 144Hz run of the same kind.
+
+#include "world.hpp"
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include <cstdio>
+
+#define BENCH_BODIES 500
+#define BENCH_TIME 3.0f
+
+typedef std::chrono::steady_clock BenchClock;
+
+struct Result{
+	Uint32 steps;
+	Uint32 lost;
+	double ms;
+	std::vector<Vec3> positions;
+};
+
+//Run the frames, stepping by the smoothed frame time or through the accumulator.
+static Result run(PhysicsMesh& mesh, AABB& bounds, std::vector<float>& frames, bool fixed){
+	PhysicsWorld world;
+	world.init(&mesh);
+	Vec3 size = bounds.max - bounds.min;
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> unit(0.0, 1.0);
+	for(unsigned int i=0;i<BENCH_BODIES;i++){
+		Vec3 position = bounds.min + Vec3(size.x * unit(random), size.y * unit(random), size.z * (0.5f + 0.5f * unit(random)));
+		world.addSphere(position, 0.5, 1.0);
+	}
+
+	Result result;
+	result.steps = 0;
+	float delta = 0.01;
+	auto start = BenchClock::now();
+	for(unsigned int f=0;f<frames.size();f++){
+		if(fixed){
+			result.steps += world.update(frames[f]);
+		}else{
+			delta = (delta + frames[f]) * 0.5;
+			delta = std::min(delta, 0.1f);
+			world.step(delta);
+			result.steps++;
+		}
+	}
+	result.ms = std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+
+	result.lost = 0;
+	for(unsigned int i=0;i<BENCH_BODIES;i++){
+		Vec3 position = fixed ? world.getDrawPosition(i) : world.getBody(i).getPosition();
+		result.positions.push_back(position);
+		result.lost += position.z < bounds.min.z;
+	}
+	return result;
+}
+
+//Largest distance between the bodies of two runs.
+static float maxDistance(Result& a, Result& b){
+	float distance = 0.0;
+	for(unsigned int i=0;i<a.positions.size();i++){
+		distance = std::max(distance, (a.positions[i] - b.positions[i]).length());
+	}
+	return distance;
+}
+
+int main(int argc, const char* argv[]){
+	const char* filename = argc > 1 ? argv[1] : "res/castle_level.pm";
+	PhysicsMesh mesh;
+	if(!mesh.init(filename) || mesh.numConvexes == 0){
+		printf("Could not load %s\n", filename);
+		return 1;
+	}
+	AABB bounds = mesh.convexes[0].createBox();
+	for(unsigned int i=1;i<mesh.numConvexes;i++){
+		AABB box = mesh.convexes[i].createBox();
+		bounds = AABB::combine(bounds, box);
+	}
+
+	//Frame times of three seconds at each rate. Jittery frames take 5 to 40ms with a 250ms stall every second.
+	const char* names[4] = {"144Hz", "60Hz", "30Hz", "jittery"};
+	std::vector<float> frames[4];
+	const float rates[3] = {144.0, 60.0, 30.0};
+	for(unsigned int r=0;r<3;r++){
+		frames[r].assign((Uint32)(BENCH_TIME * rates[r] + 0.5f), 1.0f / rates[r]);
+	}
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> jitter(0.005, 0.04);
+	float total = 0.0;
+	while(total < BENCH_TIME){
+		float frame = jitter(random);
+		if((Uint32)(total + frame) > (Uint32)total){
+			frame = 0.25;
+		}
+		frame = std::min(frame, BENCH_TIME - total);
+		frames[3].push_back(frame);
+		total += frame;
+	}
+
+	printf("%s, %u spheres, %.0f seconds:\n", filename, BENCH_BODIES, BENCH_TIME);
+	printf("%-10s %-16s %7s %7s %9s %15s\n", "frames", "stepping", "steps", "lost", "ms", "off 144Hz by");
+	for(unsigned int k=0;k<2;k++){
+		Result reference = run(mesh, bounds, frames[0], k == 1);
+		for(unsigned int r=0;r<4;r++){
+			Result result = r == 0 ? reference : run(mesh, bounds, frames[r], k == 1);
+			printf("%-10s %-16s %7u %7u %9.2f %15.4f\n", names[r], k == 1 ? "fixed 120Hz" : "frame time", result.steps,
+				result.lost, result.ms, maxDistance(result, reference));
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,90 @@
+//Benchmark: camera culling of bounding spheres, GJK against the frustum corners versus the analytic
+//plane test, one sphere at a time and in batches. Also counts spheres the two disagree on, which
+//should only be the ones near a frustum corner that the plane test keeps.
+
+#include "3Dphysics.hpp"
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdio>
+
+#define BENCH_SPHERES 4096
+#define BENCH_REPEATS 50
+
+typedef std::chrono::steady_clock BenchClock;
+
+//Nanoseconds per sphere of the best run.
+static double perSphere(BenchClock::time_point start, double best){
+	double ns = std::chrono::duration<double, std::nano>(BenchClock::now() - start).count() / BENCH_SPHERES;
+	return std::min(ns, best);
+}
+
+int main(){
+	Vec3 position(-4.0, 30.0, 3.0);
+	Vec3 direction(0.0, 1.0, -0.1);
+	Mat4 view = Mat4::lookAt(position, position + direction, Vec3(0.0, 0.0, 1.0));
+	Mat4 proj = Mat4::perspective(1.7, 16.0 / 9.0, 0.1, 100.0);
+	Mat4 projView = view * proj;
+
+	//Old render path: a convex hull of the frustum corners.
+	const Vec3 clipCorners[8] = {
+		Vec3(-1, -1, -1), Vec3( 1, -1, -1), Vec3( 1,  1, -1), Vec3(-1,  1, -1),
+		Vec3(-1, -1,  1), Vec3( 1, -1,  1), Vec3( 1,  1,  1), Vec3(-1,  1,  1)
+	};
+	Vec3 corners[8];
+	projView.inverse().project(clipCorners, corners, 8);
+	BoundingConvex convex(corners, 8);
+
+	Frustum frustum(projView);
+
+	//Spheres scattered around the camera, about half of them visible.
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> x(-80.0, 80.0), y(-20.0, 140.0), z(-30.0, 30.0), radius(0.2, 4.0);
+	std::vector<float> sx(BENCH_SPHERES), sy(BENCH_SPHERES), sz(BENCH_SPHERES), sr(BENCH_SPHERES);
+	for(unsigned int i=0;i<BENCH_SPHERES;i++){
+		sx[i] = x(rng);
+		sy[i] = y(rng);
+		sz[i] = z(rng);
+		sr[i] = radius(rng);
+	}
+
+	std::vector<Uint8> gjkResult(BENCH_SPHERES), scalarResult(BENCH_SPHERES), batchResult(BENCH_SPHERES);
+	double gjkNs = 1e9, scalarNs = 1e9, batchNs = 1e9;
+	for(unsigned int r=0;r<BENCH_REPEATS;r++){
+		auto start = BenchClock::now();
+		BoundingSphere sphere(Vec3(0, 0, 0), 1.0, 1.0);
+		for(unsigned int i=0;i<BENCH_SPHERES;i++){
+			sphere.center = Vec3(sx[i], sy[i], sz[i]);
+			sphere.radius = sr[i];
+			gjkResult[i] = gjk(convex, sphere);
+		}
+		gjkNs = perSphere(start, gjkNs);
+
+		start = BenchClock::now();
+		for(unsigned int i=0;i<BENCH_SPHERES;i++){
+			scalarResult[i] = frustum.intersect(Vec3(sx[i], sy[i], sz[i]), sr[i]);
+		}
+		scalarNs = perSphere(start, scalarNs);
+
+		start = BenchClock::now();
+		frustum.intersect(sx.data(), sy.data(), sz.data(), sr.data(), batchResult.data(), BENCH_SPHERES);
+		batchNs = perSphere(start, batchNs);
+	}
+
+	Uint32 visible = 0, extra = 0, missed = 0, batchMismatch = 0;
+	for(unsigned int i=0;i<BENCH_SPHERES;i++){
+		visible += gjkResult[i];
+		extra += !gjkResult[i] && scalarResult[i];
+		missed += gjkResult[i] && !scalarResult[i];
+		batchMismatch += scalarResult[i] != batchResult[i];
+	}
+
+	printf("%u spheres, %u visible by GJK, best of %u:\n", BENCH_SPHERES, visible, BENCH_REPEATS);
+	printf("%-16s %10s\n", "test", "ns/sphere");
+	printf("%-16s %10.2f\n", "gjk", gjkNs);
+	printf("%-16s %10.2f\n", "planes", scalarNs);
+	printf("%-16s %10.2f\n", "planes batch", batchNs);
+	printf("\nKept only by planes: %u, kept only by GJK: %u, batch mismatches: %u\n", extra, missed, batchMismatch);
+	return 0;
+}
@@ -0,0 +1,88 @@
+//Benchmark: how much of a level is left to draw once it is split into chunks.
+//Times loading each level including the chunk partition, then walks a camera around it. For the camera
+//and every sun cascade it reports the share of level indices in chunks touching the volume, which is
+//what the G-buffer and shadow passes draw. Without chunks every pass draws the whole level.
+
+#include "loaders.hpp"
+#include "3Dphysics.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+#define BENCH_REPEATS 10
+#define BENCH_POSITIONS 8
+#define BENCH_HEADINGS 8
+#define BENCH_CASCADES 4
+
+typedef std::chrono::steady_clock BenchClock;
+
+//Share of the level's indices in chunks touching a volume.
+static float drawnShare(StaticModelLoader& level, Frustum frustum){
+	Uint32 drawn = 0, total = 0;
+	for(unsigned int i=0;i<level.numChunks;i++){
+		ModelChunk& chunk = level.chunks[i];
+		Vec3 center(chunk.centroid[0], chunk.centroid[1], chunk.centroid[2]);
+		if(frustum.intersect(center, chunk.cullRadius)){
+			drawn += chunk.numIndices;
+		}
+		total += chunk.numIndices;
+	}
+	return (float)drawn / total;
+}
+
+int main(){
+	const char* levels[2] = {"res/castle_level.sm", "res/tech_demo.sm"};
+	Vec3 sunDirection = Vec3::normalize(Vec3(-2.5, 4, 3));
+
+	printf("%-22s %7s %9s %9s", "level", "chunks", "load ms", "camera");
+	for(unsigned int i=0;i<BENCH_CASCADES;i++){
+		printf("   sun %u", i);
+	}
+	printf("\n");
+
+	for(unsigned int l=0;l<2;l++){
+		double best = 1e9;
+		for(unsigned int r=0;r<BENCH_REPEATS;r++){
+			auto start = BenchClock::now();
+			StaticModelLoader file(levels[l]);
+			best = std::min(best, std::chrono::duration<double, std::milli>(BenchClock::now() - start).count());
+		}
+
+		StaticModelLoader level(levels[l]);
+		if(!level.loaded){
+			printf("%-22s failed to load\n", levels[l]);
+			continue;
+		}
+
+		//Camera positions on a circle at head height around the level center, looking every way.
+		Vec3 center(level.centroid[0], level.centroid[1], 2.0);
+		float camera = 0.0;
+		float sun[BENCH_CASCADES] = {0.0};
+		for(unsigned int p=0;p<BENCH_POSITIONS;p++){
+			float angle = 6.2832 * p / BENCH_POSITIONS;
+			Vec3 position = center + Vec3(cos(angle), sin(angle), 0.0) * (level.cullRadius * 0.4);
+			for(unsigned int h=0;h<BENCH_HEADINGS;h++){
+				float yaw = 6.2832 * h / BENCH_HEADINGS;
+				Vec3 direction(cos(yaw), sin(yaw), 0.0);
+				Mat4 projView = Mat4::lookAt(position, position + direction, Vec3(0.0, 0.0, 1.0)) *
+					Mat4::perspective(1.7, 16.0 / 9.0, 0.1, 100.0);
+				camera += drawnShare(level, Frustum(projView));
+			}
+
+			//Same cascades as the renderer, centered on the camera.
+			for(unsigned int c=0;c<BENCH_CASCADES;c++){
+				float scale = 8.0 * (1 << c);
+				Mat4 projView = Mat4::lookAt(sunDirection * 200 + position, position, Vec3(0, 0, 1)) *
+					Mat4::orthographic(-scale, scale, -scale, scale, 0.01, 400.0);
+				sun[c] += drawnShare(level, Frustum(projView));
+			}
+		}
+
+		printf("%-22s %7u %9.3f %8.1f%%", levels[l], level.numChunks, best, camera / (BENCH_POSITIONS * BENCH_HEADINGS) * 100.0);
+		for(unsigned int c=0;c<BENCH_CASCADES;c++){
+			printf(" %6.1f%%", sun[c] / BENCH_POSITIONS * 100.0);
+		}
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,287 @@
+//Benchmark: Vec3/Mat4/Quat kernels against the original scalar implementations.
+//Prints ns per op for both and the largest difference between their results.
+//Build with -DMATHS_SCALAR (make bench SCALAR=1) to measure the scalar fallback.
+
+#include "3Dmaths.hpp"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#define BENCH_COUNT 4096
+#define BENCH_REPEATS 200
+
+//Original scalar versions used as the reference.
+namespace reference{
+	static void multiply(const Mat4& a, const Mat4& b, Mat4& result){
+		for(unsigned int i=0;i<4;i++){
+			for(unsigned int j=0;j<4;j++){
+				result.m[i][j] = a.m[i][0]*b.m[0][j] + a.m[i][1]*b.m[1][j] + a.m[i][2]*b.m[2][j] + a.m[i][3]*b.m[3][j];
+			}
+		}
+	}
+
+	static Vec3 transform(const Mat4& M, const Vec3& u, float W, float& w){
+		Vec3 a(0, 0, 0);
+		float* p = a.ptr();
+		for(unsigned int i=0;i<3;i++){
+			p[i] = M.m[0][i] * u.x + M.m[1][i] * u.y + M.m[2][i] * u.z + M.m[3][i] * W;
+		}
+		w = M.m[0][3] * u.x + M.m[1][3] * u.y + M.m[2][3] * u.z + M.m[3][3] * W;
+		return a;
+	}
+
+	static Mat4 inverse(Mat4 M){
+		float det = M.determinant();
+		Mat4 cof = M.cofactor();
+		cof.transpose();
+		Mat4 result;
+		for(unsigned int i=0;i<4;i++){
+			for(unsigned int j=0;j<4;j++){
+				result.m[i][j] = cof.m[i][j] * (1 / det);
+			}
+		}
+		return result;
+	}
+
+	static Mat4 toMatrix(const Quat& q){
+		float arrA[16] = {
+			 q.w, q.z,-q.y, q.x,
+			-q.z, q.w, q.x, q.y,
+			 q.y,-q.x, q.w, q.z,
+			-q.x,-q.y,-q.z, q.w
+		};
+		float arrB[16] = {
+			 q.w, q.z,-q.y,-q.x,
+			-q.z, q.w, q.x,-q.y,
+			 q.y,-q.x, q.w,-q.z,
+			 q.x, q.y, q.z, q.w
+		};
+		Mat4 result;
+		multiply(Mat4(arrA), Mat4(arrB), result);
+		return result;
+	}
+};
+
+static float matDiff(const Mat4& a, const Mat4& b){
+	float result = 0.0;
+	for(unsigned int i=0;i<4;i++){
+		for(unsigned int j=0;j<4;j++){
+			result = std::max(result, fabsf(a.m[i][j] - b.m[i][j]));
+		}
+	}
+	return result;
+}
+
+static float vecDiff(Vec3 a, Vec3 b){
+	return (a - b).abs().manhattan();
+}
+
+//Time a kernel over BENCH_REPEATS runs of count ops and return ns per op.
+template<typename F>
+static double timeKernel(F kernel, unsigned int count){
+	auto start = std::chrono::steady_clock::now();
+	for(unsigned int r=0;r<BENCH_REPEATS;r++){
+		kernel();
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / ((double)BENCH_REPEATS * count);
+}
+
+static void report(const char* name, double refNs, double newNs, float diff){
+	printf("%-20s %10.2f %10.2f %9.2fx %12g\n", name, refNs, newNs, refNs / newNs, diff);
+}
+
+int main(){
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> dist(-2.0, 2.0);
+
+	std::vector<Mat4> mats(BENCH_COUNT), others(BENCH_COUNT), results(BENCH_COUNT);
+	std::vector<Vec3> us(BENCH_COUNT), vs(BENCH_COUNT), vecResults(BENCH_COUNT);
+	std::vector<float> dots(BENCH_COUNT);
+	std::vector<Quat> quats(BENCH_COUNT);
+
+	for(unsigned int i=0;i<BENCH_COUNT;i++){
+		//Well conditioned transforms like the ones the game builds.
+		Quat q(dist(rng), dist(rng), dist(rng), dist(rng));
+		q.normalize();
+		quats[i] = q;
+		mats[i] = Mat4::scale(1.0 + fabsf(dist(rng)), 1.0 + fabsf(dist(rng)), 1.0 + fabsf(dist(rng))) *
+			reference::toMatrix(q) * Mat4::translation(dist(rng), dist(rng), dist(rng));
+		for(unsigned int j=0;j<16;j++){
+			others[i].ptr()[j] = dist(rng);
+		}
+		us[i] = Vec3(dist(rng), dist(rng), dist(rng));
+		vs[i] = Vec3(dist(rng), dist(rng), dist(rng));
+	}
+
+	volatile float sink = 0.0;
+	float diff;
+	double refNs, newNs;
+
+#ifdef MATHS_SSE
+	std::cout<<"Kernels: SSE"<<std::endl;
+#else
+	std::cout<<"Kernels: scalar"<<std::endl;
+#endif
+	printf("%-20s %10s %10s %10s %12s\n", "kernel", "ref ns/op", "ns/op", "speedup", "max diff");
+
+	//Mat4 * Mat4
+	diff = 0.0;
+	for(unsigned int i=0;i<BENCH_COUNT;i++){
+		Mat4 ref;
+		reference::multiply(mats[i], others[i], ref);
+		diff = std::max(diff, matDiff(ref, mats[i] * others[i]));
+	}
+	refNs = timeKernel([&](){
+		for(unsigned int i=0;i<BENCH_COUNT;i++){reference::multiply(mats[i], others[i], results[i]);}
+		sink = sink + results[BENCH_COUNT - 1].m[3][3];
+	}, BENCH_COUNT);
+	newNs = timeKernel([&](){
+		for(unsigned int i=0;i<BENCH_COUNT;i++){results[i] = mats[i] * others[i];}
+		sink = sink + results[BENCH_COUNT - 1].m[3][3];
+	}, BENCH_COUNT);
+	report("Mat4 * Mat4", refNs, newNs, diff);
+
+	//Mat4 inverse. Difference is relative to the largest element.
+	diff = 0.0;
+	for(unsigned int i=0;i<BENCH_COUNT;i++){
+		Mat4 ref = reference::inverse(mats[i]);
+		float largest = 0.0;
+		for(unsigned int j=0;j<16;j++){largest = std::max(largest, fabsf(ref.ptr()[j]));}
+		diff = std::max(diff, matDiff(ref, mats[i].inverse()) / largest);
+	}
+	refNs = timeKernel([&](){
+		for(unsigned int i=0;i<BENCH_COUNT;i++){results[i] = reference::inverse(mats[i]);}
+		sink = sink + results[BENCH_COUNT - 1].m[3][3];
+	}, BENCH_COUNT);
+	newNs = timeKernel([&](){
+		for(unsigned int i=0;i<BENCH_COUNT;i++){results[i] = mats[i].inverse();}
+		sink = sink + results[BENCH_COUNT - 1].m[3][3];
+	}, BENCH_COUNT);
+	report("Mat4 inverse", refNs, newNs, diff);
+
+	//Mat4 transform Vec3
+	diff = 0.0;
+	for(unsigned int i=0;i<BENCH_COUNT;i++){
+		float refW, newW;
+		Vec3 ref = reference::transform(mats[i], us[i], 1.0, refW);
+		diff = std::max(diff, vecDiff(ref, mats[i].transform(us[i], 1.0, newW)) + fabsf(refW - newW));
+		diff = std::max(diff, vecDiff(ref, mats[i] * us[i]));
+	}
+	refNs = timeKernel([&](){
+		float w;
+		for(unsigned int i=0;i<BENCH_COUNT;i++){vecResults[i] = reference::transform(mats[i], us[i], 1.0, w);}
+		sink = sink + vecResults[BENCH_COUNT - 1].x;
+	}, BENCH_COUNT);
+	newNs = timeKernel([&](){
+		float w;
+		for(unsigned int i=0;i<BENCH_COUNT;i++){vecResults[i] = mats[i].transform(us[i], 1.0, w);}
+		sink = sink + vecResults[BENCH_COUNT - 1].x;
+	}, BENCH_COUNT);
+	report("Mat4 transform", refNs, newNs, diff);
+
+	//Mat4 * Mat4 batch
+	Mat4::multiply(mats.data(), others.data(), results.data(), BENCH_COUNT);
+	diff = 0.0;
+	for(unsigned int i=0;i<BENCH_COUNT;i++){
+		Mat4 ref;
+		reference::multiply(mats[i], others[i], ref);
+		diff = std::max(diff, matDiff(ref, results[i]));
+	}
+	refNs = timeKernel([&](){
+		for(unsigned int i=0;i<BENCH_COUNT;i++){reference::multiply(mats[i], others[i], results[i]);}
+		sink = sink + results[BENCH_COUNT - 1].m[3][3];
+	}, BENCH_COUNT);
+	newNs = timeKernel([&](){
+		Mat4::multiply(mats.data(), others.data(), results.data(), BENCH_COUNT);
+		sink = sink + results[BENCH_COUNT - 1].m[3][3];
+	}, BENCH_COUNT);
+	report("Mat4 * Mat4 batch", refNs, newNs, diff);
+
+	//Mat4 transform batch, one matrix over many points in AoS and SoA layouts.
+	std::vector<float> xs(BENCH_COUNT), ys(BENCH_COUNT), zs(BENCH_COUNT);
+	for(unsigned int i=0;i<BENCH_COUNT;i++){
+		xs[i] = us[i].x;
+		ys[i] = us[i].y;
+		zs[i] = us[i].z;
+	}
+	mats[0].transform(us.data(), vecResults.data(), BENCH_COUNT);
+	diff = 0.0;
+	for(unsigned int i=0;i<BENCH_COUNT;i++){
+		float w;
+		diff = std::max(diff, vecDiff(reference::transform(mats[0], us[i], 1.0, w), vecResults[i]));
+	}
+	refNs = timeKernel([&](){
+		float w;
+		for(unsigned int i=0;i<BENCH_COUNT;i++){vecResults[i] = reference::transform(mats[0], us[i], 1.0, w);}
+		sink = sink + vecResults[BENCH_COUNT - 1].x;
+	}, BENCH_COUNT);
+	newNs = timeKernel([&](){
+		mats[0].transform(us.data(), vecResults.data(), BENCH_COUNT);
+		sink = sink + vecResults[BENCH_COUNT - 1].x;
+	}, BENCH_COUNT);
+	report("transform AoS batch", refNs, newNs, diff);
+
+	mats[0].transform(xs.data(), ys.data(), zs.data(), xs.data(), ys.data(), zs.data(), BENCH_COUNT);
+	diff = 0.0;
+	for(unsigned int i=0;i<BENCH_COUNT;i++){
+		float w;
+		diff = std::max(diff, vecDiff(reference::transform(mats[0], us[i], 1.0, w), Vec3(xs[i], ys[i], zs[i])));
+	}
+	std::vector<float> rxs(BENCH_COUNT), rys(BENCH_COUNT), rzs(BENCH_COUNT);
+	newNs = timeKernel([&](){
+		mats[0].transform(xs.data(), ys.data(), zs.data(), rxs.data(), rys.data(), rzs.data(), BENCH_COUNT);
+		sink = sink + rxs[BENCH_COUNT - 1];
+	}, BENCH_COUNT);
+	report("transform SoA batch", refNs, newNs, diff);
+
+	//Vec3 dot batch
+	Vec3::dot(us.data(), vs.data(), dots.data(), BENCH_COUNT);
+	diff = 0.0;
+	for(unsigned int i=0;i<BENCH_COUNT;i++){
+		diff = std::max(diff, fabsf(dots[i] - Vec3::dot(us[i], vs[i])));
+	}
+	refNs = timeKernel([&](){
+		for(unsigned int i=0;i<BENCH_COUNT;i++){dots[i] = Vec3::dot(us[i], vs[i]);}
+		sink = sink + dots[BENCH_COUNT - 1];
+	}, BENCH_COUNT);
+	newNs = timeKernel([&](){
+		Vec3::dot(us.data(), vs.data(), dots.data(), BENCH_COUNT);
+		sink = sink + dots[BENCH_COUNT - 1];
+	}, BENCH_COUNT);
+	report("Vec3 dot batch", refNs, newNs, diff);
+
+	//Vec3 cross batch
+	Vec3::cross(us.data(), vs.data(), vecResults.data(), BENCH_COUNT);
+	diff = 0.0;
+	for(unsigned int i=0;i<BENCH_COUNT;i++){
+		diff = std::max(diff, vecDiff(vecResults[i], Vec3::cross(us[i], vs[i])));
+	}
+	refNs = timeKernel([&](){
+		for(unsigned int i=0;i<BENCH_COUNT;i++){vecResults[i] = Vec3::cross(us[i], vs[i]);}
+		sink = sink + vecResults[BENCH_COUNT - 1].x;
+	}, BENCH_COUNT);
+	newNs = timeKernel([&](){
+		Vec3::cross(us.data(), vs.data(), vecResults.data(), BENCH_COUNT);
+		sink = sink + vecResults[BENCH_COUNT - 1].x;
+	}, BENCH_COUNT);
+	report("Vec3 cross batch", refNs, newNs, diff);
+
+	//Quat to matrix
+	diff = 0.0;
+	for(unsigned int i=0;i<BENCH_COUNT;i++){
+		diff = std::max(diff, matDiff(reference::toMatrix(quats[i]), quats[i].toMatrix()));
+	}
+	refNs = timeKernel([&](){
+		for(unsigned int i=0;i<BENCH_COUNT;i++){results[i] = reference::toMatrix(quats[i]);}
+		sink = sink + results[BENCH_COUNT - 1].m[0][0];
+	}, BENCH_COUNT);
+	newNs = timeKernel([&](){
+		for(unsigned int i=0;i<BENCH_COUNT;i++){results[i] = quats[i].toMatrix();}
+		sink = sink + results[BENCH_COUNT - 1].m[0][0];
+	}, BENCH_COUNT);
+	report("Quat toMatrix", refNs, newNs, diff);
+
+	return 0;
+}
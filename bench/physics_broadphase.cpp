@@ -0,0 +1,116 @@
+//Benchmark: physics mesh collision with and without the AABB tree broad phase.
+//Drops a grid of bodies onto every physics mesh in res/ and walks them around.
+
+#include "entities.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#define BENCH_GRID 8
+#define BENCH_TICKS 600
+#define BENCH_DT (1.0f / 120.0f)
+
+//Spawn bodies in a grid above the mesh.
+static std::vector<C_Physics> spawnBodies(PhysicsMesh& mesh){
+	AABB bounds = mesh.convexes[0].createBox();
+	for(unsigned int i=1;i<mesh.numConvexes;i++){
+		AABB box = mesh.convexes[i].createBox();
+		bounds = AABB::combine(bounds, box);
+	}
+
+	std::vector<C_Physics> bodies;
+	Vec3 size = bounds.max - bounds.min;
+	for(unsigned int i=0;i<BENCH_GRID;i++){
+		for(unsigned int j=0;j<BENCH_GRID;j++){
+			Vec3 position(
+				bounds.min.x + size.x * (i + 0.5f) / BENCH_GRID,
+				bounds.min.y + size.y * (j + 0.5f) / BENCH_GRID,
+				bounds.max.z + 2.0f
+			);
+			bodies.push_back(C_Physics(1.2, 1.65, position));
+		}
+	}
+	return bodies;
+}
+
+//Run the simulation. Returns microseconds per tick and narrow phase checks per tick.
+static void simulate(PhysicsMesh& mesh, std::vector<C_Physics>& bodies, bool useTree, double& usPerTick, double& checksPerTick){
+	Uint64 checks = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for(unsigned int t=0;t<BENCH_TICKS;t++){
+		for(unsigned int b=0;b<bodies.size();b++){
+			C_Physics& body = bodies[b];
+			float angle = b * 0.7f + t * 0.01f;
+
+			body.collider.swapSpheres();
+			body.velocity.x = cos(angle) * 6.0f;
+			body.velocity.y = sin(angle) * 6.0f;
+			body.update(BENCH_DT);
+
+			if(useTree){
+				body.handleCollision(mesh);
+				checks += body.candidates.size();
+			}else{
+				Vec3 initDir = body.contactDirection();
+				for(unsigned int i=0;i<mesh.numConvexes;i++){
+					body.handleContact(mesh.convexes[i], initDir);
+				}
+				checks += mesh.numConvexes;
+			}
+		}
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	usPerTick = std::chrono::duration<double, std::micro>(end - start).count() / BENCH_TICKS;
+	checksPerTick = (double)checks / BENCH_TICKS;
+}
+
+int main(int argc, const char* argv[]){
+	std::string dir = "res/";
+	if(argc > 1){
+		dir = argv[1];
+	}
+
+	std::vector<std::string> files;
+	for(auto& entry : std::filesystem::directory_iterator(dir)){
+		if(entry.path().extension() == ".pm"){
+			files.push_back(entry.path().string());
+		}
+	}
+	std::sort(files.begin(), files.end());
+
+	std::cout<<BENCH_GRID * BENCH_GRID<<" bodies, "<<BENCH_TICKS<<" ticks"<<std::endl;
+	std::cout<<"mesh\tconvexes\tgjk/tick linear\tgjk/tick tree\tus/tick linear\tus/tick tree\tmax drift"<<std::endl;
+
+	for(unsigned int f=0;f<files.size();f++){
+		PhysicsMesh mesh;
+		if(!mesh.init(files[f].c_str()) || mesh.numConvexes == 0){
+			std::cout<<"WARNING: Could not load "<<files[f]<<std::endl;
+			continue;
+		}
+
+		std::vector<C_Physics> linear = spawnBodies(mesh);
+		std::vector<C_Physics> tree = linear;
+
+		double linearUs, linearChecks, treeUs, treeChecks;
+		simulate(mesh, linear, false, linearUs, linearChecks);
+		simulate(mesh, tree, true, treeUs, treeChecks);
+
+		//Both paths should end up in the same place.
+		float drift = 0.0;
+		for(unsigned int i=0;i<linear.size();i++){
+			Vec3 d = linear[i].collider.getNext()->center - tree[i].collider.getNext()->center;
+			drift = std::max(drift, d.length());
+		}
+
+		std::cout<<files[f]<<"\t"<<mesh.numConvexes<<"\t"
+			<<linearChecks<<"\t"<<treeChecks<<"\t"
+			<<linearUs<<"\t"<<treeUs<<"\t"<<drift<<std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,116 @@
+//Benchmark: physics world steps from 10 to 10000 bodies over the pool's threads.
+//Drops spheres and boxes over a level and steps them at 120Hz, on the calling thread alone and with pools
+//of one to eight threads in total. Reports milliseconds per step, body steps per second and pairs per step,
+//and checks every thread count ends with exactly the same bodies as the calling thread alone. Also reruns the
+//calling thread with every contact cache emptied before each step, which must not change the bodies either:
+//a step depends on the bodies alone, not on what earlier steps cached.
+
+#include "world.hpp"
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstring>
+
+#define BENCH_STEPS 120
+#define BENCH_DELTA (1.0f / 120.0f)
+#define BENCH_MAX_THREADS 8
+
+typedef std::chrono::steady_clock BenchClock;
+
+//Corners of a box half a unit across.
+static Vec3 boxVertices[8] = {Vec3(-0.5, -0.5, -0.5), Vec3(0.5, -0.5, -0.5), Vec3(-0.5, 0.5, -0.5), Vec3(0.5, 0.5, -0.5),
+	Vec3(-0.5, -0.5, 0.5), Vec3(0.5, -0.5, 0.5), Vec3(-0.5, 0.5, 0.5), Vec3(0.5, 0.5, 0.5)};
+
+struct Result{
+	double ms;
+	Uint64 pairs;
+	Uint64 hash;
+};
+
+//Hash of every body's position and velocity bits.
+static Uint64 hashBodies(PhysicsWorld& world){
+	Uint64 hash = 1469598103934665603ull;
+	for(unsigned int i=0;i<world.numBodies();i++){
+		PhysicsBody& body = world.getBody(i);
+		float values[6] = {body.getPosition().x, body.getPosition().y, body.getPosition().z,
+			body.velocity.x, body.velocity.y, body.velocity.z};
+		Uint32 bits[6];
+		memcpy(bits, values, sizeof(bits));
+		for(unsigned int j=0;j<6;j++){
+			hash = (hash ^ bits[j]) * 1099511628211ull;
+		}
+	}
+	return hash;
+}
+
+//Drop count bodies over the level and time the steps after the first. Forget empties the caches every step.
+static Result run(PhysicsMesh& mesh, BoundingConvex& box, Uint32 count, JobPool* pool, bool forget = false){
+	AABB bounds = mesh.convexes[0].createBox();
+	for(unsigned int i=1;i<mesh.numConvexes;i++){
+		AABB convexBox = mesh.convexes[i].createBox();
+		bounds = AABB::combine(bounds, convexBox);
+	}
+	Vec3 size = bounds.max - bounds.min;
+
+	PhysicsWorld world;
+	world.init(&mesh, pool);
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(0.0, 1.0);
+	for(unsigned int i=0;i<count;i++){
+		Vec3 position = bounds.min + Vec3(size.x * unit(random), size.y * unit(random), size.z * (0.5f + 0.5f * unit(random)));
+		Uint32 body = i % 4 == 3 ? world.addConvex(&box, position) : world.addSphere(position, 0.5, 1.0);
+		world.getBody(body).velocity = Vec3(unit(random) - 0.5f, unit(random) - 0.5f, 0.0) * 4.0f;
+	}
+
+	//The first step sorts the bodies from scratch.
+	world.step(BENCH_DELTA);
+	Result result = {0.0, 0, 0};
+	auto start = BenchClock::now();
+	for(unsigned int s=1;s<BENCH_STEPS;s++){
+		for(unsigned int i=0;forget && i<count;i++){
+			world.getBody(i).contactCache = ContactCache();
+		}
+		world.step(BENCH_DELTA);
+		result.pairs += world.numPairs();
+	}
+	result.ms = std::chrono::duration<double, std::milli>(BenchClock::now() - start).count() / (BENCH_STEPS - 1);
+	result.hash = hashBodies(world);
+	return result;
+}
+
+int main(int argc, const char* argv[]){
+	const char* filename = argc > 1 ? argv[1] : "res/castle_level.pm";
+	PhysicsMesh mesh;
+	if(!mesh.init(filename) || mesh.numConvexes == 0){
+		printf("Could not load %s\n", filename);
+		return 1;
+	}
+	BoundingConvex box(boxVertices, 8);
+
+	printf("%s, %u hardware threads, %u steps. ms per step, million body steps per second:\n", filename,
+		std::thread::hardware_concurrency(), BENCH_STEPS);
+	printf("%8s %16s", "bodies", "loop");
+	for(unsigned int t=1;t<=BENCH_MAX_THREADS;t*=2){
+		printf(" %12u thr", t);
+	}
+	printf(" %7s %13s\n", "pairs", "deterministic");
+
+	const Uint32 sizes[4] = {10, 100, 1000, 10000};
+	for(unsigned int s=0;s<4;s++){
+		Result loop = run(mesh, box, sizes[s], nullptr);
+		printf("%8u %8.3f %7.3f", sizes[s], loop.ms, sizes[s] / loop.ms / 1000.0);
+
+		bool same = run(mesh, box, sizes[s], nullptr, true).hash == loop.hash;
+		for(unsigned int t=1;t<=BENCH_MAX_THREADS;t*=2){
+			JobPool pool;
+			pool.init(t - 1);
+			Result threaded = run(mesh, box, sizes[s], &pool);
+			same = same && threaded.hash == loop.hash;
+			printf(" %8.3f %7.3f", threaded.ms, sizes[s] / threaded.ms / 1000.0);
+		}
+		printf(" %7.1f %13s\n", (double)loop.pairs / (BENCH_STEPS - 1), same ? "yes" : "NO");
+	}
+	return 0;
+}
@@ -0,0 +1,90 @@
+//Benchmark: scaling of pose evaluation over the job pool's threads.
+//Evaluates the joint palettes of crowds where every character has its own pose, on the calling thread
+//alone and with pools of one to eight threads in total, two poses per job as the renderer queues them.
+//Speedup is against the plain loop, so it includes the cost of queueing and stealing.
+
+#include "models.hpp"
+#include "jobs.hpp"
+
+#include <chrono>
+#include <vector>
+#include <cstdio>
+
+#define BENCH_REPEATS 50
+#define BENCH_MAX_THREADS 8
+
+typedef std::chrono::steady_clock BenchClock;
+
+struct Crowd{
+	std::vector<Animation*> anims;
+	std::vector<float> times;
+	std::vector<Mat4> palettes;	//32 joints per character.
+};
+
+//Evaluate the poses of a range of characters.
+static void evaluateRange(void* data, Uint32 first, Uint32 end){
+	Crowd& crowd = *(Crowd*)data;
+	for(unsigned int i=first;i<end;i++){
+		crowd.anims[i]->calcJointTransforms(&crowd.palettes[i * 32], crowd.times[i]);
+	}
+}
+
+//Milliseconds since start.
+static double since(BenchClock::time_point start){
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+int main(){
+	const char* clips[3] = {"res/animation_demo.ad", "res/test_walk_newer_0.ad", "res/test_inflate.ad"};
+	Animation* anims[3];
+	for(unsigned int i=0;i<3;i++){
+		anims[i] = new Animation;
+		if(!anims[i]->init(clips[i])){
+			printf("Could not load %s\n", clips[i]);
+			return 1;
+		}
+	}
+
+	printf("%u hardware threads. Best of %u, ms per frame, speedup against the plain loop:\n",
+		std::thread::hardware_concurrency(), BENCH_REPEATS);
+	printf("%10s %8s", "characters", "loop");
+	for(unsigned int t=1;t<=BENCH_MAX_THREADS;t*=2){
+		printf(" %7u thr", t);
+	}
+	printf("\n");
+
+	const Uint32 sizes[3] = {64, 256, 1024};
+	for(unsigned int s=0;s<3;s++){
+		Crowd crowd;
+		for(unsigned int i=0;i<sizes[s];i++){
+			Animation* anim = anims[i % 3];
+			crowd.anims.push_back(anim);
+			crowd.times.push_back(anim->duration * (i % 101) / 101.0);
+		}
+		crowd.palettes.resize(sizes[s] * 32);
+
+		double loopMs = 1e9;
+		for(unsigned int r=0;r<BENCH_REPEATS;r++){
+			auto start = BenchClock::now();
+			evaluateRange(&crowd, 0, sizes[s]);
+			loopMs = std::min(loopMs, since(start));
+		}
+		printf("%10u %8.3f", sizes[s], loopMs);
+
+		for(unsigned int t=1;t<=BENCH_MAX_THREADS;t*=2){
+			JobPool pool;
+			pool.init(t - 1);
+			double best = 1e9;
+			for(unsigned int r=0;r<BENCH_REPEATS;r++){
+				JobCounter counter;
+				auto start = BenchClock::now();
+				pool.parallelFor(evaluateRange, &crowd, sizes[s], 2, counter);
+				pool.wait(counter);
+				best = std::min(best, since(start));
+			}
+			printf(" %5.3f %4.2fx", best, loopMs / best);
+		}
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,134 @@
+//Benchmark: scene tree queries against testing every object.
+//Scatters objects over an open level the size of the desert and industrial tests, then times camera
+//frustum and pointlight sphere queries, and moving a tenth of the objects as dynamic ones would.
+
+#include "scene.hpp"
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+
+#define BENCH_REPEATS 50
+#define BENCH_LEVEL_SIZE 512.0	//Half size of the level.
+#define BENCH_NUM_PROXIES 4
+
+typedef std::chrono::steady_clock BenchClock;
+
+//Microseconds since start.
+static double since(BenchClock::time_point start){
+	return std::chrono::duration<double, std::micro>(BenchClock::now() - start).count();
+}
+
+//True if both lists hold the same handles.
+static bool sameSet(std::vector<Uint32> a, std::vector<Uint32> b){
+	std::sort(a.begin(), a.end());
+	std::sort(b.begin(), b.end());
+	return a == b;
+}
+
+static void bench(Uint32 count, StaticModel* proxies){
+	std::mt19937 rng(count);
+	std::uniform_real_distribution<float> position(-BENCH_LEVEL_SIZE, BENCH_LEVEL_SIZE), height(0.0, 20.0), step(-0.5, 0.5);
+
+	SceneTree scene;
+	scene.init(Vec3(0, 0, 0), BENCH_LEVEL_SIZE);
+	std::vector<Uint32> handles(count);
+	std::vector<Vec3> positions(count);
+	for(unsigned int i=0;i<count;i++){
+		positions[i] = Vec3(position(rng), position(rng), height(rng));
+		handles[i] = scene.insert(&proxies[i % BENCH_NUM_PROXIES], Mat4::translation(positions[i]));
+	}
+
+	Vec3 camPosition(0.0, 0.0, 3.0);
+	Mat4 projView = Mat4::lookAt(camPosition, camPosition + Vec3(1.0, 0.3, -0.1), Vec3(0.0, 0.0, 1.0)) *
+		Mat4::perspective(1.7, 16.0 / 9.0, 0.1, 100.0);
+	Frustum frustum(projView);
+	Vec3 lightPosition(20.0, 5.0, 4.0);
+	float lightRadius = 20.0;
+
+	//Testing every object, the way the renderer did without a scene.
+	std::vector<Uint32> bruteFrustum, bruteSphere, treeFrustum, treeSphere;
+	double bruteFrustumUs = 1e9, bruteSphereUs = 1e9, treeFrustumUs = 1e9, treeSphereUs = 1e9, moveUs = 1e9;
+	for(unsigned int r=0;r<BENCH_REPEATS;r++){
+		auto start = BenchClock::now();
+		bruteFrustum.clear();
+		for(unsigned int i=0;i<count;i++){
+			SceneObject& object = scene.get(handles[i]);
+			if(frustum.intersect(object.center, object.radius)){
+				bruteFrustum.push_back(handles[i]);
+			}
+		}
+		bruteFrustumUs = std::min(bruteFrustumUs, since(start));
+
+		start = BenchClock::now();
+		bruteSphere.clear();
+		for(unsigned int i=0;i<count;i++){
+			SceneObject& object = scene.get(handles[i]);
+			Vec3 offset = object.center - lightPosition;
+			float reach = object.radius + lightRadius;
+			if(Vec3::dot(offset, offset) <= reach * reach){
+				bruteSphere.push_back(handles[i]);
+			}
+		}
+		bruteSphereUs = std::min(bruteSphereUs, since(start));
+
+		start = BenchClock::now();
+		treeFrustum.clear();
+		scene.query(frustum, treeFrustum);
+		treeFrustumUs = std::min(treeFrustumUs, since(start));
+
+		start = BenchClock::now();
+		treeSphere.clear();
+		scene.query(lightPosition, lightRadius, treeSphere);
+		treeSphereUs = std::min(treeSphereUs, since(start));
+	}
+
+	scene.query(frustum, treeFrustum);
+	Uint32 nodesVisited = scene.nodesVisited, objectsTested = scene.objectsTested;
+
+	//A tenth of the objects wander around.
+	for(unsigned int r=0;r<BENCH_REPEATS;r++){
+		auto start = BenchClock::now();
+		for(unsigned int i=0;i<count;i+=10){
+			positions[i] = positions[i] + Vec3(step(rng), step(rng), 0.0);
+			scene.move(handles[i], Mat4::translation(positions[i]));
+		}
+		moveUs = std::min(moveUs, since(start));
+	}
+
+	treeFrustum.clear();
+	scene.query(frustum, treeFrustum);
+	bruteFrustum.clear();
+	for(unsigned int i=0;i<count;i++){
+		SceneObject& object = scene.get(handles[i]);
+		if(frustum.intersect(object.center, object.radius)){
+			bruteFrustum.push_back(handles[i]);
+		}
+	}
+
+	printf("%8u %8zu %10.2f %10.2f %10.2f %10.2f %10.2f %9u %9u %6s\n", count, treeFrustum.size(),
+		bruteFrustumUs, treeFrustumUs, bruteSphereUs, treeSphereUs, moveUs, nodesVisited, objectsTested,
+		sameSet(treeFrustum, bruteFrustum) ? "yes" : "NO");
+}
+
+int main(){
+	//Bounds only, the proxies are never uploaded. They are not deleted either, since their
+	//shaders cannot be released without a GL context.
+	StaticModel* proxies = new StaticModel[BENCH_NUM_PROXIES];
+	for(unsigned int i=0;i<BENCH_NUM_PROXIES;i++){
+		proxies[i].centroid = Vec3(0.0, 0.0, 0.0);
+		proxies[i].cullRadius = 0.5 * (1 << i);
+		proxies[i].resident = true;
+	}
+
+	printf("Best of %u, times in us:\n", BENCH_REPEATS);
+	printf("%8s %8s %10s %10s %10s %10s %10s %9s %9s %6s\n", "objects", "visible", "all frust", "tree frust",
+		"all sphere", "tree sphr", "move 10%", "nodes", "tested", "match");
+	const Uint32 counts[3] = {1000, 10000, 100000};
+	for(unsigned int i=0;i<3;i++){
+		bench(counts[i], proxies);
+	}
+	return 0;
+}
@@ -0,0 +1,89 @@
+//Benchmark: shadow pass GPU time with the static shadow cache on and off.
+//Draws the castle level as a static caster and two moving balls as dynamic casters
+//under the L_Test spotlights, with a still camera. Needs a GL context.
+
+#include "renderer.hpp"
+
+#include <cstdio>
+
+#define BENCH_FRAMES 200
+#define BENCH_WARMUP_FRAMES 10
+
+//Spotlights of L_Test.
+static void pushLights(Renderer* renderer){
+	const Vec3 positions[6] = {Vec3(10, 14, 2), Vec3(10, 26, 2), Vec3(10, 14, 8), Vec3(10, 26, 8), Vec3(-38, 62, 12), Vec3(-38, 82, 12)};
+	const Vec3 directions[6] = {Vec3(1.5, 1, 1), Vec3(1.5, -1, 1), Vec3(1.5, 1, -1), Vec3(1.5, -1, -1), Vec3(1, 1, -2), Vec3(1, -1, -2)};
+
+	Spotlight spot;
+	spot.radius = 30;
+	spot.cutOff = cos(0.8);
+	spot.diffuse = Vec3(3, 3, 3);
+	for(unsigned int i=0;i<6;i++){
+		spot.position = positions[i];
+		spot.direction = directions[i];
+		renderer->pushLight(spot);
+	}
+}
+
+//Mean shadow pass GPU time over the measured frames.
+static float run(Renderer* renderer, StaticModel* level, StaticModel* ball, bool cache, Uint32& rebuilt){
+	renderer->settings.shadowStaticCache = cache;
+	renderer->invalidateShadowCache();
+
+	float total = 0.0;
+	rebuilt = 0;
+	for(unsigned int frame=0;frame<BENCH_WARMUP_FRAMES+BENCH_FRAMES;frame++){
+		float time = frame * 0.016;
+		pushLights(renderer);
+		renderer->drawModel(level, Mat4::identity(), true);
+		renderer->drawModel(ball, Mat4::translation(Vec3(20, 20, 2) + Vec3(sin(time)*5, cos(time)*4, sin(time*1.2))));
+		renderer->drawModel(ball, Mat4::translation(Vec3(20, 20, 6) + Vec3(sin(time*2)*3, cos(time*2)*4, cos(time*1.4))));
+		renderer->displayFrame();
+
+		//Timings lag a frame or two behind.
+		if(frame >= BENCH_WARMUP_FRAMES){
+			total += renderer->stats.shadowPassMs;
+			rebuilt += renderer->stats.shadowLayersRebuilt;
+		}
+	}
+	return total / BENCH_FRAMES;
+}
+
+int main(){
+	if(SDL_Init(SDL_INIT_VIDEO) != 0){
+		printf("No GL context (%s), skipped.\n", SDL_GetError());
+		return 0;
+	}
+
+	RendererSettings settings;
+	settings.windowFlags = SDL_WINDOW_HIDDEN;
+	settings.windowVsync = 0;
+
+	Renderer* renderer = new Renderer;
+	if(renderer->init(settings) != 0){
+		printf("No GL context, skipped.\n");
+		return 0;
+	}
+
+	StaticModel* level = new StaticModel;
+	level->init("res/castle_level.sm");
+	StaticModel* ball = new StaticModel;
+	ball->init("res/steel_ball.sm");
+
+	renderer->uniforms.common.camPosition = Vec3(0, 20, 3);
+	renderer->setCameraView(0.0, 0.0);
+	renderer->uniforms.lights.sun.direction = Vec3(1.0, 0.5, 2.0);
+	renderer->uniforms.lights.sun.diffuse = Vec3(1.0, 1.0, 1.0);
+
+	printf("%-10s %14s %16s\n", "cache", "shadow GPU ms", "layers rebuilt");
+	for(unsigned int i=0;i<2;i++){
+		Uint32 rebuilt;
+		float ms = run(renderer, level, ball, i == 1, rebuilt);
+		printf("%-10s %14.3f %16u\n", i == 1 ? "on" : "off", ms, rebuilt);
+	}
+
+	delete ball;
+	delete level;
+	delete renderer;
+	return 0;
+}
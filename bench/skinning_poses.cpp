@@ -0,0 +1,100 @@
+//Benchmark: CPU cost of joint palettes for a crowd of animated characters, per frame.
+//Compares evaluating the pose in every pass that draws a character (G-buffer and each sun cascade),
+//once per request, and once per distinct pose as the renderer's pose stage does. Crowds either play
+//each character at its own time or in a few lockstep groups, the way spawned crowds usually move.
+
+#include "models.hpp"
+
+#include <chrono>
+#include <map>
+#include <vector>
+#include <cstdio>
+
+#define BENCH_REPEATS 50
+#define BENCH_PASSES (1 + NUM_SUN_CASCADES)	//Passes drawing a character seen by the camera and every cascade.
+#define BENCH_GROUPS 8						//Lockstep groups per clip.
+
+typedef std::chrono::steady_clock BenchClock;
+
+struct Character{
+	Animation* anim;
+	float time;
+};
+
+//Milliseconds since start.
+static double since(BenchClock::time_point start){
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+//Joint palettes evaluated count times over for every character.
+static double perCharacter(std::vector<Character>& crowd, Mat4* palettes, Uint32 count){
+	double best = 1e9;
+	for(unsigned int r=0;r<BENCH_REPEATS;r++){
+		auto start = BenchClock::now();
+		for(unsigned int p=0;p<count;p++){
+			for(unsigned int i=0;i<crowd.size();i++){
+				crowd[i].anim->calcJointTransforms(&palettes[i * crowd[i].anim->numBones], crowd[i].time);
+			}
+		}
+		best = std::min(best, since(start));
+	}
+	return best;
+}
+
+//Joint palettes evaluated once per distinct pose, with every character pointed at its palette.
+static double perPose(std::vector<Character>& crowd, Mat4* palettes, Uint32* offsets, Uint32& numPoses){
+	double best = 1e9;
+	for(unsigned int r=0;r<BENCH_REPEATS;r++){
+		auto start = BenchClock::now();
+		std::map<std::pair<Animation*, float>, Uint32> poses;
+		Uint32 numJoints = 0;
+		for(unsigned int i=0;i<crowd.size();i++){
+			auto found = poses.insert(std::make_pair(std::make_pair(crowd[i].anim, crowd[i].time), numJoints));
+			if(found.second){
+				crowd[i].anim->calcJointTransforms(&palettes[numJoints], crowd[i].time);
+				numJoints += crowd[i].anim->numBones;
+			}
+			offsets[i] = found.first->second;
+		}
+		numPoses = poses.size();
+		best = std::min(best, since(start));
+	}
+	return best;
+}
+
+int main(){
+	const char* clips[3] = {"res/animation_demo.ad", "res/test_walk_newer_0.ad", "res/test_inflate.ad"};
+	Animation* anims[3];
+	for(unsigned int i=0;i<3;i++){
+		anims[i] = new Animation;
+		if(!anims[i]->init(clips[i])){
+			printf("Could not load %s\n", clips[i]);
+			return 1;
+		}
+	}
+
+	printf("Best of %u, CPU ms per frame:\n", BENCH_REPEATS);
+	printf("%10s %10s %7s %10s %10s %10s %8s\n", "characters", "crowd", "poses", "per pass", "per req", "per pose", "saved");
+	const Uint32 sizes[3] = {64, 256, 1024};
+	for(unsigned int s=0;s<3;s++){
+		for(unsigned int lockstep=0;lockstep<2;lockstep++){
+			std::vector<Character> crowd(sizes[s]);
+			for(unsigned int i=0;i<crowd.size();i++){
+				Animation* anim = anims[i % 3];
+				Uint32 phase = lockstep ? (i / 3) % BENCH_GROUPS : i / 3;
+				crowd[i].anim = anim;
+				crowd[i].time = anim->duration * (phase % 97) / 97.0;
+			}
+
+			std::vector<Mat4> palettes(crowd.size() * 32);
+			std::vector<Uint32> offsets(crowd.size());
+			Uint32 numPoses = 0;
+			double passMs = perCharacter(crowd, palettes.data(), BENCH_PASSES);
+			double requestMs = perCharacter(crowd, palettes.data(), 1);
+			double poseMs = perPose(crowd, palettes.data(), offsets.data(), numPoses);
+			printf("%10zu %10s %7u %10.3f %10.3f %10.3f %8.3f\n", crowd.size(), lockstep ? "lockstep" : "scattered",
+				numPoses, passMs, requestMs, poseMs, passMs - poseMs);
+		}
+	}
+	return 0;
+}
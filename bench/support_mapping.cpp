@@ -0,0 +1,135 @@
+//Benchmark: support points on large convexes by hill climbing the hull against scanning every vertex.
+//Directions turn a little each query, as they do between frames for a body resting on a convex. Cold climbs
+//start from the convex's seed, warm ones from the vertex found by the previous query. Also times GJK with EPA
+//for spheres moving over the large convexes, scanning and climbing from the vertex the last step found, and checks every climbed
+//support point reaches as far as the scanned one.
+
+#include "models.hpp"
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include <cstdio>
+
+#define BENCH_REPEATS 20
+#define BENCH_QUERIES 20000
+#define BENCH_CONTACTS 2000
+
+typedef std::chrono::steady_clock BenchClock;
+
+//Nanoseconds per call of the best run.
+template<typename Function> static double perCall(Function function, Uint32 calls){
+	double best = 1e9;
+	for(unsigned int r=0;r<BENCH_REPEATS;r++){
+		auto start = BenchClock::now();
+		for(unsigned int i=0;i<calls;i++){
+			function(i);
+		}
+		best = std::min(best, std::chrono::duration<double, std::nano>(BenchClock::now() - start).count());
+	}
+	return best / calls;
+}
+
+//Support point by scanning, whatever adjacency the convex has.
+static Vec3 scan(BoundingConvex& convex, Vec3 direction){
+	BoundingConvex plain(convex.vertices, convex.numVertices);
+	return plain.furthest(direction);
+}
+
+int main(int argc, const char* argv[]){
+	const char* filename = argc > 1 ? argv[1] : "res/tech_demo.pm";
+	PhysicsMesh mesh;
+	if(!mesh.init(filename) || mesh.numConvexes == 0){
+		printf("Could not load %s\n", filename);
+		return 1;
+	}
+
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> unit(-1.0, 1.0);
+	std::vector<Vec3> directions(BENCH_QUERIES);
+	Vec3 direction(1, 0, 0);
+	for(unsigned int i=0;i<BENCH_QUERIES;i++){
+		direction = Vec3::normalize(direction + Vec3(unit(random), unit(random), unit(random)) * 0.05f);
+		directions[i] = direction;
+	}
+
+	printf("%s, best of %u, ns per support point:\n", filename, BENCH_REPEATS);
+	printf("%-8s %8s %10s %8s %8s %8s %8s %10s\n", "convex", "vertices", "neighbors", "scan", "cold", "warm", "speedup", "max miss");
+	for(unsigned int c=0;c<mesh.numConvexes;c++){
+		BoundingConvex& convex = mesh.convexes[c];
+		if(convex.neighbors == nullptr){
+			continue;
+		}
+
+		float maxMiss = 0.0;
+		Uint16 start = convex.seed;
+		for(unsigned int i=0;i<BENCH_QUERIES;i++){
+			float best = Vec3::dot(directions[i], scan(convex, directions[i]));
+			maxMiss = std::max(maxMiss, best - Vec3::dot(directions[i], convex.furthest(directions[i])));
+			maxMiss = std::max(maxMiss, best - Vec3::dot(directions[i], convex.furthest(directions[i], start)));
+		}
+
+		volatile float sink = 0.0;
+		double scanNs = perCall([&](Uint32 i){
+			sink = sink + scan(convex, directions[i]).x;
+		}, BENCH_QUERIES);
+		double coldNs = perCall([&](Uint32 i){
+			sink = sink + convex.furthest(directions[i]).x;
+		}, BENCH_QUERIES);
+		double warmNs = perCall([&](Uint32 i){
+			sink = sink + convex.furthest(directions[i], start).x;
+		}, BENCH_QUERIES);
+
+		printf("%-8u %8u %10u %8.1f %8.1f %8.1f %7.2fx %10.2e\n", c, convex.numVertices,
+			convex.offsets[convex.numVertices], scanNs, coldNs, warmNs, scanNs / warmNs, maxMiss);
+	}
+
+	//Spheres stepping across the large convexes, one body per path so the cache sees its own history.
+	PhysicsMesh plain;
+	plain.init(filename, false);
+	std::vector<SweptSphere> spheres;
+	std::vector<Uint32> owners;
+	for(unsigned int c=0;c<mesh.numConvexes && spheres.size()<BENCH_CONTACTS;c++){
+		if(mesh.convexes[c].neighbors == nullptr){
+			continue;
+		}
+		AABB box = mesh.convexes[c].createBox();
+		Vec3 size = box.max - box.min;
+		Vec3 center = box.min + size * 0.5f;
+		float radius = std::max(std::max(size.x, size.y), size.z) * 0.5f;
+		for(unsigned int i=0;i<BENCH_CONTACTS;i++){
+			float angle = i * 0.01f;
+			Vec3 position = center + Vec3(cos(angle), sin(angle), 0.3f * sin(angle * 3.0f)) * radius;
+			SweptSphere sphere(position, 1.2, 1.65);
+			sphere.getNext()->center = position + Vec3(0, 0, -0.2f);
+			spheres.push_back(sphere);
+			owners.push_back(c);
+		}
+	}
+	if(spheres.empty()){
+		printf("No convex has %u or more vertices.\n", CONVEX_CLIMB_MIN_VERTICES);
+		return 0;
+	}
+
+	std::vector<Uint16> starts(mesh.numConvexes);
+	for(unsigned int c=0;c<mesh.numConvexes;c++){
+		starts[c] = mesh.convexes[c].seed;
+	}
+	Uint32 hits = 0;
+	double plainNs = perCall([&](Uint32 i){
+		Vec3 normal;
+		float distance;
+		hits += gjk(spheres[i], plain.convexes[owners[i]], normal, distance);
+	}, spheres.size());
+	double climbNs = perCall([&](Uint32 i){
+		Vec3 normal;
+		float distance;
+		WarmConvex warm(mesh.convexes[owners[i]], starts[owners[i]]);
+		hits += gjk(spheres[i], warm, normal, distance);
+	}, spheres.size());
+
+	printf("\n%zu sphere steps around large convexes, %.1f%% touching, ns per GJK + EPA:\n", spheres.size(),
+		100.0 * hits / (2 * BENCH_REPEATS * spheres.size()));
+	printf("%-24s %8.1f\n%-24s %8.1f %7.2fx\n", "scan", plainNs, "climb, warm start", climbNs, plainNs / climbNs);
+	return 0;
+}
@@ -0,0 +1,186 @@
+//Benchmark: diffuse texture memory, load time and upload time per model.
+//Compares the old RGBA32F palette expansion against RGBA8 texels, both expanded
+//from the palette at load and read in place from a converted file.
+//Upload times need a GL context and are skipped when no display is available.
+
+#include "models.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <cmath>
+
+#define BENCH_REPEATS 10
+
+typedef std::chrono::steady_clock BenchClock;
+
+//Old loading path: palette expanded to RGBA32F.
+namespace reference{
+	static float* loadDiffuse(const char* filename, Uint32& width, Uint32& height, Uint32& depth){
+		std::ifstream file(filename, std::ios::in|std::ios::binary);
+		if(!file.is_open()){return nullptr;}
+
+		Uint32 attribLength, diffColorsLength, diffIndicesLength;
+		file.read((char*)&attribLength, 4);
+		file.seekg(attribLength, std::ios::cur);
+
+		file.read((char*)&width, 4);
+		file.read((char*)&height, 4);
+		file.read((char*)&depth, 4);
+
+		file.read((char*)&diffColorsLength, 4);
+		float* diffColors = (float*)malloc(diffColorsLength);
+		file.read((char*)diffColors, diffColorsLength);
+
+		file.read((char*)&diffIndicesLength, 4);
+		Uint16* diffIndices = (Uint16*)malloc(diffIndicesLength);
+		file.read((char*)diffIndices, diffIndicesLength);
+
+		Uint32 numTexels = width * height * depth;
+		float* diffuse = (float*)malloc(numTexels * 4 * sizeof(float));
+		for(unsigned int i=0;i<numTexels;i++){
+			memcpy(&diffuse[i*4], &diffColors[diffIndices[i]*4], 4 * sizeof(float));
+		}
+		free(diffColors);
+		free(diffIndices);
+		return diffuse;
+	}
+};
+
+//Milliseconds since start.
+static double since(BenchClock::time_point start){
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+//Write a packed copy of a static model, the same way tools/convert_textures does.
+static bool writePacked(const char* filename, const char* packedName){
+	StaticModelLoader file(filename);
+	if(!file.loaded){return false;}
+
+	std::ofstream out(packedName, std::ios::out|std::ios::binary|std::ios::trunc);
+	Uint32 magic = MODEL_PACKED_MAGIC;
+	out.write((char*)&magic, 4);
+	out.write((char*)&file.attribLength, 4);
+	out.write((char*)file.attributes, file.attribLength);
+	out.write((char*)&file.texWidth, 4);
+	out.write((char*)&file.texHeight, 4);
+	out.write((char*)&file.texDepth, 4);
+	out.write((char*)&file.texLength, 4);
+	out.write((char*)file.diffuse, file.texLength);
+	out.write((char*)&file.metalRoughLength, 4);
+	out.write((char*)file.metalRough, file.metalRoughLength);
+	out.write((char*)file.centroid, 12);
+	out.write((char*)&file.cullRadius, 4);
+	return !out.fail();
+}
+
+//Time one texture upload including the driver copy.
+static double uploadTime(Uint32 format, Uint32 type, Uint32 width, Uint32 height, Uint32 depth, void* data){
+	double best = 1e9;
+	for(unsigned int i=0;i<BENCH_REPEATS;i++){
+		Uint32 texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glFinish();
+
+		auto start = BenchClock::now();
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format, width, height, depth, false, GL_RGBA, type, data);
+		glFinish();
+		best = std::min(best, since(start));
+
+		glDeleteTextures(1, &texture);
+	}
+	return best;
+}
+
+//Create a hidden window for the upload timings.
+static bool createContext(SDL_Window*& window, SDL_GLContext& context){
+	if(SDL_Init(SDL_INIT_VIDEO) != 0){
+		printf("No GL context (%s), upload times skipped.\n\n", SDL_GetError());
+		return false;
+	}
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	window = SDL_CreateWindow("bench", 0, 0, 64, 64, SDL_WINDOW_OPENGL|SDL_WINDOW_HIDDEN);
+	context = window ? SDL_GL_CreateContext(window) : nullptr;
+	glewExperimental = true;
+	if(!context || glewInit() != GLEW_OK){
+		printf("No GL context (%s), upload times skipped.\n\n", SDL_GetError());
+		return false;
+	}
+	return true;
+}
+
+int main(){
+	const char* models[3] = {"res/castle_level.sm", "res/tech_demo.sm", "res/steel_ball.sm"};
+	const char* packedName = "texture_storage_packed.sm";
+
+	SDL_Window* window = nullptr;
+	SDL_GLContext context = nullptr;
+	bool gl = createContext(window, context);
+
+	printf("%-22s %9s %9s %9s %9s %9s %9s %9s %9s\n", "model", "old kB", "rgba8 kB", "old ms", "expand ms",
+		"packed ms", "old up", "rgba8 up", "max diff");
+
+	for(unsigned int m=0;m<3;m++){
+		Uint32 width = 0, height = 0, depth = 0;
+		double oldMs = 1e9, expandMs = 1e9, packedMs = 1e9;
+
+		float* oldDiffuse = nullptr;
+		for(unsigned int i=0;i<BENCH_REPEATS;i++){
+			auto start = BenchClock::now();
+			float* diffuse = reference::loadDiffuse(models[m], width, height, depth);
+			oldMs = std::min(oldMs, since(start));
+			if(oldDiffuse){free(oldDiffuse);}
+			oldDiffuse = diffuse;
+		}
+		if(!oldDiffuse){
+			printf("%-22s failed to load\n", models[m]);
+			continue;
+		}
+
+		for(unsigned int i=0;i<BENCH_REPEATS;i++){
+			auto start = BenchClock::now();
+			StaticModelLoader file(models[m]);
+			expandMs = std::min(expandMs, since(start));
+		}
+
+		writePacked(models[m], packedName);
+		for(unsigned int i=0;i<BENCH_REPEATS;i++){
+			auto start = BenchClock::now();
+			StaticModelLoader file(packedName);
+			volatile Uint8 touch = 0;
+			for(unsigned int j=0;j<file.texLength;j+=4096){touch = touch + file.diffuse[j];}
+			packedMs = std::min(packedMs, since(start));
+		}
+
+		//RGBA8 texels against the old float texels.
+		StaticModelLoader file(packedName);
+		Uint32 numTexels = width * height * depth;
+		float maxDiff = 0.0;
+		for(unsigned int i=0;i<numTexels*4;i++){
+			maxDiff = std::max(maxDiff, (float)fabs(file.diffuse[i] / 255.0 - oldDiffuse[i]));
+		}
+
+		double oldUpload = 0.0, newUpload = 0.0;
+		if(gl){
+			oldUpload = uploadTime(GL_RGBA32F, GL_FLOAT, width, height, depth, oldDiffuse);
+			newUpload = uploadTime(GL_RGBA8, GL_UNSIGNED_BYTE, width, height, depth, file.diffuse);
+		}
+
+		printf("%-22s %9u %9u %9.3f %9.3f %9.3f %9.3f %9.3f %9.6f\n", models[m],
+			numTexels * 16 / 1024, numTexels * 4 / 1024, oldMs, expandMs, packedMs, oldUpload, newUpload, maxDiff);
+
+		free(oldDiffuse);
+	}
+
+	remove(packedName);
+	if(gl){
+		SDL_GL_DeleteContext(context);
+		SDL_DestroyWindow(window);
+		SDL_Quit();
+	}
+	return 0;
+}
@@ -0,0 +1,92 @@
+//Benchmark: vertex memory and vertex shader invocations of triangle soup against indexed, packed vertices.
+//Invocations are counted by running the index stream through a FIFO post-transform cache of a few sizes.
+//Soup runs the shader for every corner. Indexed counts are given in the file's triangle order and in
+//the cache optimized order the loaders produce. Reported as average cache miss ratio, invocations per triangle.
+
+#include "loaders.hpp"
+
+#include <chrono>
+#include <map>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#define BENCH_REPEATS 5
+
+typedef std::chrono::steady_clock BenchClock;
+
+//Shader invocations per triangle of an index stream through a FIFO cache.
+static float missRatio(const std::vector<Uint32>& indices, Uint32 cacheSize){
+	std::vector<Uint32> fifo(cacheSize, 0xFFFFFFFF);
+	Uint32 next = 0, misses = 0;
+	for(unsigned int i=0;i<indices.size();i++){
+		bool hit = false;
+		for(unsigned int j=0;j<cacheSize;j++){
+			hit = hit || fifo[j] == indices[i];
+		}
+		if(!hit){
+			fifo[next] = indices[i];
+			next = (next + 1) % cacheSize;
+			misses++;
+		}
+	}
+	return (float)misses / (indices.size() / 3);
+}
+
+//Indices of a model as loaded.
+static std::vector<Uint32> meshIndices(MeshData& mesh){
+	std::vector<Uint32> indices(mesh.numIndices);
+	for(unsigned int i=0;i<mesh.numIndices;i++){
+		indices[i] = mesh.indexSize == 2 ? ((Uint16*)mesh.indices)[i] : ((Uint32*)mesh.indices)[i];
+	}
+	return indices;
+}
+
+//Indices of soup with identical vertices merged in the file's triangle order, without cache ordering.
+static std::vector<Uint32> fileOrderIndices(const float* attributes, Uint32 attribLength, Uint32 stride){
+	Uint32 numCorners = attribLength / (stride * sizeof(float));
+	std::map<std::vector<float>, Uint32> unique;
+	std::vector<Uint32> indices(numCorners);
+	for(unsigned int i=0;i<numCorners;i++){
+		std::vector<float> vertex(&attributes[i * stride], &attributes[(i + 1) * stride]);
+		auto found = unique.insert(std::make_pair(vertex, (Uint32)unique.size()));
+		indices[i] = found.first->second;
+	}
+	return indices;
+}
+
+template<typename Loader> static void bench(const char* filename, Uint32 stride){
+	double best = 1e9;
+	for(unsigned int r=0;r<BENCH_REPEATS;r++){
+		auto start = BenchClock::now();
+		Loader file(filename);
+		best = std::min(best, std::chrono::duration<double, std::milli>(BenchClock::now() - start).count());
+	}
+
+	Loader file(filename);
+	if(!file.loaded || file.indexed){
+		printf("%-30s needs an unindexed file\n", filename);
+		return;
+	}
+	MeshData& mesh = file.mesh;
+	Uint32 numCorners = file.attribLength / (stride * sizeof(float));
+	Uint32 indexedBytes = mesh.numVertices * mesh.vertexSize + mesh.numIndices * mesh.indexSize;
+	std::vector<Uint32> fileOrder = fileOrderIndices(file.attributes, file.attribLength, stride);
+	std::vector<Uint32> optimized = meshIndices(mesh);
+
+	printf("%-30s %7u %7u %8.1f %8.1f %5.1f%% %8.2f  3.00 %5.2f %5.2f  3.00 %5.2f %5.2f\n", filename, numCorners,
+		mesh.numVertices, file.attribLength / 1024.0, indexedBytes / 1024.0, 100.0 * indexedBytes / file.attribLength, best,
+		missRatio(fileOrder, 16), missRatio(optimized, 16), missRatio(fileOrder, 32), missRatio(optimized, 32));
+}
+
+int main(){
+	printf("%-30s %7s %7s %8s %8s %6s %8s %17s %17s\n", "", "", "", "soup", "indexed", "", "", "fifo 16", "fifo 32");
+	printf("%-30s %7s %7s %8s %8s %6s %8s %5s %5s %5s %5s %5s %5s\n", "model", "corners", "unique", "KiB", "KiB",
+		"share", "load ms", "soup", "file", "opt", "soup", "file", "opt");
+	const char* staticModels[3] = {"res/castle_level.sm", "res/tech_demo.sm", "res/steel_ball.sm"};
+	for(unsigned int i=0;i<3;i++){
+		bench<StaticModelLoader>(staticModels[i], 9);
+	}
+	bench<AnimatedModelLoader>("res/animated_demo.am", 17);
+	return 0;
+}
@@ -0,0 +1,155 @@
+#include "clusters.hpp"
+
+//Tile of a normalized device coordinate.
+static Uint8 ndcToTile(float ndc, Uint32 numTiles){
+	int tile = (int)floor((ndc * 0.5 + 0.5) * numTiles);
+	return (Uint8)std::min(std::max(tile, 0), (int)numTiles - 1);
+}
+
+//Depth slice of a view depth.
+static Uint8 depthToSlice(float depth, float sliceScale, float sliceBias){
+	int slice = (int)floor(log(depth) * sliceScale + sliceBias);
+	return (Uint8)std::min(std::max(slice, 0), CLUSTER_SLICES - 1);
+}
+
+//Cluster ranges of light spheres given in world space. The screen rectangle is taken from the corners
+//of each sphere's view space box cut at the near plane, which is conservative for a perspective proj.
+void LightClusters::calcBounds(Mat4& view, Mat4& proj, float near, float far, const float* x, const float* y, const float* z,
+	const float* radius, Uint32 count, ClusterBounds* bounds, FrameArena& arena){
+
+	float* vx = (float*)arena.allocate(count * sizeof(float));
+	float* vy = (float*)arena.allocate(count * sizeof(float));
+	float* vz = (float*)arena.allocate(count * sizeof(float));
+	view.transform(x, y, z, vx, vy, vz, count);
+
+	float* minX = (float*)arena.allocate(count * sizeof(float));
+	float* maxX = (float*)arena.allocate(count * sizeof(float));
+	float* minY = (float*)arena.allocate(count * sizeof(float));
+	float* maxY = (float*)arena.allocate(count * sizeof(float));
+	float* minDepth = (float*)arena.allocate(count * sizeof(float));
+	float* maxDepth = (float*)arena.allocate(count * sizeof(float));
+
+	//View space looks down -z. Clip w is a linear function of the depth.
+	float scaleX = proj.m[0][0];
+	float scaleY = proj.m[1][1];
+	float wScale = -proj.m[2][3];
+	float wBias = proj.m[3][3];
+
+	unsigned int n = 0;
+#ifdef MATHS_SSE
+	__m128 one = _mm_set1_ps(1.0);
+	__m128 nearPlane = _mm_set1_ps(near);
+	for(;n+4<=count;n+=4){
+		__m128 r = _mm_loadu_ps(&radius[n]);
+		__m128 depth = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&vz[n]));
+		__m128 d0 = _mm_max_ps(_mm_sub_ps(depth, r), nearPlane);
+		__m128 d1 = _mm_add_ps(depth, r);
+		__m128 invW0 = _mm_div_ps(one, _mm_add_ps(_mm_mul_ps(d0, _mm_set1_ps(wScale)), _mm_set1_ps(wBias)));
+		__m128 invW1 = _mm_div_ps(one, _mm_add_ps(_mm_mul_ps(d1, _mm_set1_ps(wScale)), _mm_set1_ps(wBias)));
+
+		__m128 px = _mm_loadu_ps(&vx[n]);
+		__m128 xa = _mm_mul_ps(_mm_set1_ps(scaleX), _mm_sub_ps(px, r));
+		__m128 xb = _mm_mul_ps(_mm_set1_ps(scaleX), _mm_add_ps(px, r));
+		__m128 xa0 = _mm_mul_ps(xa, invW0), xa1 = _mm_mul_ps(xa, invW1);
+		__m128 xb0 = _mm_mul_ps(xb, invW0), xb1 = _mm_mul_ps(xb, invW1);
+		_mm_storeu_ps(&minX[n], _mm_min_ps(_mm_min_ps(xa0, xa1), _mm_min_ps(xb0, xb1)));
+		_mm_storeu_ps(&maxX[n], _mm_max_ps(_mm_max_ps(xa0, xa1), _mm_max_ps(xb0, xb1)));
+
+		__m128 py = _mm_loadu_ps(&vy[n]);
+		__m128 ya = _mm_mul_ps(_mm_set1_ps(scaleY), _mm_sub_ps(py, r));
+		__m128 yb = _mm_mul_ps(_mm_set1_ps(scaleY), _mm_add_ps(py, r));
+		__m128 ya0 = _mm_mul_ps(ya, invW0), ya1 = _mm_mul_ps(ya, invW1);
+		__m128 yb0 = _mm_mul_ps(yb, invW0), yb1 = _mm_mul_ps(yb, invW1);
+		_mm_storeu_ps(&minY[n], _mm_min_ps(_mm_min_ps(ya0, ya1), _mm_min_ps(yb0, yb1)));
+		_mm_storeu_ps(&maxY[n], _mm_max_ps(_mm_max_ps(ya0, ya1), _mm_max_ps(yb0, yb1)));
+
+		_mm_storeu_ps(&minDepth[n], d0);
+		_mm_storeu_ps(&maxDepth[n], d1);
+	}
+#endif
+	for(;n<count;n++){
+		float depth = -vz[n];
+		float d0 = std::max(depth - radius[n], near);
+		float d1 = depth + radius[n];
+		float invW0 = 1.0 / (d0 * wScale + wBias);
+		float invW1 = 1.0 / (d1 * wScale + wBias);
+
+		float xa = scaleX * (vx[n] - radius[n]);
+		float xb = scaleX * (vx[n] + radius[n]);
+		minX[n] = std::min(std::min(xa * invW0, xa * invW1), std::min(xb * invW0, xb * invW1));
+		maxX[n] = std::max(std::max(xa * invW0, xa * invW1), std::max(xb * invW0, xb * invW1));
+
+		float ya = scaleY * (vy[n] - radius[n]);
+		float yb = scaleY * (vy[n] + radius[n]);
+		minY[n] = std::min(std::min(ya * invW0, ya * invW1), std::min(yb * invW0, yb * invW1));
+		maxY[n] = std::max(std::max(ya * invW0, ya * invW1), std::max(yb * invW0, yb * invW1));
+
+		minDepth[n] = d0;
+		maxDepth[n] = d1;
+	}
+
+	for(unsigned int i=0;i<count;i++){
+		if(maxDepth[i] < near || minDepth[i] > far || maxX[i] < -1.0 || minX[i] > 1.0 || maxY[i] < -1.0 || minY[i] > 1.0){
+			bounds[i] = {1, 0, 1, 0, 1, 0};
+			continue;
+		}
+		bounds[i].x0 = ndcToTile(minX[i], CLUSTER_TILES_X);
+		bounds[i].x1 = ndcToTile(maxX[i], CLUSTER_TILES_X);
+		bounds[i].y0 = ndcToTile(minY[i], CLUSTER_TILES_Y);
+		bounds[i].y1 = ndcToTile(maxY[i], CLUSTER_TILES_Y);
+		bounds[i].z0 = depthToSlice(minDepth[i], sliceScale, sliceBias);
+		bounds[i].z1 = depthToSlice(maxDepth[i], sliceScale, sliceBias);
+	}
+}
+
+//Assign lights to clusters. Positions and radii hold the pointlights followed by the spotlights.
+//Everything is allocated from the arena and stays valid until it is reset.
+void LightClusters::build(Mat4 view, Mat4 proj, float near, float far, const float* x, const float* y, const float* z,
+	const float* radius, Uint32 numPointlights, Uint32 numSpotlights, FrameArena& arena){
+
+	sliceScale = CLUSTER_SLICES / log(far / near);
+	sliceBias = -log(near) * sliceScale;
+
+	Uint32 numLights = numPointlights + numSpotlights;
+	ClusterBounds* bounds = (ClusterBounds*)arena.allocate(numLights * sizeof(ClusterBounds));
+	calcBounds(view, proj, near, far, x, y, z, radius, numLights, bounds, arena);
+
+	//Count the lights of each cluster, pointlights in the first cell word and spotlights in the second.
+	cells = (Uint32*)arena.allocate(NUM_CLUSTERS * 2 * sizeof(Uint32));
+	memset(cells, 0, NUM_CLUSTERS * 2 * sizeof(Uint32));
+	for(unsigned int i=0;i<numLights;i++){
+		Uint32 word = i < numPointlights ? 0 : 1;
+		for(unsigned int cz=bounds[i].z0;cz<=bounds[i].z1;cz++){
+			for(unsigned int cy=bounds[i].y0;cy<=bounds[i].y1;cy++){
+				for(unsigned int cx=bounds[i].x0;cx<=bounds[i].x1;cx++){
+					cells[((cz * CLUSTER_TILES_Y + cy) * CLUSTER_TILES_X + cx) * 2 + word]++;
+				}
+			}
+		}
+	}
+
+	//Turn the counts into index ranges.
+	Uint32* cursors = (Uint32*)arena.allocate(NUM_CLUSTERS * sizeof(Uint32));
+	numIndices = 0;
+	for(unsigned int i=0;i<NUM_CLUSTERS;i++){
+		Uint32 numPoint = cells[i * 2];
+		Uint32 numSpot = cells[i * 2 + 1];
+		cells[i * 2] = numIndices;
+		cells[i * 2 + 1] = numPoint | (numSpot << 16);
+		cursors[i] = numIndices;
+		numIndices += numPoint + numSpot;
+	}
+
+	//Pointlights are written first, so they come first within every range.
+	indices = (Uint32*)arena.allocate(std::max(numIndices, 1u) * sizeof(Uint32));
+	for(unsigned int i=0;i<numLights;i++){
+		Uint32 index = i < numPointlights ? i : i - numPointlights;
+		for(unsigned int cz=bounds[i].z0;cz<=bounds[i].z1;cz++){
+			for(unsigned int cy=bounds[i].y0;cy<=bounds[i].y1;cy++){
+				for(unsigned int cx=bounds[i].x0;cx<=bounds[i].x1;cx++){
+					indices[cursors[(cz * CLUSTER_TILES_Y + cy) * CLUSTER_TILES_X + cx]++] = index;
+				}
+			}
+		}
+	}
+}
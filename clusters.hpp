@@ -0,0 +1,32 @@
+#pragma once
+
+#include "3Dmaths.hpp"
+#include "shader.hpp"
+#include "system.hpp"
+
+#define NUM_CLUSTERS (CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES)
+
+//Cluster range touched by one light, inclusive. Empty ranges have every start past its end.
+struct ClusterBounds{
+	Uint8 x0, x1, y0, y1, z0, z1;
+};
+
+//Bins lights into view clusters on the CPU. Each cluster gets a range of the index list holding
+//its pointlights followed by its spotlights, so the light pass only visits lights that can reach it.
+struct LightClusters{
+	LightClusters(){};
+
+	void build(Mat4 view, Mat4 proj, float near, float far, const float* x, const float* y, const float* z,
+		const float* radius, Uint32 numPointlights, Uint32 numSpotlights, FrameArena& arena);
+
+	Uint32* cells = nullptr;	//Two per cluster: first index, pointlight count | spotlight count << 16.
+	Uint32* indices = nullptr;	//Light indices, into the pointlight or spotlight list.
+	Uint32 numIndices = 0;
+
+	float sliceScale = 0.0;		//Depth slice of view depth d is log(d) * sliceScale + sliceBias.
+	float sliceBias = 0.0;
+
+	private:
+	void calcBounds(Mat4& view, Mat4& proj, float near, float far, const float* x, const float* y, const float* z,
+		const float* radius, Uint32 count, ClusterBounds* bounds, FrameArena& arena);
+};
@@ -14,25 +14,61 @@ void C_Physics::handleGravity(float delta){
 	collider.getNext()->center.z += velocity.z * delta * 2.5;
 }
 
-void C_Physics::handleCollision(PhysicsMesh& mesh){
-	Vec3 initDir = Vec3::cross(Vec3::normalize(Vec3(velocity.x+0.01, velocity.y, 0.0)), Vec3(0.0, 0.0, 1.0));
+//Initial GJK search direction derived from velocity.
+Vec3 C_Physics::contactDirection(){
+	return Vec3::cross(Vec3::normalize(Vec3(velocity.x+0.01, velocity.y, 0.0)), Vec3(0.0, 0.0, 1.0));
+}
+
+//Narrow phase check and response against a single convex. Convexes the last query found further away than
+//the collider has moved since are skipped, and the last separating axis is tried before a query from initDir.
+//Both only end queries that prove the pair apart, so contacts depend only on where the collider is. Support
+//searches on large convexes climb from the vertex the last query on them found.
+bool C_Physics::handleContact(BoundingConvex& convex, Vec3 initDir){
+	CachedContact& cached = contactCache.find(convex);
+	if(cached.separated(collider.colliders[0].center, collider.colliders[1].center)){
+		cached.gjk.iterations = 0;
+		return false;
+	}
+	cached.anchor(collider.colliders[0].center, collider.colliders[1].center);
+
 	float distance = 0.0;
 	Vec3 normal(0.0, 0.0, 0.0);
-	for(int i=0;i<mesh.numConvexes;i++){
-		if(gjk(collider, mesh.convexes[i], normal, distance, initDir)){
-			velocity.x -= velocity.x * fabs(normal.x);
-			velocity.y -= velocity.y * fabs(normal.y);
-			if(normal.z > ANGLE_THRESHOLD && velocity.z < 0){
-				velocity.z = 0;
-				onGround = true;
-			}else if(normal.z < -ANGLE_THRESHOLD && velocity.z > 0){
-				velocity.z = 0;
-			}else{
-				velocity.z -= velocity.z * normal.z * normal.z * 0.03;
-			}
-			collider.getNext()->center = collider.getNext()->center + normal * distance;
-			collider.getPrev()->center = collider.getPrev()->center + normal * distance;
+	bool hit;
+	if(convex.neighbors != nullptr){
+		WarmConvex warm(convex, cached.vertex);
+		hit = gjk(collider, warm, normal, distance, initDir, cached.gjk);
+	}else{
+		hit = gjk(collider, convex, normal, distance, initDir, cached.gjk);
+	}
+	if(hit){
+		velocity.x -= velocity.x * fabs(normal.x);
+		velocity.y -= velocity.y * fabs(normal.y);
+		if(normal.z > ANGLE_THRESHOLD && velocity.z < 0){
+			velocity.z = 0;
+			onGround = true;
+		}else if(normal.z < -ANGLE_THRESHOLD && velocity.z > 0){
+			velocity.z = 0;
+		}else{
+			velocity.z -= velocity.z * normal.z * normal.z * 0.03;
 		}
+		collider.getNext()->center = collider.getNext()->center + normal * distance;
+		collider.getPrev()->center = collider.getPrev()->center + normal * distance;
+		return true;
+	}
+	return false;
+}
+
+//Resolve collisions against the convexes the broad phase finds near the collider.
+void C_Physics::handleCollision(PhysicsMesh& mesh){
+	Vec3 initDir = contactDirection();
+
+	//Margin covers the pushes made by earlier contacts in this same pass.
+	AABB box = collider.createBox();
+	box.expand(BROADPHASE_MARGIN);
+	mesh.tree.query(box, candidates);
+
+	for(unsigned int i=0;i<candidates.size();i++){
+		handleContact(mesh.convexes[candidates[i]], initDir);
 	}
 }
 
@@ -46,9 +82,10 @@ void C_Physics::update(float delta){
 	onGround = false;
 }
 
-void Player::init(Vec3 position){
+void Player::init(Vec3 position, PhysicsWorld& world){
 	this->position = position;
-	physics = C_Physics(1.2, 1.65, position + Vec3(0,0,1));
+	this->world = &world;
+	body = world.addSphere(position + Vec3(0,0,1), 1.2, 1.65);
 	runBonus = 0.0;
 }
 
@@ -56,6 +93,7 @@ void Player::input(float delta, Keyboard& kb, Vec3 camRight, Vec3 camFront){
 	if(kb.keyPressed(SDL_SCANCODE_LSHIFT)){runBonus = 4.0;}
 	else{runBonus = 0.0;}
 
+	PhysicsBody& physics = world->getBody(body);
 	physics.velocity.x = 0.0;
 	physics.velocity.y = 0.0;
 	if(kb.keyPressed(SDL_SCANCODE_W)){physics.velocity = physics.velocity + camFront * ((4 + runBonus));}
@@ -68,13 +106,9 @@ void Player::input(float delta, Keyboard& kb, Vec3 camRight, Vec3 camFront){
 	}
 }
 
-void Player::update(float delta, PhysicsMesh& mesh, Renderer* renderer){
-	physics.collider.swapSpheres();
-
-	physics.update(delta);
-	physics.handleCollision(mesh);
-
-	position = physics.collider.getNext()->center + Vec3(0,0,-1);
+//Follow the player's body after the world updated, between its last two steps.
+void Player::update(Renderer* renderer){
+	position = world->getDrawPosition(body) + Vec3(0,0,-1);
 	renderer->uniforms.common.camPosition = position + Vec3(0,0,1.8);
 }
 
@@ -82,3 +116,8 @@ void Level::init(std::string filename){
 	model.init((filename + ".sm").c_str());
 	mesh.init((filename + ".pm").c_str());
 }
+
+void Level::init(std::string filename, AssetStreamer& streamer){
+	streamer.load(&model, (filename + ".sm").c_str());
+	streamer.load(&mesh, (filename + ".pm").c_str());
+}
@@ -5,12 +5,11 @@
 #include "models.hpp"
 #include "system.hpp"
 #include "renderer.hpp"
+#include "streamer.hpp"
+#include "world.hpp"
 
 #include <string>
 
-#define GRAVITY -9.81 * 2
-#define ANGLE_THRESHOLD 0.7
-
 struct C_Physics{
 	C_Physics(){};
 	C_Physics(float radius, float aspect, Vec3 centerPos);
@@ -18,30 +17,37 @@ struct C_Physics{
 
 	void updateGravity(float delta);
 	void handleGravity(float delta);
+	Vec3 contactDirection();
+	bool handleContact(BoundingConvex& convex, Vec3 initDir);
 	void handleCollision(PhysicsMesh& mesh);
 	void update(float delta);
 
 	Vec3 velocity;
 	SweptSphere collider;
 	bool onGround;
+
+	std::vector<Uint32> candidates;	//Broad phase results, kept to reuse the allocation.
+	ContactCache contactCache;		//Last queries on the convexes near the collider.
 };
 
 struct Player{
 	Player(){};
-	void init(Vec3 position);
+	void init(Vec3 position, PhysicsWorld& world);
 	~Player(){};
 
 	void input(float delta, Keyboard& kb, Vec3 right, Vec3 front);
-	void update(float delta, PhysicsMesh& mesh, Renderer* renderer);
+	void update(Renderer* renderer);
 
 	Vec3 position;
-	C_Physics physics;
+	PhysicsWorld* world;
+	Uint32 body;		//Handle of the player's body in the world.
 	float runBonus;
 };
 
 struct Level{
 	Level(){};
 	void init(std::string filename);
+	void init(std::string filename, AssetStreamer& streamer);
 	~Level(){};
 
 	StaticModel model;
@@ -29,23 +29,39 @@ Uint32 L_Test(Renderer* renderer){
 	renderer->uniforms.lights.exposure = 1.2;
 	renderer->setCameraView(1.57, 0.0);
 
-	Player player;
-	player.init(Vec3(2,8,1));
+	//Assets stream in over the first frames. The renderer skips them until they are resident.
+	AssetStreamer streamer;
+	streamer.init();
 
 	Level level;
-	level.init("res/tech_demo");
+	level.init("res/tech_demo", streamer);
+
+	PhysicsWorld world;
+	world.init(&level.mesh, renderer->getJobPool());
+
+	Player player;
+	player.init(Vec3(2,8,1), world);
 
 	AnimatedModel aModel;
-	aModel.init("res/animated_demo.am");
+	streamer.load(&aModel, "res/animated_demo.am");
 
 	Mat4 animated_transforms = (Quat(3.14, Vec3(0,0,1))).toMatrix() * Mat4::translation(-38, 14, 4);
 
 	StaticModel ball_0;
-	ball_0.init("res/steel_ball.sm");
+	streamer.load(&ball_0, "res/steel_ball.sm");
 
 	Animation anim;
-	anim.init("res/animation_demo.ad");
-	float animTimer = 0;
+	streamer.load(&anim, "res/animation_demo.ad");
+	AnimationPlayer animPlayer;
+	animPlayer.play(&anim);
+
+	//Scene objects are culled by the tree before they reach the renderer.
+	SceneTree scene;
+	scene.init(Vec3(0, 40, 0), 128);
+	scene.insert(&level.model, Mat4::identity(), true);
+	scene.insert(&aModel, animated_transforms, &animPlayer);
+	Uint32 ballHandle_0 = scene.insert(&ball_0, Mat4::identity());
+	Uint32 ballHandle_1 = scene.insert(&ball_0, Mat4::identity());
 
 	float timer = 0;
 
@@ -87,6 +103,9 @@ Uint32 L_Test(Renderer* renderer){
 						alive = false;
 						nextLayer = LAYER_TEST;
 					}
+					if(event.key.keysym.scancode == SDL_SCANCODE_P){
+						renderer->printStats();
+					}
 					if(event.key.keysym.scancode == SDL_SCANCODE_M){
 						if(mouseMode){
 							mouseMode = false;
@@ -106,22 +125,23 @@ Uint32 L_Test(Renderer* renderer){
 		}
 
 		//Update -------------------------------------------------------------------------
+		//Physics runs in fixed steps of its own, the frame time only decides how many.
 		clock.update();
-		delta = (delta + clock.dt) * 0.5;
-		//delta = 0.05;
+		delta = clock.dt;
 		if(delta > 0.1){
 			delta = 0.1;
 		}
 
 		timer += delta;
-		player.input(delta, kb, renderer->getCameraRight(), renderer->getCameraFront());
-		player.update(delta, level.mesh, renderer);
-
-		animTimer += delta;
-		if(animTimer >= anim.duration){
-			animTimer = 0;
+		//Hold the world in place until there is ground to stand on.
+		if(level.mesh.resident){
+			player.input(delta, kb, renderer->getCameraRight(), renderer->getCameraFront());
+			world.update(delta);
+			player.update(renderer);
 		}
 
+		animPlayer.update(delta);
+
 		Spotlight spot;
 		spot.position = Vec3(10, 14, 2);
 		spot.radius = 30;
@@ -178,6 +198,8 @@ Uint32 L_Test(Renderer* renderer){
 		renderer->pushLight(spot);
 
 		//Draw ---------------------------------------------------------------------------
+		streamer.update();
+
 		//renderer->uniforms.common.projView = player.camera.getView() * renderer->getWindowProjection(1.5);
 
 		renderer->uniforms.common.time = timer;
@@ -185,10 +207,9 @@ Uint32 L_Test(Renderer* renderer){
 		Vec3 ballPos_0 = Vec3(20, 20, 2) + Vec3(sin(timer)*5, cos(timer)*4, sin(timer*1.2));
 		Vec3 ballPos_1 = Vec3(20, 20, 6) + Vec3(sin(timer*2)*3, cos(timer*2)*4, cos(timer*1.4));
 
-		renderer->drawModel(&level.model, Mat4::identity());
-		renderer->drawModel(&aModel, animated_transforms, &anim, animTimer);
-		renderer->drawModel(&ball_0, Mat4::translation(ballPos_0));
-		renderer->drawModel(&ball_0, Mat4::translation(ballPos_1));
+		scene.move(ballHandle_0, Mat4::translation(ballPos_0));
+		scene.move(ballHandle_1, Mat4::translation(ballPos_1));
+		scene.draw(renderer);
 		//Display ------------------------------
 		emap.bind(4);
 
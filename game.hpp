@@ -4,6 +4,7 @@
 #include "entities.hpp"
 #include "graphics.hpp"
 #include "system.hpp"
+#include "scene.hpp"
 
 #define LAYER_TEST 1
 
@@ -0,0 +1,115 @@
+#include "jobs.hpp"
+
+//Start the worker threads. With none the calling thread runs every job in wait().
+void JobPool::init(Uint32 numWorkers){
+	numWorkers = std::min(numWorkers, (Uint32)JOB_MAX_WORKERS);
+	numQueues = numWorkers + 1;
+	running = true;
+
+	for(unsigned int i=0;i<numWorkers;i++){
+		workers.push_back(std::thread(&JobPool::work, this, i));
+	}
+}
+
+//Stop the workers. Jobs still queued are dropped, so wait on every loop first.
+JobPool::~JobPool(){
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	wake.notify_all();
+
+	for(unsigned int i=0;i<workers.size();i++){
+		workers[i].join();
+	}
+}
+
+//Number of worker threads, not counting the calling thread.
+Uint32 JobPool::numWorkers(){
+	return numQueues - 1;
+}
+
+//Queue a loop over count items in ranges of grain items. Returns at once, wait on the counter for the results.
+//Ranges are dealt round robin, so every queue starts with a share and stealing only evens out the rest.
+void JobPool::parallelFor(JobFunction function, void* data, Uint32 count, Uint32 grain, JobCounter& counter){
+	if(count == 0){
+		return;
+	}
+	grain = std::max(grain, 1u);
+	Uint32 numJobs = (count + grain - 1) / grain;
+	counter.pending += numJobs;
+
+	//Counted before they are queued, so taking one never sees the count below zero.
+	queued += numJobs;
+	for(unsigned int i=0;i<numJobs;i++){
+		Job job = {function, data, i * grain, std::min((i + 1) * grain, count), &counter};
+		WorkQueue& queue = queues[nextQueue];
+		nextQueue = (nextQueue + 1) % numQueues;
+
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+	}
+
+	//Taking the lock orders the count against workers about to sleep.
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_all();
+}
+
+//Run jobs until every job of the counter has finished. Jobs of other loops may be run meanwhile.
+void JobPool::wait(JobCounter& counter){
+	Job job;
+	while(counter.pending.load() > 0){
+		if(take(numQueues - 1, job)){
+			run(job);
+		}else{
+			std::this_thread::yield();
+		}
+	}
+}
+
+//Worker loop. Sleeps while no queue holds a job.
+void JobPool::work(Uint32 index){
+	Job job;
+	while(true){
+		if(take(index, job)){
+			run(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [&]{return queued.load() > 0 || !running;});
+		if(!running){
+			return;
+		}
+	}
+}
+
+//Take a job from the back of a queue, or steal one from the front of another.
+bool JobPool::take(Uint32 index, Job& job){
+	for(unsigned int i=0;i<numQueues;i++){
+		WorkQueue& queue = queues[(index + i) % numQueues];
+
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(queue.jobs.empty()){
+			continue;
+		}
+		if(i == 0){
+			job = queue.jobs.back();
+			queue.jobs.pop_back();
+		}else{
+			job = queue.jobs.front();
+			queue.jobs.pop_front();
+		}
+		queued--;
+		return true;
+	}
+	return false;
+}
+
+//Run a job and count it done.
+void JobPool::run(Job& job){
+	job.function(job.data, job.first, job.end);
+	job.counter->pending--;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#define JOB_MAX_WORKERS 32
+
+//Work on the items first to end of a parallel loop.
+typedef void (*JobFunction)(void* data, Uint32 first, Uint32 end);
+
+//Counts the unfinished jobs of a parallel loop.
+struct JobCounter{
+	std::atomic<Uint32> pending{0};
+};
+
+//A range of a parallel loop.
+struct Job{
+	JobFunction function;
+	void* data;
+	Uint32 first, end;
+	JobCounter* counter;
+};
+
+//Pool of worker threads for short frame work. Every worker and the calling thread own a queue.
+//Loops are cut into ranges spread over the queues, owners take from the back of their queue and
+//threads that run dry steal from the front of the others. The calling thread works while it waits.
+struct JobPool{
+	JobPool(){};
+	void init(Uint32 numWorkers);
+	~JobPool();
+
+	void parallelFor(JobFunction function, void* data, Uint32 count, Uint32 grain, JobCounter& counter);
+	void wait(JobCounter& counter);
+	Uint32 numWorkers();
+
+	private:
+	struct WorkQueue{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	void work(Uint32 index);
+	bool take(Uint32 index, Job& job);
+	static void run(Job& job);
+
+	std::vector<std::thread> workers;
+	WorkQueue queues[JOB_MAX_WORKERS + 1];	//One per worker, then one for the calling thread.
+	Uint32 numQueues = 1;
+	std::mutex sleepMutex;
+	std::condition_variable wake;			//Signals sleeping workers about new jobs.
+	std::atomic<Uint32> queued{0};			//Jobs in all queues.
+	Uint32 nextQueue = 0;					//Queue receiving the next range.
+	bool running = false;
+};
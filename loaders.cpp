@@ -2,247 +2,1053 @@
 
 #include <fstream>
 #include <iostream>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+//Map a file into memory. Falls back to reading it into a heap buffer where mmap is not available.
+bool MappedFile::open(const char* filename){
+	close();
+
+#if defined(__unix__) || defined(__APPLE__)
+	int fd = ::open(filename, O_RDONLY);
+	if(fd < 0){
+		return false;
+	}
+
+	struct stat info;
+	if(fstat(fd, &info) != 0 || info.st_size == 0){
+		::close(fd);
+		return false;
+	}
+
+	void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(address != MAP_FAILED){
+		data = (char*)address;
+		length = info.st_size;
+		mapped = true;
+		return true;
+	}
+#endif
+
+	std::ifstream stream(filename, std::ios::in|std::ios::binary|std::ios::ate);
+	if(!stream.is_open()){
+		return false;
+	}
+	length = stream.tellg();
+	data = (char*)malloc(length);
+	stream.seekg(0);
+	stream.read(data, length);
+	stream.close();
+	mapped = false;
+
+	return true;
+}
+
+//Take over another mapping, leaving it empty.
+MappedFile::MappedFile(MappedFile&& other){
+	*this = std::move(other);
+}
+
+//Unmap this file and take over another mapping, leaving it empty.
+MappedFile& MappedFile::operator=(MappedFile&& other){
+	if(this != &other){
+		close();
+		data = other.data;
+		length = other.length;
+		cursor = other.cursor;
+		mapped = other.mapped;
+		other.data = nullptr;
+		other.length = 0;
+		other.cursor = 0;
+		other.mapped = false;
+	}
+	return *this;
+}
+
+//Unmap the file.
+void MappedFile::close(){
+	if(data){
+#if defined(__unix__) || defined(__APPLE__)
+		if(mapped){
+			munmap(data, length);
+		}else{
+			free(data);
+		}
+#else
+		free(data);
+#endif
+	}
+	data = nullptr;
+	length = 0;
+	cursor = 0;
+	mapped = false;
+}
+
+//Copy bytes from the read position. Fails if the file is too short.
+bool MappedFile::read(void* destination, size_t size){
+	if(data == nullptr || cursor + size > length){
+		return false;
+	}
+	memcpy(destination, data + cursor, size);
+	cursor += size;
+	return true;
+}
+
+//Return a pointer to bytes at the read position and skip over them. Returns nullptr if the file is too short.
+char* MappedFile::take(size_t size){
+	if(data == nullptr || cursor + size > length){
+		return nullptr;
+	}
+	char* result = data + cursor;
+	cursor += size;
+	return result;
+}
+
+//Bounding sphere of the positions in interleaved attribute data. For files older than the stored bounds.
+static void calcBounds(const float* attributes, Uint32 attribLength, Uint32 stride, float* centroid, float& cullRadius){
+	Uint32 numVertices = attribLength / (stride * sizeof(float));
+	float min[3] = {0.0, 0.0, 0.0};
+	float max[3] = {0.0, 0.0, 0.0};
+	for(unsigned int i=0;i<numVertices;i++){
+		for(unsigned int j=0;j<3;j++){
+			float value = attributes[i * stride + j];
+			min[j] = (i == 0 || value < min[j]) ? value : min[j];
+			max[j] = (i == 0 || value > max[j]) ? value : max[j];
+		}
+	}
+
+	float radiusSquare = 0.0;
+	for(unsigned int j=0;j<3;j++){
+		centroid[j] = (min[j] + max[j]) * 0.5;
+	}
+	for(unsigned int i=0;i<numVertices;i++){
+		float distSquare = 0.0;
+		for(unsigned int j=0;j<3;j++){
+			float d = attributes[i * stride + j] - centroid[j];
+			distSquare += d * d;
+		}
+		radiusSquare = distSquare > radiusSquare ? distSquare : radiusSquare;
+	}
+	cullRadius = sqrt(radiusSquare);
+}
+
+//Split a range of triangles at the median of the longest axis of their centers until it is small enough.
+//Centers hold three floats per triangle. Ranges of the finished chunks are appended in order.
+static void splitTriangles(const float* centers, Uint32* order, Uint32 first, Uint32 end, std::vector<Uint32>& ranges){
+	float min[3], max[3];
+	for(unsigned int j=0;j<3;j++){
+		min[j] = centers[order[first] * 3 + j];
+		max[j] = min[j];
+	}
+	for(unsigned int i=first+1;i<end;i++){
+		for(unsigned int j=0;j<3;j++){
+			min[j] = std::min(min[j], centers[order[i] * 3 + j]);
+			max[j] = std::max(max[j], centers[order[i] * 3 + j]);
+		}
+	}
+
+	float extent[3] = {max[0] - min[0], max[1] - min[1], max[2] - min[2]};
+	float halfDiagonal = sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]) * 0.5;
+	if(halfDiagonal <= MODEL_CHUNK_RADIUS || end - first <= MODEL_CHUNK_MIN_TRIANGLES){
+		ranges.push_back(end);
+		return;
+	}
+
+	Uint32 axis = extent[0] > extent[1] ? (extent[0] > extent[2] ? 0 : 2) : (extent[1] > extent[2] ? 1 : 2);
+	Uint32 middle = first + (end - first) / 2;
+	std::nth_element(order + first, order + middle, order + end, [&](Uint32 a, Uint32 b){
+		return centers[a * 3 + axis] < centers[b * 3 + axis];
+	});
+	splitTriangles(centers, order, first, middle, ranges);
+	splitTriangles(centers, order, middle, end, ranges);
+}
+
+//Partition the triangles of a static model into spatial chunks. Models that fit one chunk keep their
+//attributes in place, others get them reordered into a heap buffer with each chunk's triangles adjacent.
+//Indices are built from the attributes in the same triangle order, so chunk ranges hold for both.
+static void buildChunks(StaticModelLoader& model){
+	const Uint32 stride = 9;
+	Uint32 numTriangles = model.attribLength / (stride * 3 * sizeof(float));
+
+	model.numChunks = 1;
+	model.chunks = (ModelChunk*)malloc(sizeof(ModelChunk));
+	model.chunks[0].firstIndex = 0;
+	model.chunks[0].numIndices = numTriangles * 3;
+	memcpy(model.chunks[0].centroid, model.centroid, 12);
+	model.chunks[0].cullRadius = model.cullRadius;
+	if(model.cullRadius <= MODEL_CHUNK_RADIUS || numTriangles <= MODEL_CHUNK_MIN_TRIANGLES){
+		return;
+	}
+
+	//Triangles bigger than a chunk would stretch the bounds of every chunk they land in, so they are split on their own.
+	float* centers = (float*)malloc(numTriangles * 3 * sizeof(float));
+	Uint32* order = (Uint32*)malloc(numTriangles * sizeof(Uint32));
+	Uint32 numSmall = 0;
+	Uint32 numLarge = 0;
+	for(unsigned int i=0;i<numTriangles;i++){
+		const float* triangle = &model.attributes[i * stride * 3];
+		float radiusSquare = 0.0;
+		for(unsigned int j=0;j<3;j++){
+			centers[i * 3 + j] = (triangle[j] + triangle[stride + j] + triangle[stride * 2 + j]) / 3.0;
+		}
+		for(unsigned int k=0;k<3;k++){
+			float distSquare = 0.0;
+			for(unsigned int j=0;j<3;j++){
+				float d = triangle[stride * k + j] - centers[i * 3 + j];
+				distSquare += d * d;
+			}
+			radiusSquare = std::max(radiusSquare, distSquare);
+		}
+		if(radiusSquare > MODEL_CHUNK_RADIUS * MODEL_CHUNK_RADIUS){
+			order[numTriangles - ++numLarge] = i;
+		}else{
+			order[numSmall++] = i;
+		}
+	}
+
+	std::vector<Uint32> ranges;
+	if(numSmall > 0){
+		splitTriangles(centers, order, 0, numSmall, ranges);
+	}
+	if(numLarge > 0){
+		splitTriangles(centers, order, numSmall, numTriangles, ranges);
+	}
+
+	const Uint32 triangleSize = stride * 3 * sizeof(float);
+	model.reordered = (float*)malloc(numTriangles * triangleSize);
+	for(unsigned int i=0;i<numTriangles;i++){
+		memcpy(&model.reordered[i * stride * 3], &model.attributes[order[i] * stride * 3], triangleSize);
+	}
+	model.attributes = model.reordered;
+
+	model.numChunks = ranges.size();
+	model.chunks = (ModelChunk*)realloc(model.chunks, model.numChunks * sizeof(ModelChunk));
+	Uint32 first = 0;
+	for(unsigned int i=0;i<model.numChunks;i++){
+		ModelChunk& chunk = model.chunks[i];
+		chunk.firstIndex = first * 3;
+		chunk.numIndices = (ranges[i] - first) * 3;
+		calcBounds(&model.attributes[chunk.firstIndex * stride], chunk.numIndices * stride * sizeof(float), stride,
+			chunk.centroid, chunk.cullRadius);
+		first = ranges[i];
+	}
+
+	free(centers);
+	free(order);
+}
+
+//Half float of a float, rounded to nearest. Values too small for a normal half become zero.
+static Uint16 floatToHalf(float value){
+	Uint32 bits;
+	memcpy(&bits, &value, 4);
+	Uint16 sign = (bits >> 16) & 0x8000;
+	Sint32 exponent = (Sint32)((bits >> 23) & 0xFF) - 127 + 15;
+	Uint32 mantissa = bits & 0x7FFFFF;
+
+	if(exponent <= 0){
+		return sign;
+	}
+	if(exponent >= 31){
+		return sign | 0x7C00;
+	}
+
+	//Rounding may carry into the exponent, which is still the correctly rounded half.
+	Uint32 half = ((Uint32)exponent << 10) | (mantissa >> 13);
+	half += (mantissa >> 12) & 1;
+	return sign | (Uint16)std::min(half, (Uint32)0x7C00);
+}
+
+//Normalized short of a value between -1 and 1.
+static Sint16 floatToSnorm(float value){
+	return (Sint16)lround(fmin(fmax(value, -1.0), 1.0) * 32767.0);
+}
+
+//Pack one vertex of interleaved attribute data. Stride is 9 floats for static and 17 for animated models.
+static void packVertex(const float* attribute, Uint32 stride, float uvScale, Uint8* destination){
+	PackedVertex vertex;
+	memcpy(vertex.position, attribute, 12);
+	vertex.uv[0] = floatToSnorm(attribute[3] / uvScale);
+	vertex.uv[1] = floatToSnorm(attribute[4] / uvScale);
+	vertex.normal[0] = floatToHalf(attribute[6]);
+	vertex.normal[1] = floatToHalf(attribute[7]);
+	vertex.normal[2] = floatToHalf(attribute[8]);
+	vertex.normal[3] = floatToHalf(attribute[5]);
+	if(stride == 9){
+		memcpy(destination, &vertex, sizeof(PackedVertex));
+		return;
+	}
+
+	//Weights are rounded to 8 bits and the largest one takes the rounding error, so they still sum to one.
+	PackedSkinnedVertex skinned;
+	memcpy(&skinned, &vertex, sizeof(PackedVertex));
+	float sum = attribute[13] + attribute[14] + attribute[15] + attribute[16];
+	Sint32 total = 0;
+	Uint32 largest = 0;
+	for(unsigned int i=0;i<4;i++){
+		skinned.bones[i] = (Uint8)fmin(fmax(attribute[9 + i], 0.0), 255.0);
+		skinned.weights[i] = sum > 0.0 ? (Uint8)lround(fmax(attribute[13 + i], 0.0) / sum * 255.0) : (i == 0 ? 255 : 0);
+		total += skinned.weights[i];
+		largest = skinned.weights[i] > skinned.weights[largest] ? i : largest;
+	}
+	skinned.weights[largest] = (Uint8)(skinned.weights[largest] + 255 - total);
+	memcpy(destination, &skinned, sizeof(PackedSkinnedVertex));
+}
+
+//Score of a vertex for the cache optimizer. Vertices in the cache score by how recently they were used,
+//the three of the last triangle a bit less so the next triangle does not just flip around an edge.
+//Vertices with few triangles left score higher so they get finished instead of leaving lone triangles.
+static float cacheScore(Sint32 cachePosition, Uint32 remaining){
+	if(remaining == 0){
+		return -1.0;
+	}
+	float score = 0.0;
+	if(cachePosition >= 3){
+		score = pow(1.0 - (float)(cachePosition - 3) / (VERTEX_CACHE_SIZE - 3), 1.5);
+	}else if(cachePosition >= 0){
+		score = 0.75;
+	}
+	return score + 2.0 / sqrt((float)remaining);
+}
+
+//Reorder the triangles of an index range for the post-transform vertex cache, after Forsyth's linear-speed
+//vertex cache optimisation. Triangles are emitted greedily by the score of their vertices in a simulated cache.
+//Local is scratch of one entry per model vertex, all 0xFFFFFFFF, and is left that way.
+static void optimizeTriangles(Uint32* indices, Uint32 numIndices, Uint32* local){
+	const Uint32 none = 0xFFFFFFFF;
+	Uint32 numTriangles = numIndices / 3;
+
+	//Compact the vertices of the range.
+	std::vector<Uint32> corners(numIndices), global;
+	for(unsigned int i=0;i<numIndices;i++){
+		if(local[indices[i]] == none){
+			local[indices[i]] = global.size();
+			global.push_back(indices[i]);
+		}
+		corners[i] = local[indices[i]];
+	}
+	Uint32 numVertices = global.size();
+	for(unsigned int i=0;i<numVertices;i++){
+		local[global[i]] = none;
+	}
+
+	//Triangles of every vertex. The first remaining[v] entries of a vertex's list are not emitted yet.
+	std::vector<Uint32> remaining(numVertices, 0), offsets(numVertices + 1, 0), adjacency(numIndices);
+	for(unsigned int i=0;i<numIndices;i++){
+		remaining[corners[i]]++;
+	}
+	for(unsigned int i=0;i<numVertices;i++){
+		offsets[i + 1] = offsets[i] + remaining[i];
+		remaining[i] = 0;
+	}
+	for(unsigned int i=0;i<numIndices;i++){
+		Uint32 vertex = corners[i];
+		adjacency[offsets[vertex] + remaining[vertex]++] = i / 3;
+	}
+
+	std::vector<Sint32> cachePositions(numVertices, -1);
+	std::vector<float> vertexScores(numVertices);
+	std::vector<bool> emitted(numTriangles, false);
+	for(unsigned int i=0;i<numVertices;i++){
+		vertexScores[i] = cacheScore(-1, remaining[i]);
+	}
+	Uint32 best = 0;
+	float bestScore = -1.0;
+	for(unsigned int i=0;i<numTriangles;i++){
+		float score = vertexScores[corners[i * 3]] + vertexScores[corners[i * 3 + 1]] + vertexScores[corners[i * 3 + 2]];
+		if(score > bestScore){
+			bestScore = score;
+			best = i;
+		}
+	}
+
+	Uint32 cache[VERTEX_CACHE_SIZE + 3];
+	Uint32 cacheSize = 0;
+	Uint32 scan = 0;
+	std::vector<Uint32> result(numIndices);
+	for(unsigned int n=0;n<numTriangles;n++){
+		//No cached vertex has triangles left, take the next one in the original order.
+		if(best == none){
+			while(emitted[scan]){
+				scan++;
+			}
+			best = scan;
+		}
+
+		emitted[best] = true;
+		Uint32 newCache[VERTEX_CACHE_SIZE + 3];
+		for(unsigned int k=0;k<3;k++){
+			Uint32 vertex = corners[best * 3 + k];
+			result[n * 3 + k] = indices[best * 3 + k];
+			newCache[k] = vertex;
+
+			Uint32* list = &adjacency[offsets[vertex]];
+			for(unsigned int j=0;j<remaining[vertex];j++){
+				if(list[j] == best){
+					list[j] = list[--remaining[vertex]];
+					break;
+				}
+			}
+		}
+
+		//The triangle's vertices move to the front, the rest shift back and the last ones fall out.
+		Uint32 newSize = 3;
+		for(unsigned int i=0;i<cacheSize;i++){
+			if(cache[i] != newCache[0] && cache[i] != newCache[1] && cache[i] != newCache[2]){
+				newCache[newSize++] = cache[i];
+			}
+		}
+		for(unsigned int i=0;i<newSize;i++){
+			Uint32 vertex = newCache[i];
+			cachePositions[vertex] = i < VERTEX_CACHE_SIZE ? i : -1;
+			vertexScores[vertex] = cacheScore(cachePositions[vertex], remaining[vertex]);
+		}
+
+		//Only triangles of vertices whose score changed need rescoring, and the next one is among them.
+		best = none;
+		bestScore = -1.0;
+		for(unsigned int i=0;i<newSize;i++){
+			Uint32 vertex = newCache[i];
+			for(unsigned int j=0;j<remaining[vertex];j++){
+				Uint32 triangle = adjacency[offsets[vertex] + j];
+				float score = vertexScores[corners[triangle * 3]] + vertexScores[corners[triangle * 3 + 1]] + vertexScores[corners[triangle * 3 + 2]];
+				if(score > bestScore){
+					bestScore = score;
+					best = triangle;
+				}
+			}
+		}
+
+		cacheSize = std::min(newSize, (Uint32)VERTEX_CACHE_SIZE);
+		memcpy(cache, newCache, cacheSize * sizeof(Uint32));
+	}
+
+	memcpy(indices, result.data(), numIndices * sizeof(Uint32));
+}
+
+//Build indexed vertices from interleaved attribute data. Vertices are packed and identical ones merged,
+//triangles are ordered for the vertex cache within every range and the vertices renumbered by first use,
+//so they are fetched in order. Ranges hold the end index of every range that must keep its triangles.
+static void buildMesh(MeshData& mesh, const float* attributes, Uint32 attribLength, Uint32 stride, const Uint32* ranges, Uint32 numRanges){
+	Uint32 numCorners = attribLength / (stride * sizeof(float));
+	mesh.vertexSize = stride == 9 ? sizeof(PackedVertex) : sizeof(PackedSkinnedVertex);
+
+	//UVs are stored as fractions of the smallest power of two holding all of them.
+	float uvMax = 1.0;
+	for(unsigned int i=0;i<numCorners;i++){
+		uvMax = std::max(uvMax, (float)std::max(fabs(attributes[i * stride + 3]), fabs(attributes[i * stride + 4])));
+	}
+	mesh.uvScale = exp2(ceil(log2(uvMax)));
+
+	Uint32 tableSize = 1;
+	while(tableSize < numCorners * 2){
+		tableSize <<= 1;
+	}
+	std::vector<Uint32> table(tableSize, 0xFFFFFFFF), indices(numCorners);
+	std::vector<Uint8> unique(numCorners * mesh.vertexSize);
+	Uint8 packedVertex[sizeof(PackedSkinnedVertex)];
+	Uint32 numUnique = 0;
+	for(unsigned int i=0;i<numCorners;i++){
+		packVertex(&attributes[i * stride], stride, mesh.uvScale, packedVertex);
+
+		//FNV-1a over the packed bytes, so only vertices that pack the same are merged.
+		Uint32 hash = 2166136261u;
+		for(unsigned int j=0;j<mesh.vertexSize;j++){
+			hash = (hash ^ packedVertex[j]) * 16777619u;
+		}
+		Uint32 slot = hash & (tableSize - 1);
+		while(table[slot] != 0xFFFFFFFF && memcmp(&unique[table[slot] * mesh.vertexSize], packedVertex, mesh.vertexSize) != 0){
+			slot = (slot + 1) & (tableSize - 1);
+		}
+		if(table[slot] == 0xFFFFFFFF){
+			table[slot] = numUnique;
+			memcpy(&unique[numUnique++ * mesh.vertexSize], packedVertex, mesh.vertexSize);
+		}
+		indices[i] = table[slot];
+	}
+
+	std::vector<Uint32> scratch(numUnique, 0xFFFFFFFF);
+	Uint32 first = 0;
+	for(unsigned int i=0;i<numRanges;i++){
+		optimizeTriangles(&indices[first], ranges[i] - first, scratch.data());
+		first = ranges[i];
+	}
+
+	//Renumber by first use. Scratch is all unset again after optimizing.
+	Uint32 numVertices = 0;
+	for(unsigned int i=0;i<numCorners;i++){
+		if(scratch[indices[i]] == 0xFFFFFFFF){
+			scratch[indices[i]] = numVertices++;
+		}
+		indices[i] = scratch[indices[i]];
+	}
+
+	mesh.numVertices = numVertices;
+	mesh.numIndices = numCorners;
+	mesh.indexSize = numVertices <= 0xFFFF ? 2 : 4;
+	Uint32 vertexLength = numVertices * mesh.vertexSize;
+	mesh.built = (Uint8*)malloc(vertexLength + numCorners * mesh.indexSize);
+	mesh.vertices = mesh.built;
+	mesh.indices = mesh.built + vertexLength;
+	for(unsigned int i=0;i<numUnique;i++){
+		if(scratch[i] != 0xFFFFFFFF){
+			memcpy(&mesh.vertices[scratch[i] * mesh.vertexSize], &unique[i * mesh.vertexSize], mesh.vertexSize);
+		}
+	}
+	for(unsigned int i=0;i<numCorners;i++){
+		if(mesh.indexSize == 2){
+			((Uint16*)mesh.indices)[i] = (Uint16)indices[i];
+		}else{
+			((Uint32*)mesh.indices)[i] = indices[i];
+		}
+	}
+}
+
+//Read indexed vertices of a model in place. The vertex size must be the one of the model's packed vertex type.
+//Meshes too large to size or with indices past their vertices are rejected, since they go to the GPU as is.
+static bool readMesh(MappedFile& file, MeshData& mesh, Uint32 vertexSize, const char* filename){
+	if(!file.read(&mesh.vertexSize, 4) || mesh.vertexSize != vertexSize){return false;}
+	if(!file.read(&mesh.numVertices, 4)){return false;}
+	Uint64 vertexLength = (Uint64)mesh.numVertices * vertexSize;
+	if(vertexLength > 0xFFFFFFFF){
+		std::cout<<"WARNING: "<<filename<<" has too many vertices!"<<std::endl;
+		return false;
+	}
+	mesh.vertices = (Uint8*)file.take(vertexLength);
+
+	//Index data is padded to whole words.
+	if(!file.read(&mesh.indexSize, 4) || (mesh.indexSize != 2 && mesh.indexSize != 4)){return false;}
+	if(!file.read(&mesh.numIndices, 4)){return false;}
+	Uint64 indexLength = ((Uint64)mesh.numIndices * mesh.indexSize + 3) & ~3ull;
+	if(indexLength > 0xFFFFFFFF){
+		std::cout<<"WARNING: "<<filename<<" has too many indices!"<<std::endl;
+		return false;
+	}
+	mesh.indices = (Uint8*)file.take(indexLength);
+
+	if(!file.read(&mesh.uvScale, 4)){return false;}
+	if(mesh.vertices == nullptr || mesh.indices == nullptr){return false;}
+
+	for(unsigned int i=0;i<mesh.numIndices;i++){
+		Uint32 index = mesh.indexSize == 2 ? ((Uint16*)mesh.indices)[i] : ((Uint32*)mesh.indices)[i];
+		if(index >= mesh.numVertices){
+			std::cout<<"WARNING: "<<filename<<" has an index past its vertices!"<<std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+//Read the diffuse texture of a model as RGBA8. Packed files hold the texels and are used in place.
+//Older files hold a float palette with Uint16 indices, which is expanded here.
+static bool readDiffuse(MappedFile& file, bool packed, Uint32 numTexels, Uint8*& diffuse, Uint8*& expanded, Uint32& texLength){
+	if(packed){
+		if(!file.read(&texLength, 4) || texLength != numTexels * 4){return false;}
+		diffuse = (Uint8*)file.take(texLength);
+		return diffuse != nullptr;
+	}
+
+	Uint32 diffColorsLength;	//Length of indexed diffuse color buffer.
+	Uint32 diffIndicesLength;	//Length of the buffer containing the indices.
+
+	if(!file.read(&diffColorsLength, 4)){return false;}
+	float* diffColors = (float*)file.take(diffColorsLength);
+
+	if(!file.read(&diffIndicesLength, 4)){return false;}
+	Uint16* diffIndices = (Uint16*)file.take(diffIndicesLength);
+
+	if(!diffColors || !diffIndices || diffIndicesLength < numTexels * sizeof(Uint16)){
+		return false;
+	}
+
+	//Palette entries are 8 bit colors stored as floats, so converting them back is lossless.
+	Uint32 numColors = diffColorsLength / (4 * sizeof(float));
+	if(numColors == 0 || numColors > MODEL_MAX_PALETTE_COLORS){
+		return false;
+	}
+	std::vector<Uint32> palette(numColors);
+	Uint8* paletteBytes = (Uint8*)palette.data();
+	for(unsigned int i=0;i<numColors*4;i++){
+		paletteBytes[i] = (Uint8)(fmin(fmax(diffColors[i], 0.0), 1.0) * 255.0 + 0.5);
+	}
+
+	texLength = numTexels * 4;
+	expanded = (Uint8*)malloc(texLength);
+	Uint32* texels = (Uint32*)expanded;
+	for(unsigned int i=0;i<numTexels;i++){
+		texels[i] = diffIndices[i] < numColors ? palette[diffIndices[i]] : 0;
+	}
+	diffuse = expanded;
+
+	return true;
+}
+
+//Point a clip's arrays into a block and return the bytes it needs. Pass no block to only size it.
+//Counts of keys and tracks must be set.
+static Uint32 layoutClip(ClipData& clip, Uint32 numFrames, Uint32 numBones, Uint8* block){
+	Uint32 numTracks = clip.numTracks[0] + clip.numTracks[1] + clip.numTracks[2];
+	Uint32 stride = (numBones + 3) & ~3u;
+	clip.keySize = clip.numTracks[0] * 12 + ((clip.numTracks[1] * 6 + 3) & ~3u) + clip.numTracks[2] * 12;
+
+	Uint32 constants = ((clip.numKeys + numFrames + numTracks) * 2 + 3) & ~3u;
+	Uint32 keys = constants + ANIM_CHANNELS * stride * sizeof(float);
+	clip.size = keys + clip.numKeys * clip.keySize;
+	if(block != nullptr){
+		clip.keyFrames = (Uint16*)block;
+		clip.frameKeys = clip.keyFrames + clip.numKeys;
+		clip.trackBones = clip.frameKeys + numFrames;
+		clip.constants = (float*)(block + constants);
+		clip.keys = block + keys;
+	}
+	return clip.size;
+}
+
+//Quantize a quaternion to its three smallest components. q and -q are the same rotation, so the largest
+//component is made positive and restored from the others.
+static void quantizeRotation(const float* rotation, Uint16* result){
+	Uint32 largest = 0;
+	for(unsigned int i=1;i<4;i++){
+		if(fabs(rotation[i]) > fabs(rotation[largest])){
+			largest = i;
+		}
+	}
+	float sign = rotation[largest] < 0 ? -1.0 : 1.0;
+
+	Uint32 component = 0;
+	for(unsigned int i=0;i<4;i++){
+		if(i == largest){
+			continue;
+		}
+		float value = (rotation[i] * sign * (float)M_SQRT2 + 1.0f) * 0.5f;
+		result[component++] = (Uint16)std::min(std::max(lround(value * 32767.0), 0l), 32767l);
+	}
+	result[0] |= (largest & 1) << 15;
+	result[1] |= (largest >> 1) << 15;
+}
+
+//Channel of a joint in interleaved joint data. Older files without scale read as scale one.
+static float jointChannel(const float* joints, Uint32 jointFloats, Uint32 joint, Uint32 channel){
+	return channel < jointFloats ? joints[joint * jointFloats + channel] : 1.0f;
+}
+
+//Largest difference of a track between a joint and the interpolation of two others. Rotations are slerped
+//along the shorter arc and compared in the same hemisphere.
+static float trackError(const float* joints, Uint32 jointFloats, Uint32 group, Uint32 a, Uint32 b, Uint32 joint, float t){
+	const Uint32 first[3] = {ANIM_TRANSLATION, ANIM_ROTATION, ANIM_SCALE};
+	float error = 0.0;
+	if(group == 1){
+		float qa[4], qb[4], qj[4];
+		float dot = 0.0;
+		for(unsigned int c=0;c<4;c++){
+			qa[c] = jointChannel(joints, jointFloats, a, ANIM_ROTATION + c);
+			qb[c] = jointChannel(joints, jointFloats, b, ANIM_ROTATION + c);
+			qj[c] = jointChannel(joints, jointFloats, joint, ANIM_ROTATION + c);
+			dot += qa[c] * qb[c];
+		}
+		float theta = acos(std::min((float)fabs(dot), 1.0f));
+		float sTheta = sin(theta);
+		float wa = sTheta < 0.001 ? 1.0 - t : sin((1.0 - t) * theta) / sTheta;
+		float wb = (sTheta < 0.001 ? t : sin(t * theta) / sTheta) * (dot < 0 ? -1.0 : 1.0);
+		float p[4], length = 0.0;
+		for(unsigned int c=0;c<4;c++){
+			p[c] = wa * qa[c] + wb * qb[c];
+			length += p[c] * p[c];
+		}
+		for(unsigned int c=0;c<4;c++){
+			p[c] /= sqrt(length);
+		}
+		float hemisphere = p[0] * qj[0] + p[1] * qj[1] + p[2] * qj[2] + p[3] * qj[3] < 0 ? -1.0 : 1.0;
+		for(unsigned int c=0;c<4;c++){
+			error = std::max(error, (float)fabs(p[c] * hemisphere - qj[c]));
+		}
+		return error;
+	}
+
+	for(unsigned int c=0;c<3;c++){
+		float va = jointChannel(joints, jointFloats, a, first[group] + c);
+		float vb = jointChannel(joints, jointFloats, b, first[group] + c);
+		float vj = jointChannel(joints, jointFloats, joint, first[group] + c);
+		error = std::max(error, (float)fabs(va + (vb - va) * t - vj));
+	}
+	return error;
+}
+
+//Compress interleaved joints of every frame. Tracks within tolerance of their first frame throughout become
+//constant. Keyframes are then kept greedily: each one reaches as far as interpolating up to it stays within
+//tolerance on every frame in between. Joints are model space transforms, so errors do not add up over bones.
+static void buildClip(ClipData& clip, const float* joints, Uint32 jointFloats, Uint32 numFrames, Uint32 numBones){
+	const Uint32 first[3] = {ANIM_TRANSLATION, ANIM_ROTATION, ANIM_SCALE};
+	const float tolerance[3] = {ANIM_TRANSLATION_TOLERANCE, ANIM_ROTATION_TOLERANCE, ANIM_SCALE_TOLERANCE};
+
+	std::vector<Uint16> tracks[3];
+	for(unsigned int g=0;g<3;g++){
+		for(unsigned int i=0;i<numBones;i++){
+			for(unsigned int f=1;f<numFrames;f++){
+				if(trackError(joints, jointFloats, g, i, i, f * numBones + i, 0.0) > tolerance[g]){
+					tracks[g].push_back(i);
+					break;
+				}
+			}
+		}
+	}
+
+	std::vector<Uint16> keyFrames(1, 0);
+	while(keyFrames.back() + 1u < numFrames){
+		Uint32 from = keyFrames.back();
+		Uint32 to = from + 1;
+		while(to + 1 < numFrames){
+			bool fits = true;
+			for(unsigned int f=from+1;f<to+1 && fits;f++){
+				float t = (float)(f - from) / (to + 1 - from);
+				for(unsigned int g=0;g<3 && fits;g++){
+					for(unsigned int i=0;i<tracks[g].size() && fits;i++){
+						Uint32 bone = tracks[g][i];
+						fits = trackError(joints, jointFloats, g, from * numBones + bone, (to + 1) * numBones + bone,
+							f * numBones + bone, t) <= tolerance[g];
+					}
+				}
+			}
+			if(!fits){
+				break;
+			}
+			to++;
+		}
+		keyFrames.push_back(to);
+	}
+
+	clip.numKeys = keyFrames.size();
+	for(unsigned int g=0;g<3;g++){
+		clip.numTracks[g] = tracks[g].size();
+	}
+	clip.built = (Uint8*)calloc(layoutClip(clip, numFrames, numBones, nullptr), 1);
+	layoutClip(clip, numFrames, numBones, clip.built);
+
+	memcpy(clip.keyFrames, keyFrames.data(), clip.numKeys * 2);
+	for(unsigned int i=0,k=0;i<numFrames;i++){
+		k += k + 1 < clip.numKeys && keyFrames[k + 1] <= i;
+		clip.frameKeys[i] = k;
+	}
+	Uint16* bones = clip.trackBones;
+	for(unsigned int g=0;g<3;g++){
+		memcpy(bones, tracks[g].data(), tracks[g].size() * 2);
+		bones += tracks[g].size();
+	}
+
+	//First frame for every track, padding bones get the identity.
+	Uint32 stride = (numBones + 3) & ~3u;
+	for(unsigned int c=0;c<ANIM_CHANNELS;c++){
+		for(unsigned int i=0;i<stride;i++){
+			float identity = c == ANIM_ROTATION || c >= ANIM_SCALE ? 1.0 : 0.0;
+			clip.constants[c * stride + i] = i < numBones ? jointChannel(joints, jointFloats, i, c) : identity;
+		}
+	}
+
+	for(unsigned int k=0;k<clip.numKeys;k++){
+		Uint8* key = clip.keys + k * clip.keySize;
+		Uint32 joint = keyFrames[k] * numBones;
+		float* translations = (float*)key;
+		Uint16* rotations = (Uint16*)(key + clip.numTracks[0] * 12);
+		float* scales = (float*)(key + clip.keySize - clip.numTracks[2] * 12);
+		for(unsigned int i=0;i<clip.numTracks[0];i++){
+			for(unsigned int c=0;c<3;c++){
+				translations[i * 3 + c] = jointChannel(joints, jointFloats, joint + tracks[0][i], first[0] + c);
+			}
+		}
+		for(unsigned int i=0;i<clip.numTracks[1];i++){
+			float rotation[4];
+			for(unsigned int c=0;c<4;c++){
+				rotation[c] = jointChannel(joints, jointFloats, joint + tracks[1][i], first[1] + c);
+			}
+			quantizeRotation(rotation, &rotations[i * 3]);
+		}
+		for(unsigned int i=0;i<clip.numTracks[2];i++){
+			for(unsigned int c=0;c<3;c++){
+				scales[i * 3 + c] = jointChannel(joints, jointFloats, joint + tracks[2][i], first[2] + c);
+			}
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------------------------------
 
 //Load static model (aka non animated model) data from file.
 StaticModelLoader::StaticModelLoader(const char* filename){
-	//Read file.
-	std::ifstream file(filename, std::ios::in|std::ios::binary);
-	if(file.is_open()){
-		file.seekg(0);
-		
-		//Attributes.
-		file.read((char*)&attribLength, 4);
-		attributes = (float*)malloc(attribLength);
-		file.read((char*)attributes, attribLength);
-
-		//Material.
-		file.read((char*)&texWidth, 4);
-		file.read((char*)&texHeight, 4);
-		file.read((char*)&texDepth, 4);
-
-		//Temp buffers.
-		Uint32 diffColorsLength;	//Length of indexed diffuse color buffer.
-		float* diffColors;			//Indexed diffuse color data.
-		Uint32 diffIndicesLength;	//Length of the buffer containing the indices.
-		Uint16* diffIndices;		//Buffer containing the indices.
-
-		file.read((char*)&diffColorsLength, 4);
-		diffColors = (float*)malloc(diffColorsLength);
-		file.read((char*)diffColors, diffColorsLength);
-
-		file.read((char*)&diffIndicesLength, 4);
-		diffIndices = (Uint16*)malloc(diffIndicesLength);
-		file.read((char*)diffIndices, diffIndicesLength);
-
-		file.read((char*)&metalRoughLength, 4);
-		metalRough = (float*)malloc(metalRoughLength);
-		file.read((char*)metalRough, metalRoughLength);
-
-		file.read((char*)centroid, 12);
-		file.read((char*)&cullRadius, 4);
-
-		//Construct textures from indexed sources.
-		Uint32 numTexels = texWidth * texHeight * texDepth;
-		texLength = numTexels * 4 * sizeof(float);
-		diffuse = (float*)malloc(texLength);
-		for(int i=0;i<numTexels;i++){
-			diffuse[i*4] = diffColors[diffIndices[i]*4];
-			diffuse[i*4+1] = diffColors[diffIndices[i]*4+1];
-			diffuse[i*4+2] = diffColors[diffIndices[i]*4+2];
-			diffuse[i*4+3] = diffColors[diffIndices[i]*4+3];
-		}
-
-		//Free temp buffers.
-		free(diffColors);
-		free(diffIndices);
-
-		//Close file.
-		file.close();
-		loaded = true;
+	if(!file.open(filename)){
+		return;
+	}
+
+	//Attributes. Packed files start with a magic word before the attribute length.
+	//Indexed files hold packed vertices and their chunks instead, with textures as in packed files.
+	if(!file.read(&attribLength, 4)){return;}
+	if(attribLength == MODEL_INDEXED_MAGIC){
+		indexed = true;
+		packed = true;
+		attribLength = 0;
+		attributes = nullptr;
+		if(!readMesh(file, mesh, sizeof(PackedVertex), filename)){return;}
+
+		if(!file.read(&numChunks, 4) || numChunks == 0){return;}
+		chunks = (ModelChunk*)malloc(numChunks * sizeof(ModelChunk));
+		if(!file.read(chunks, numChunks * sizeof(ModelChunk))){return;}
+		for(unsigned int i=0;i<numChunks;i++){
+			if((Uint64)chunks[i].firstIndex + chunks[i].numIndices > mesh.numIndices){return;}
+		}
+	}else{
+		if(attribLength == MODEL_PACKED_MAGIC){
+			packed = true;
+			if(!file.read(&attribLength, 4)){return;}
+		}
+		attributes = (float*)file.take(attribLength);
+	}
+
+	//Material.
+	if(!file.read(&texWidth, 4)){return;}
+	if(!file.read(&texHeight, 4)){return;}
+	if(!file.read(&texDepth, 4)){return;}
+
+	//Diffuse colors.
+	Uint32 numTexels = texWidth * texHeight * texDepth;
+	if(!readDiffuse(file, packed, numTexels, diffuse, expanded, texLength)){return;}
+
+	if(!file.read(&metalRoughLength, 4)){return;}
+	metalRough = (float*)file.take(metalRoughLength);
+
+	if((!attributes && !indexed) || !metalRough){
+		return;
+	}
+
+	if(!file.read(centroid, 12) || !file.read(&cullRadius, 4)){
+		if(indexed){return;}
+		calcBounds(attributes, attribLength, 9, centroid, cullRadius);
+	}
+
+	if(!indexed){
+		buildChunks(*this);
+		std::vector<Uint32> ranges(numChunks);
+		for(unsigned int i=0;i<numChunks;i++){
+			ranges[i] = chunks[i].firstIndex + chunks[i].numIndices;
+		}
+		buildMesh(mesh, attributes, attribLength, 9, ranges.data(), numChunks);
 	}
+
+	loaded = true;
 }
 
 //Destructor for static model loader.
 StaticModelLoader::~StaticModelLoader(){
-	if(attributes){
-		free(attributes);
-		free(diffuse);
-		free(metalRough);
+	if(expanded){
+		free(expanded);
 	}
+	if(chunks){
+		free(chunks);
+	}
+	if(reordered){
+		free(reordered);
+	}
+	if(mesh.built){
+		free(mesh.built);
+	}
+	file.close();
 }
 
 //Load animated model data from file.
 AnimatedModelLoader::AnimatedModelLoader(const char* filename){
-	//Read file.
-	std::ifstream file(filename, std::ios::in|std::ios::binary);
-	if(file.is_open()){
-		file.seekg(0);
-		
-		//Attributes.
-		file.read((char*)&attribLength, 4);
-		attributes = (float*)malloc(attribLength);
-		file.read((char*)attributes, attribLength);
-
-		//Material.
-		file.read((char*)&texWidth, 4);
-		file.read((char*)&texHeight, 4);
-		file.read((char*)&texDepth, 4);
-
-		//Temp buffers.
-		Uint32 diffColorsLength;	//Length of indexed diffuse color buffer.
-		float* diffColors;			//Indexed diffuse color data.
-		Uint32 diffIndicesLength;	//Length of the buffer containing the indices.
-		Uint16* diffIndices;		//Buffer containing the indices.
-
-		file.read((char*)&diffColorsLength, 4);
-		diffColors = (float*)malloc(diffColorsLength);
-		file.read((char*)diffColors, diffColorsLength);
-
-		file.read((char*)&diffIndicesLength, 4);
-		diffIndices = (Uint16*)malloc(diffIndicesLength);
-		file.read((char*)diffIndices, diffIndicesLength);
-
-		file.read((char*)&metalRoughLength, 4);
-		metalRough = (float*)malloc(metalRoughLength);
-		file.read((char*)metalRough, metalRoughLength);
-
-		file.read((char*)centroid, 12);
-		file.read((char*)&cullRadius, 4);
-
-		//Armature.
-		file.read((char*)&numBones, 4);
-
-		//Construct textures from indexed sources.
-		Uint32 numTexels = texWidth * texHeight * texDepth;
-		texLength = numTexels * 4 * sizeof(float);
-		diffuse = (float*)malloc(texLength);
-		for(unsigned int i=0;i<numTexels;i++){
-			diffuse[i*4] = diffColors[diffIndices[i]*4];
-			diffuse[i*4+1] = diffColors[diffIndices[i]*4+1];
-			diffuse[i*4+2] = diffColors[diffIndices[i]*4+2];
-			diffuse[i*4+3] = diffColors[diffIndices[i]*4+3];
-		}
-
-		//Free temp buffers.
-		free(diffColors);
-		free(diffIndices);
-
-		//Close file.
-		file.close();
-		loaded = true;
+	if(!file.open(filename)){
+		return;
 	}
+
+	//Attributes. Packed files start with a magic word before the attribute length.
+	//Indexed files hold packed vertices instead, with textures as in packed files.
+	if(!file.read(&attribLength, 4)){return;}
+	if(attribLength == MODEL_INDEXED_MAGIC){
+		indexed = true;
+		packed = true;
+		attribLength = 0;
+		attributes = nullptr;
+		if(!readMesh(file, mesh, sizeof(PackedSkinnedVertex), filename)){return;}
+	}else{
+		if(attribLength == MODEL_PACKED_MAGIC){
+			packed = true;
+			if(!file.read(&attribLength, 4)){return;}
+		}
+		attributes = (float*)file.take(attribLength);
+	}
+
+	//Material.
+	if(!file.read(&texWidth, 4)){return;}
+	if(!file.read(&texHeight, 4)){return;}
+	if(!file.read(&texDepth, 4)){return;}
+
+	//Diffuse colors.
+	Uint32 numTexels = texWidth * texHeight * texDepth;
+	if(!readDiffuse(file, packed, numTexels, diffuse, expanded, texLength)){return;}
+
+	if(!file.read(&metalRoughLength, 4)){return;}
+	metalRough = (float*)file.take(metalRoughLength);
+
+	if(!file.read(centroid, 12)){return;}
+	if(!file.read(&cullRadius, 4)){return;}
+
+	//Armature. Packed vertices index bones with a byte.
+	if(!file.read(&numBones, 4)){return;}
+	if(numBones > ANIM_MAX_BONES){
+		std::cout<<"WARNING: "<<filename<<" has more than "<<ANIM_MAX_BONES<<" bones!"<<std::endl;
+		return;
+	}
+
+	if((!attributes && !indexed) || !metalRough){
+		return;
+	}
+
+	if(!indexed){
+		Uint32 range = attribLength / (17 * sizeof(float));
+		buildMesh(mesh, attributes, attribLength, 17, &range, 1);
+	}
+
+	loaded = true;
 }
 
 //Destructor for Animated model loader.
 AnimatedModelLoader::~AnimatedModelLoader(){
-	if(attributes){
-		free(attributes);
-		free(diffuse);
-		free(metalRough);
+	if(expanded){
+		free(expanded);
+	}
+	if(mesh.built){
+		free(mesh.built);
 	}
+	file.close();
 }
 
-//Load skeletal animation files from file.
+//Load skeletal animation files from file. Uncompressed joints are compressed here.
 AnimationLoader::AnimationLoader(const char* filename){
-	std::ifstream file(filename, std::ios::in|std::ios::binary);
-	if(file.is_open()){
-		file.seekg(0);
+	if(!file.open(filename)){
+		return;
+	}
 
-		file.read((char*)&numFrames, 4);
-		file.read((char*)&numBones, 4);
-		file.read((char*)&animRate, 4);
+	if(!file.read(&numFrames, 4)){return;}
+	if(numFrames == ANIM_COMPRESSED_MAGIC){
+		compressed = true;
+		if(!file.read(&numFrames, 4)){return;}
+		if(!file.read(&numBones, 4)){return;}
+		if(numBones > ANIM_MAX_BONES){
+			std::cout<<"WARNING: "<<filename<<" has more than "<<ANIM_MAX_BONES<<" bones!"<<std::endl;
+			return;
+		}
+		if(!file.read(&animRate, 4)){return;}
+		if(!file.read(&clip.numKeys, 4)){return;}
+		if(!file.read(clip.numTracks, 12)){return;}
 
-		file.read((char*)&animLength, 4);
-		animation = (float*)malloc(animLength);
-		file.read((char*)animation, animLength);
+		Uint32 size;
+		if(!file.read(&size, 4) || size != layoutClip(clip, numFrames, numBones, nullptr)){return;}
+		//The clip is used in place, so whoever takes it keeps the mapping too.
+		char* data = file.take(size);
+		if(data == nullptr || clip.numKeys == 0){return;}
+		layoutClip(clip, numFrames, numBones, (Uint8*)data);
 
-		file.close();
 		loaded = true;
+		return;
+	}
+
+	if(!file.read(&numBones, 4)){return;}
+	if(numBones > ANIM_MAX_BONES){
+		std::cout<<"WARNING: "<<filename<<" has more than "<<ANIM_MAX_BONES<<" bones!"<<std::endl;
+		return;
 	}
+	if(!file.read(&animRate, 4)){return;}
+
+	if(!file.read(&animLength, 4)){return;}
+	animation = (float*)file.take(animLength);
+	if(animation == nullptr || numFrames == 0 || numFrames > 0xFFFF || numBones == 0){return;}
+
+	//Older files leave out the scale, seven floats per joint instead of ten.
+	jointFloats = animLength / (numFrames * numBones * sizeof(float));
+	if(jointFloats != ANIM_CHANNELS && jointFloats != 7){
+		std::cout<<"WARNING: Animation data of "<<filename<<" does not match its keyframes."<<std::endl;
+		return;
+	}
+	buildClip(clip, animation, jointFloats, numFrames, numBones);
+
+	loaded = true;
 }
 
 //Destructor for animation loader.
 AnimationLoader::~AnimationLoader(){
-	if(animation){
-		free(animation);
+	if(clip.built){
+		free(clip.built);
 	}
+	file.close();
 }
 
 //Load complex collision meshes from a file.
 PhysicsMeshLoader::PhysicsMeshLoader(const char* filename){
-	std::ifstream file(filename, std::ios::in|std::ios::binary);
-	if(file.is_open()){
-		file.seekg(0);
+	if(!file.open(filename)){
+		return;
+	}
 
-		file.read((char*)&numConvexes, 4);
+	if(!file.read(&numConvexes, 4)){return;}
 
-		file.read((char*)&vertsLength, 4);
-		vertices = (float*)malloc(vertsLength);
-		file.read((char*)vertices, vertsLength);
+	if(!file.read(&vertsLength, 4)){return;}
+	vertices = (float*)file.take(vertsLength);
 
-		file.read((char*)&indsLength, 4);
-		indices = (Uint16*)malloc(indsLength);
-		file.read((char*)indices, indsLength);
+	if(!file.read(&indsLength, 4)){return;}
+	indices = (Uint16*)file.take(indsLength);
 
-		file.close();
-		loaded = true;
-	}
+	loaded = vertices != nullptr && indices != nullptr;
 }
 
 //Destructor for physics mesh loader.
 PhysicsMeshLoader::~PhysicsMeshLoader(){
-	if(vertices){
-		free(vertices);
-		free(indices);
-	}
+	file.close();
 }
 
 //Load environtment map data from file.
 EnvironmentMapLoader::EnvironmentMapLoader(const char* filename){
-	//Read file.
-	std::ifstream file(filename, std::ios::in|std::ios::binary);
-	if(file.is_open()){
-		file.seekg(0);
-		
-		//Material.
-		file.read((char*)&texWidth, 4);
-		file.read((char*)&texHeight, 4);
-
-		//Temp buffers.
-		Uint32 diffColorsLength;	//Length of indexed diffuse color buffer.
-		float* diffColors;			//Indexed diffuse color data.
-		Uint32 diffIndicesLength;	//Length of the buffer containing the indices.
-		Uint16* diffIndices;		//Buffer containing the indices.
-
-		file.read((char*)&diffColorsLength, 4);
-		diffColors = (float*)malloc(diffColorsLength);
-		file.read((char*)diffColors, diffColorsLength);
-
-		file.read((char*)&diffIndicesLength, 4);
-		diffIndices = (Uint16*)malloc(diffIndicesLength);
-		file.read((char*)diffIndices, diffIndicesLength);
-
-		//Construct textures from indexed sources.
-		Uint32 numTexels = texWidth * texHeight;
-		sideLength = numTexels * 3 * sizeof(float);
-		diffuse = (float*)malloc(sideLength);
-		for(unsigned int i=0;i<numTexels;i++){
-			diffuse[i*3] = diffColors[diffIndices[i]*3];
-			diffuse[i*3+1] = diffColors[diffIndices[i]*3+1];
-			diffuse[i*3+2] = diffColors[diffIndices[i]*3+2];
-		}
-
-		texHeight /= 6;
-		sideLength /= 24;
-
-		//Free temp buffers.
-		free(diffColors);
-		free(diffIndices);
-
-		//Close file.
-		file.close();
-		loaded = true;
+	if(!file.open(filename)){
+		return;
 	}
+
+	//Material.
+	if(!file.read(&texWidth, 4)){return;}
+	if(!file.read(&texHeight, 4)){return;}
+
+	//Indexed diffuse colors.
+	Uint32 diffColorsLength;	//Length of indexed diffuse color buffer.
+	Uint32 diffIndicesLength;	//Length of the buffer containing the indices.
+
+	if(!file.read(&diffColorsLength, 4)){return;}
+	float* diffColors = (float*)file.take(diffColorsLength);
+
+	if(!file.read(&diffIndicesLength, 4)){return;}
+	Uint16* diffIndices = (Uint16*)file.take(diffIndicesLength);
+
+	if(!diffColors || !diffIndices){
+		return;
+	}
+
+	//Construct textures from indexed sources.
+	Uint32 numTexels = texWidth * texHeight;
+	sideLength = numTexels * 3 * sizeof(float);
+	diffuse = (float*)malloc(sideLength);
+	for(unsigned int i=0;i<numTexels;i++){
+		diffuse[i*3] = diffColors[diffIndices[i]*3];
+		diffuse[i*3+1] = diffColors[diffIndices[i]*3+1];
+		diffuse[i*3+2] = diffColors[diffIndices[i]*3+2];
+	}
+
+	texHeight /= 6;
+	sideLength /= 24;
+
+	loaded = true;
 }
 
 //Destructor for static model loader.
@@ -250,4 +1056,5 @@ EnvironmentMapLoader::~EnvironmentMapLoader(){
 	if(diffuse){
 		free(diffuse);
 	}
+	file.close();
 }
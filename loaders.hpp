@@ -4,12 +4,119 @@
 #include <GL/glew.h>
 #include <SDL2/SDL_opengl.h>
 
+#include <cstddef>
+
+//First word of model files that store their diffuse texels as RGBA8 instead of an indexed palette.
+//Older files start directly with the attribute length.
+#define MODEL_PACKED_MAGIC 0x38414752	//"RGA8"
+
+//First word of model files that store indexed, packed vertices. Their textures are RGBA8 as in packed files.
+#define MODEL_INDEXED_MAGIC 0x31584449	//"IDX1"
+
+//Most colors an older model's diffuse palette can have, as texels index it with a Uint16.
+#define MODEL_MAX_PALETTE_COLORS 65536
+
+//First word of animation files holding a compressed clip. Older files start directly with the frame count.
+#define ANIM_COMPRESSED_MAGIC 0x31504C43	//"CLP1"
+
+#define ANIM_CHANNELS 10			//Pose channels: translation xyz, rotation wxyz, scale xyz.
+#define ANIM_MAX_BONES 256			//Packed vertices index bones with a byte, poses are sized for this many.
+#define ANIM_TRANSLATION 0
+#define ANIM_ROTATION 3
+#define ANIM_SCALE 7
+
+//Error compressing a clip may add to any joint, in model units, quaternion components and scale factors.
+#define ANIM_TRANSLATION_TOLERANCE 0.0005
+#define ANIM_ROTATION_TOLERANCE 0.0005
+#define ANIM_SCALE_TOLERANCE 0.0005
+
+#define VERTEX_CACHE_SIZE 32	//Post-transform cache entries triangles are ordered for.
+
+//Static models bigger than this are split into chunks at load, so levels can be culled piece by piece.
+#define MODEL_CHUNK_RADIUS 16.0			//Chunks are split until their triangle centers fit about this radius,
+#define MODEL_CHUNK_MIN_TRIANGLES 32	//unless they are this small already.
+
+//Spatial section of a static model. Its triangles are a contiguous range of the model's indices.
+struct ModelChunk{
+	Uint32 firstIndex;
+	Uint32 numIndices;
+	float centroid[3];
+	float cullRadius;
+};
+
+//Packed vertex of static models, 24 bytes instead of 9 floats.
+struct PackedVertex{
+	float position[3];
+	Sint16 uv[2];		//Normalized, scaled by the model's uvScale.
+	Uint16 normal[4];	//Half floats. The fourth holds the texture array layer.
+};
+
+//Packed vertex of animated models, 32 bytes instead of 17 floats.
+struct PackedSkinnedVertex{
+	float position[3];
+	Sint16 uv[2];
+	Uint16 normal[4];
+	Uint8 bones[4];
+	Uint8 weights[4];	//Normalized, summing to 255.
+};
+
+//Deduplicated, packed vertices of a model and the triangle indices into them.
+struct MeshData{
+	Uint32 numVertices = 0;
+	Uint32 vertexSize = 0;		//Bytes per vertex, the size of one of the packed vertex types.
+	Uint8* vertices = nullptr;
+	Uint32 numIndices = 0;
+	Uint32 indexSize = 0;		//2 or 4 bytes.
+	Uint8* indices = nullptr;
+	float uvScale = 1.0;		//UVs span -uvScale to uvScale.
+	Uint8* built = nullptr;		//Heap buffer when built at load. Vertices and indices point into the file otherwise.
+};
+
+//Compressed skeletal animation. Keyframes their neighbours interpolate closely enough are dropped, tracks
+//that never change are stored once in the constant pose and the others with every kept keyframe.
+//Rotations keep their three smallest components in 15 bits each, with the index of the largest in the
+//top bits of the first two. Translations and scales stay floats.
+struct ClipData{
+	Uint32 numKeys = 0;
+	Uint32 numTracks[3] = {0, 0, 0};	//Animated translation, rotation and scale tracks.
+	Uint32 keySize = 0;				//Bytes per keyframe: translations, rotations padded to words, scales.
+	Uint16* keyFrames = nullptr;	//Frame of every kept keyframe.
+	Uint16* frameKeys = nullptr;	//Last kept keyframe at or before every frame.
+	Uint16* trackBones = nullptr;	//Bone of every animated track, translations first.
+	float* constants = nullptr;		//Pose of the constant tracks, ANIM_CHANNELS streams of bones rounded up to four.
+	Uint8* keys = nullptr;
+	Uint32 size = 0;				//Bytes of built.
+	Uint8* built = nullptr;			//Heap buffer all of the above point into, null when they point into a mapped file.
+};
+
+//Memory mapping of a whole file. Loaders hand out pointers straight into it, which are read only.
+//A mapping has one owner: it can be moved to another, leaving the old one empty, but not copied.
+struct MappedFile{
+	MappedFile(){};
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other);
+	MappedFile& operator=(MappedFile&& other);
+	bool open(const char* filename);
+	void close();
+	~MappedFile(){};
+
+	bool read(void* destination, size_t size);
+	char* take(size_t size);
+
+	char* data = nullptr;	//Start of the mapping.
+	size_t length = 0;		//Length of the file in bytes.
+	size_t cursor = 0;		//Read position.
+	bool mapped = false;	//False when the file had to be read into a heap buffer.
+};
+
 //Loader for static model data.
 struct StaticModelLoader{
 	StaticModelLoader(const char* filename);
 	~StaticModelLoader();
 
 	bool loaded = false;
+	MappedFile file;
 
 	//Attribute data.
 	Uint32 attribLength;	//Length of attribute data in bytes.
@@ -20,14 +127,25 @@ struct StaticModelLoader{
 	Uint32 texHeight;		//Height of material textures.
 	Uint32 texDepth;		//Depth of material textures (texture arrays).
 
-	Uint32 texLength;		//Length of textures in bytes.
-	float* diffuse;			//Diffuse texture.
+	Uint32 texLength;		//Length of the diffuse texture in bytes.
+	Uint8* diffuse = nullptr;//Diffuse texture, RGBA8. Points into the file when packed.
+	Uint8* expanded = nullptr;//Heap buffer for diffuse expanded from a palette.
+	bool packed = false;	//True when the file stores RGBA8 texels.
 
 	Uint32 metalRoughLength;//Length of the metallic & roughness map.
 	float* metalRough;		//Metallic & roughness map.
 
 	float centroid[3];
 	float cullRadius;
+
+	//Chunks. Attributes are reordered so every chunk is one range of triangles.
+	Uint32 numChunks = 0;
+	ModelChunk* chunks = nullptr;
+	float* reordered = nullptr;//Heap buffer holding the reordered attributes.
+
+	//Indexed vertices, read from indexed files or built from the attributes. Attributes are null for indexed files.
+	MeshData mesh;
+	bool indexed = false;
 };
 
 //Loader for animated model data.
@@ -36,6 +154,7 @@ struct AnimatedModelLoader{
 	~AnimatedModelLoader();
 
 	bool loaded = false;
+	MappedFile file;
 
 	//Attribute data.
 	Uint32 attribLength;	//Length of attribute data in bytes.
@@ -46,8 +165,10 @@ struct AnimatedModelLoader{
 	Uint32 texHeight;		//Height of material textures.
 	Uint32 texDepth;		//Depth of material textures (texture arrays).
 
-	Uint32 texLength;		//Length of textures in bytes.
-	float* diffuse;			//Diffuse texture.
+	Uint32 texLength;		//Length of the diffuse texture in bytes.
+	Uint8* diffuse = nullptr;//Diffuse texture, RGBA8. Points into the file when packed.
+	Uint8* expanded = nullptr;//Heap buffer for diffuse expanded from a palette.
+	bool packed = false;	//True when the file stores RGBA8 texels.
 
 	Uint32 metalRoughLength;//Length of the metallic & roughness map.
 	float* metalRough;		//Metallic & roughness map.
@@ -57,6 +178,10 @@ struct AnimatedModelLoader{
 
 	//Armature data.
 	Uint32 numBones;		//Number of bones supported by model.
+
+	//Indexed vertices, read from indexed files or built from the attributes. Attributes are null for indexed files.
+	MeshData mesh;
+	bool indexed = false;
 };
 
 //Loader for skeletal animations.
@@ -65,6 +190,7 @@ struct AnimationLoader{
 	~AnimationLoader();
 
 	bool loaded = false;
+	MappedFile file;
 	
 	//Animation data.
 	Uint32 numFrames;		//Number of frames.
@@ -72,7 +198,12 @@ struct AnimationLoader{
 	Uint32 animRate;		//Playback rate of animation.
 
 	Uint32 animLength;		//Length of animation data in bytes.
-	float* animation;		//Skeletal animation data.
+	float* animation = nullptr;	//Interleaved joints of every frame, null for compressed files.
+	Uint32 jointFloats = 0;		//10 floats per joint, 7 in older files without scale.
+
+	//Compressed clip, pointing into compressed files or built from the joints.
+	ClipData clip;
+	bool compressed = false;
 };
 
 //Loader for physics mesh data.
@@ -81,6 +212,7 @@ struct PhysicsMeshLoader{
 	~PhysicsMeshLoader();
 
 	bool loaded = false;
+	MappedFile file;
 
 	//Physics mesh data.
 	Uint32 numConvexes;		//Number of convexes in the mesh.
@@ -98,11 +230,12 @@ struct EnvironmentMapLoader{
 	~EnvironmentMapLoader();
 
 	bool loaded = false;
+	MappedFile file;
 
 	//Material data.
 	Uint32 texWidth;		//Width of material texture.
 	Uint32 texHeight;		//Height of material texture.
 
 	Uint32 sideLength;		//Length of one side in bytes.
-	float* diffuse;			//Diffuse map data.
+	float* diffuse = nullptr;//Diffuse map data.
 };
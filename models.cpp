@@ -1,8 +1,235 @@
 #include "models.hpp"
 #include "loaders.hpp"
 
+//Four bones of a pose channel.
+#ifdef MATHS_SSE
+typedef __m128 Lanes;
+
+static inline Lanes lanesLoad(const float* p){return _mm_loadu_ps(p);}
+static inline void lanesStore(float* p, Lanes a){_mm_storeu_ps(p, a);}
+static inline Lanes lanesSet(float f){return _mm_set1_ps(f);}
+static inline Lanes lanesAdd(Lanes a, Lanes b){return _mm_add_ps(a, b);}
+static inline Lanes lanesSub(Lanes a, Lanes b){return _mm_sub_ps(a, b);}
+static inline Lanes lanesMul(Lanes a, Lanes b){return _mm_mul_ps(a, b);}
+static inline Lanes lanesDiv(Lanes a, Lanes b){return _mm_div_ps(a, b);}
+static inline Lanes lanesSqrt(Lanes a){return _mm_sqrt_ps(a);}
+static inline Lanes lanesMax(Lanes a, Lanes b){return _mm_max_ps(a, b);}
+static inline Lanes lanesEqual(Lanes a, Lanes b){return _mm_cmpeq_ps(a, b);}
+static inline Lanes lanesSelect(Lanes mask, Lanes a, Lanes b){return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));}
+
+//Negate the lanes of a where sign is negative.
+static inline Lanes lanesFlip(Lanes a, Lanes sign){
+	return _mm_xor_ps(a, _mm_and_ps(sign, _mm_set1_ps(-0.0f)));
+}
+#else
+struct Lanes{
+	float v[4];
+};
+
+static inline Lanes lanesLoad(const float* p){Lanes r; for(int i=0;i<4;i++){r.v[i] = p[i];} return r;}
+static inline void lanesStore(float* p, Lanes a){for(int i=0;i<4;i++){p[i] = a.v[i];}}
+static inline Lanes lanesSet(float f){Lanes r; for(int i=0;i<4;i++){r.v[i] = f;} return r;}
+static inline Lanes lanesAdd(Lanes a, Lanes b){for(int i=0;i<4;i++){a.v[i] += b.v[i];} return a;}
+static inline Lanes lanesSub(Lanes a, Lanes b){for(int i=0;i<4;i++){a.v[i] -= b.v[i];} return a;}
+static inline Lanes lanesMul(Lanes a, Lanes b){for(int i=0;i<4;i++){a.v[i] *= b.v[i];} return a;}
+static inline Lanes lanesDiv(Lanes a, Lanes b){for(int i=0;i<4;i++){a.v[i] /= b.v[i];} return a;}
+static inline Lanes lanesSqrt(Lanes a){for(int i=0;i<4;i++){a.v[i] = sqrt(a.v[i]);} return a;}
+static inline Lanes lanesMax(Lanes a, Lanes b){for(int i=0;i<4;i++){a.v[i] = std::max(a.v[i], b.v[i]);} return a;}
+static inline Lanes lanesEqual(Lanes a, Lanes b){for(int i=0;i<4;i++){a.v[i] = a.v[i] == b.v[i];} return a;}
+static inline Lanes lanesSelect(Lanes mask, Lanes a, Lanes b){for(int i=0;i<4;i++){a.v[i] = mask.v[i] != 0 ? a.v[i] : b.v[i];} return a;}
+
+//Negate the lanes of a where sign is negative.
+static inline Lanes lanesFlip(Lanes a, Lanes sign){
+	for(int i=0;i<4;i++){
+		a.v[i] = std::signbit(sign.v[i]) ? -a.v[i] : a.v[i];
+	}
+	return a;
+}
+#endif
+
+//a + (b - a) * t.
+static inline Lanes lanesLerp(Lanes a, Lanes b, Lanes t){
+	return lanesAdd(a, lanesMul(lanesSub(b, a), t));
+}
+
+//Normalize four quaternions.
+static inline void lanesNormalize(Lanes q[4]){
+	Lanes length = lanesSqrt(lanesAdd(lanesAdd(lanesMul(q[0], q[0]), lanesMul(q[1], q[1])),
+		lanesAdd(lanesMul(q[2], q[2]), lanesMul(q[3], q[3]))));
+	for(unsigned int i=0;i<4;i++){
+		q[i] = lanesDiv(q[i], length);
+	}
+}
+
+//Interpolate four quaternion pairs along the shorter arc. A normalized lerp with its time bent by a fitted
+//polynomial in the angle between them, within a twentieth of a degree of slerp and free of acos and sin.
+static inline void lanesNlerp(Lanes a[4], Lanes b[4], Lanes t, Lanes result[4]){
+	Lanes dot = lanesAdd(lanesAdd(lanesMul(a[0], b[0]), lanesMul(a[1], b[1])),
+		lanesAdd(lanesMul(a[2], b[2]), lanesMul(a[3], b[3])));
+	Lanes d = lanesFlip(dot, dot);
+
+	Lanes k0 = lanesAdd(lanesSet(-3.2452), lanesMul(d, lanesSub(lanesSet(3.55645), lanesMul(d, lanesSet(1.43519)))));
+	Lanes k1 = lanesAdd(lanesSet(-1.06021), lanesMul(d, lanesSet(0.215638)));
+	Lanes A = lanesAdd(lanesSet(1.0904), lanesMul(d, k0));
+	Lanes B = lanesAdd(lanesSet(0.848013), lanesMul(d, k1));
+	Lanes half = lanesSub(t, lanesSet(0.5));
+	Lanes k = lanesAdd(lanesMul(A, lanesMul(half, half)), B);
+	Lanes bent = lanesAdd(t, lanesMul(lanesMul(t, half), lanesMul(lanesSub(t, lanesSet(1.0)), k)));
+
+	for(unsigned int i=0;i<4;i++){
+		result[i] = lanesLerp(a[i], lanesFlip(b[i], dot), bent);
+	}
+	lanesNormalize(result);
+}
+
+//Quaternion products a * b, w first.
+static inline void lanesQuatMul(Lanes a[4], Lanes b[4], Lanes result[4]){
+	Lanes w = lanesSub(lanesSub(lanesMul(a[0], b[0]), lanesMul(a[1], b[1])), lanesAdd(lanesMul(a[2], b[2]), lanesMul(a[3], b[3])));
+	Lanes x = lanesAdd(lanesAdd(lanesMul(a[0], b[1]), lanesMul(a[1], b[0])), lanesSub(lanesMul(a[2], b[3]), lanesMul(a[3], b[2])));
+	Lanes y = lanesAdd(lanesSub(lanesMul(a[0], b[2]), lanesMul(a[1], b[3])), lanesAdd(lanesMul(a[2], b[0]), lanesMul(a[3], b[1])));
+	Lanes z = lanesAdd(lanesAdd(lanesMul(a[0], b[3]), lanesMul(a[1], b[2])), lanesSub(lanesMul(a[3], b[0]), lanesMul(a[2], b[1])));
+	result[0] = w;
+	result[1] = x;
+	result[2] = y;
+	result[3] = z;
+}
+
+//Interpolate count bones of two poses with stride floats per channel into a pose with resultStride.
+static void interpolatePose(const float* a, const float* b, Uint32 stride, float* result, Uint32 resultStride,
+	float fraction, Uint32 count){
+	const Uint32 linear[6] = {0, 1, 2, ANIM_SCALE, ANIM_SCALE + 1, ANIM_SCALE + 2};
+	Lanes t = lanesSet(fraction);
+	for(unsigned int i=0;i<count;i+=4){
+		for(unsigned int c=0;c<6;c++){
+			Uint32 offset = linear[c] * stride + i;
+			lanesStore(&result[linear[c] * resultStride + i], lanesLerp(lanesLoad(&a[offset]), lanesLoad(&b[offset]), t));
+		}
+
+		Lanes qa[4], qb[4], q[4];
+		for(unsigned int c=0;c<4;c++){
+			qa[c] = lanesLoad(&a[(ANIM_ROTATION + c) * stride + i]);
+			qb[c] = lanesLoad(&b[(ANIM_ROTATION + c) * stride + i]);
+		}
+		lanesNlerp(qa, qb, t, q);
+		for(unsigned int c=0;c<4;c++){
+			lanesStore(&result[(ANIM_ROTATION + c) * resultStride + i], q[c]);
+		}
+	}
+}
+
+//Point the pose at storage for POSE_FLOATS(numBones) floats.
+void Pose::init(Uint32 numBones, float* storage){
+	this->numBones = numBones;
+	stride = (numBones + 3) & ~3u;
+	channels = storage;
+}
+
+//Set every bone, padding included, to the identity transform.
+void Pose::identity(){
+	memset(channels, 0, ANIM_CHANNELS * stride * sizeof(float));
+	for(unsigned int i=0;i<stride;i++){
+		channels[ANIM_ROTATION * stride + i] = 1.0;
+		channels[ANIM_SCALE * stride + i] = 1.0;
+		channels[(ANIM_SCALE + 1) * stride + i] = 1.0;
+		channels[(ANIM_SCALE + 2) * stride + i] = 1.0;
+	}
+}
+
+//Move the pose towards another of the same skeleton. A weight of one gives the other pose.
+void Pose::blend(Pose& other, float weight){
+	interpolatePose(channels, other.channels, stride, channels, stride, weight, stride);
+}
+
+//Add a layer's difference from its reference pose, scaled by weight. Translations add, scales multiply
+//and rotations are composed after the pose's own.
+void Pose::add(Pose& layer, Pose& reference, float weight){
+	Lanes w = lanesSet(weight);
+	Lanes one = lanesSet(1.0);
+	for(unsigned int i=0;i<stride;i+=4){
+		for(unsigned int c=0;c<3;c++){
+			Uint32 offset = (ANIM_TRANSLATION + c) * stride + i;
+			Lanes delta = lanesSub(lanesLoad(&layer.channels[offset]), lanesLoad(&reference.channels[offset]));
+			lanesStore(&channels[offset], lanesAdd(lanesLoad(&channels[offset]), lanesMul(delta, w)));
+
+			offset = (ANIM_SCALE + c) * stride + i;
+			Lanes ratio = lanesDiv(lanesLoad(&layer.channels[offset]), lanesLoad(&reference.channels[offset]));
+			lanesStore(&channels[offset], lanesMul(lanesLoad(&channels[offset]), lanesLerp(one, ratio, w)));
+		}
+
+		//delta = conjugate(reference) * layer, weighted from the identity and applied after the pose.
+		Lanes base[4], ref[4], target[4], delta[4], identity[4], rotation[4];
+		for(unsigned int c=0;c<4;c++){
+			Uint32 offset = (ANIM_ROTATION + c) * stride + i;
+			base[c] = lanesLoad(&channels[offset]);
+			ref[c] = c == 0 ? lanesLoad(&reference.channels[offset]) : lanesSub(lanesSet(0.0), lanesLoad(&reference.channels[offset]));
+			target[c] = lanesLoad(&layer.channels[offset]);
+			identity[c] = lanesSet(c == 0 ? 1.0 : 0.0);
+		}
+		lanesQuatMul(ref, target, delta);
+		lanesNlerp(identity, delta, w, target);
+		lanesQuatMul(base, target, rotation);
+		lanesNormalize(rotation);
+		for(unsigned int c=0;c<4;c++){
+			lanesStore(&channels[(ANIM_ROTATION + c) * stride + i], rotation[c]);
+		}
+	}
+}
+
+//Joint matrices of the pose, joint = scale * rotation * translation for every bone.
+void Pose::toMatrices(Mat4* joints){
+	for(unsigned int i=0;i<numBones;i+=4){
+		Lanes w = lanesLoad(&channels[ANIM_ROTATION * stride + i]);
+		Lanes x = lanesLoad(&channels[(ANIM_ROTATION + 1) * stride + i]);
+		Lanes y = lanesLoad(&channels[(ANIM_ROTATION + 2) * stride + i]);
+		Lanes z = lanesLoad(&channels[(ANIM_ROTATION + 3) * stride + i]);
+		Lanes sx = lanesLoad(&channels[ANIM_SCALE * stride + i]);
+		Lanes sy = lanesLoad(&channels[(ANIM_SCALE + 1) * stride + i]);
+		Lanes sz = lanesLoad(&channels[(ANIM_SCALE + 2) * stride + i]);
+		Lanes two = lanesSet(2.0);
+
+		Lanes ww = lanesMul(w, w), xx = lanesMul(x, x), yy = lanesMul(y, y), zz = lanesMul(z, z);
+		Lanes wx = lanesMul(w, x), wy = lanesMul(w, y), wz = lanesMul(w, z);
+		Lanes xy = lanesMul(x, y), xz = lanesMul(x, z), yz = lanesMul(y, z);
+
+		//Rotation rows scaled by the scale of their axis, as Quat::toMatrix lays them out.
+		float rows[9][4];
+		lanesStore(rows[0], lanesMul(sx, lanesSub(lanesAdd(ww, xx), lanesAdd(yy, zz))));
+		lanesStore(rows[1], lanesMul(sx, lanesMul(two, lanesAdd(xy, wz))));
+		lanesStore(rows[2], lanesMul(sx, lanesMul(two, lanesSub(xz, wy))));
+		lanesStore(rows[3], lanesMul(sy, lanesMul(two, lanesSub(xy, wz))));
+		lanesStore(rows[4], lanesMul(sy, lanesSub(lanesAdd(ww, yy), lanesAdd(xx, zz))));
+		lanesStore(rows[5], lanesMul(sy, lanesMul(two, lanesAdd(yz, wx))));
+		lanesStore(rows[6], lanesMul(sz, lanesMul(two, lanesAdd(xz, wy))));
+		lanesStore(rows[7], lanesMul(sz, lanesMul(two, lanesSub(yz, wx))));
+		lanesStore(rows[8], lanesMul(sz, lanesSub(lanesAdd(ww, zz), lanesAdd(xx, yy))));
+
+		for(unsigned int j=0;j<4 && i + j<numBones;j++){
+			float* m = &joints[i + j].m[0][0];
+			for(unsigned int r=0;r<3;r++){
+				m[r * 4] = rows[r * 3][j];
+				m[r * 4 + 1] = rows[r * 3 + 1][j];
+				m[r * 4 + 2] = rows[r * 3 + 2][j];
+				m[r * 4 + 3] = 0.0;
+			}
+			m[12] = channels[ANIM_TRANSLATION * stride + i + j];
+			m[13] = channels[(ANIM_TRANSLATION + 1) * stride + i + j];
+			m[14] = channels[(ANIM_TRANSLATION + 2) * stride + i + j];
+			m[15] = 1.0;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+
+//Load skeletal animation from file.
 bool Animation::init(const char* filename){
 	AnimationLoader file(filename);
+	return init(file);
+}
+
+//Take over already parsed animation data. Clips of compressed files are used in place, so the mapping is
+//kept alive; clips compressed at load are on the heap.
+bool Animation::init(AnimationLoader& file){
 	if(!file.loaded){
 		return false;
 	}
@@ -11,98 +238,298 @@ bool Animation::init(const char* filename){
 	numBones = file.numBones;
 	animRate = file.animRate;
 
-	transforms = (Joint*)malloc(file.animLength);
-	memcpy(transforms, file.animation, file.animLength);
+	clip = file.clip;
+	file.clip.built = nullptr;
+	if(clip.built == nullptr){
+		source = std::move(file.file);
+	}
 
 	duration = (numFrames - 1) / (24.0f / animRate);
+	resident = true;
 
 	return true;
 }
 
 Animation::~Animation(){
-	if(transforms){
-		free(transforms);
+	free(clip.built);
+	source.close();
+}
+
+//Decode a kept keyframe into a pose of the clip's skeleton. Rotations are restored four at a time: the
+//largest component from the three stored, then all four moved to their places by the stored index.
+void Animation::decode(Uint32 key, Pose& pose){
+	memcpy(pose.channels, clip.constants, ANIM_CHANNELS * pose.stride * sizeof(float));
+
+	Uint8* data = clip.keys + key * clip.keySize;
+	Uint16* bones = clip.trackBones;
+	float* translations = (float*)data;
+	for(unsigned int i=0;i<clip.numTracks[0];i++){
+		for(unsigned int c=0;c<3;c++){
+			pose.channels[(ANIM_TRANSLATION + c) * pose.stride + bones[i]] = translations[i * 3 + c];
+		}
+	}
+	bones += clip.numTracks[0];
+
+	Uint16* rotations = (Uint16*)(data + clip.numTracks[0] * 12);
+	Lanes step = lanesSet(M_SQRT2 / 32767.0);
+	Lanes offset = lanesSet(M_SQRT1_2);
+	Lanes one = lanesSet(1.0);
+	for(unsigned int i=0;i<clip.numTracks[1];i+=4){
+		float stored[3][4], index[4];
+		for(unsigned int j=0;j<4;j++){
+			Uint16* rotation = &rotations[std::min(i + j, clip.numTracks[1] - 1) * 3];
+			for(unsigned int c=0;c<3;c++){
+				stored[c][j] = rotation[c] & 0x7FFF;
+			}
+			index[j] = (rotation[0] >> 15) | ((rotation[1] >> 15) << 1);
+		}
+
+		Lanes s0 = lanesSub(lanesMul(lanesLoad(stored[0]), step), offset);
+		Lanes s1 = lanesSub(lanesMul(lanesLoad(stored[1]), step), offset);
+		Lanes s2 = lanesSub(lanesMul(lanesLoad(stored[2]), step), offset);
+		Lanes sum = lanesAdd(lanesAdd(lanesMul(s0, s0), lanesMul(s1, s1)), lanesMul(s2, s2));
+		Lanes largest = lanesSqrt(lanesMax(lanesSub(one, sum), lanesSet(0.0)));
+
+		//Components before the largest keep their place, the ones after it move up by one.
+		Lanes largestIndex = lanesLoad(index);
+		Lanes is0 = lanesEqual(largestIndex, lanesSet(0.0));
+		Lanes is1 = lanesEqual(largestIndex, one);
+		Lanes is2 = lanesEqual(largestIndex, lanesSet(2.0));
+		Lanes is3 = lanesEqual(largestIndex, lanesSet(3.0));
+		float q[4][4];
+		lanesStore(q[0], lanesSelect(is0, largest, s0));
+		lanesStore(q[1], lanesSelect(is0, s0, lanesSelect(is1, largest, s1)));
+		lanesStore(q[2], lanesSelect(is3, s2, lanesSelect(is2, largest, s1)));
+		lanesStore(q[3], lanesSelect(is3, largest, s2));
+
+		for(unsigned int j=0;j<4 && i + j<clip.numTracks[1];j++){
+			for(unsigned int c=0;c<4;c++){
+				pose.channels[(ANIM_ROTATION + c) * pose.stride + bones[i + j]] = q[c][j];
+			}
+		}
+	}
+	bones += clip.numTracks[1];
+
+	float* scales = (float*)(data + clip.keySize - clip.numTracks[2] * 12);
+	for(unsigned int i=0;i<clip.numTracks[2];i++){
+		for(unsigned int c=0;c<3;c++){
+			pose.channels[(ANIM_SCALE + c) * pose.stride + bones[i]] = scales[i * 3 + c];
+		}
 	}
 }
 
+//Interpolate the pose at a frame and a fraction towards the next one between the kept keyframes around it.
+//Bones the clip lacks are set to the identity.
+void Animation::sample(Uint32 frame, float fraction, Pose& pose){
+	if(pose.numBones > numBones){
+		pose.identity();
+	}
+	frame = std::min(frame, numFrames - 1);
+	Uint32 key = clip.frameKeys[frame];
+	Uint32 next = std::min(key + 1, clip.numKeys - 1);
+	float span = clip.keyFrames[next] - clip.keyFrames[key];
+	float t = span > 0 ? (frame + fraction - clip.keyFrames[key]) / span : 0.0f;
+
+	float storage[POSE_FLOATS(ANIM_MAX_BONES) * 2];
+	Pose a, b;
+	a.init(numBones, storage);
+	b.init(numBones, &storage[POSE_FLOATS(numBones)]);
+	decode(key, a);
+	decode(next, b);
+
+	Uint32 count = (std::min(numBones, pose.numBones) + 3) & ~3u;
+	interpolatePose(a.channels, b.channels, a.stride, pose.channels, pose.stride, t, count);
+}
+
+//Joint palette of the clip at a time. Past the end the last keyframe is held.
 void Animation::calcJointTransforms(Mat4* joints, float time){
-	double keyIndex = 0;
-	float fraction = 0;
-	Uint32 last = 0;
-	Uint32 next = 0;
+	float frameTime = std::max(time * (24.0f / animRate), 0.0f);
+	Uint32 frame = std::min((Uint32)frameTime, numFrames - 1);
+
+	float storage[POSE_FLOATS(ANIM_MAX_BONES)];
+	Pose pose;
+	pose.init(numBones, storage);
+	sample(frame, std::min(frameTime - frame, 1.0f), pose);
+	pose.toMatrices(joints);
+}
 
-	Vec3 position;
-	Quat rotation;
-	Vec3 scale;
+//Move the playhead. Looping clips wrap, the others stop on their last keyframe.
+void AnimationTrack::advance(float delta){
+	if(anim == nullptr || !anim->resident){
+		return;
+	}
+	time += delta;
+	if(time >= anim->duration){
+		time = loop && anim->duration > 0 ? fmod(time, anim->duration) : anim->duration;
+	}
+	time = std::max(time, 0.0f);
 
-	Mat4 transMat;
-	Mat4 rotMat;
-	Mat4 scaleMat;
+	//Keyframes are evenly spaced, so the cached one only steps forward until the clip wraps.
+	float frameTime = time * (24.0f / anim->animRate);
+	if(frameTime < frame){
+		frame = 0;
+	}
+	while(frame + 2 < anim->numFrames && frameTime >= frame + 1){
+		frame++;
+	}
+	fraction = std::min(frameTime - frame, 1.0f);
+}
 
-	float frametime = time * (24.0 / animRate);
-	if(frametime >= numFrames - 1){
-		for(int i=0;i<numBones;i++){
-			joints[i] = Mat4::identity();
-		}
+//Pose at the playhead.
+void AnimationTrack::sample(Pose& pose){
+	anim->sample(frame, fraction, pose);
+}
+
+//Play a clip as the base, cross-fading from the one playing over fadeTime seconds.
+void AnimationPlayer::play(Animation* anim, float fadeTime, bool loop){
+	if(fadeTime > 0 && current.anim != nullptr){
+		previous = current;
+		fade = 0;
+		this->fadeTime = fadeTime;
 	}else{
-		for(int i=0;i<numBones;i++){
-			fraction = modf(frametime, &keyIndex);
+		previous.anim = nullptr;
+	}
+	current = AnimationTrack();
+	current.anim = anim;
+	current.loop = loop;
+}
 
-			last = (Uint32)keyIndex * numBones + i;
-			next = (Uint32)(keyIndex + 1) * numBones + i;
+//Play a clip on an additive layer from its start.
+void AnimationPlayer::playLayer(Uint32 layer, Animation* anim, float weight, bool loop){
+	if(layer >= ANIM_MAX_LAYERS){
+		std::cout<<"WARNING: Animation layer "<<layer<<" out of range."<<std::endl;
+		return;
+	}
+	layers[layer] = AnimationTrack();
+	layers[layer].anim = anim;
+	layers[layer].weight = weight;
+	layers[layer].loop = loop;
+}
 
-			position = Vec3::interpolate(transforms[last].translation, transforms[next].translation, fraction);
-			rotation = Quat::slerp(transforms[last].rotation, transforms[next].rotation, fraction);
-			scale = Vec3::interpolate(transforms[last].scaling, transforms[next].scaling, fraction);
+//Scale how much of a layer's motion is added.
+void AnimationPlayer::setLayerWeight(Uint32 layer, float weight){
+	if(layer < ANIM_MAX_LAYERS){
+		layers[layer].weight = weight;
+	}
+}
+
+//Stop an additive layer.
+void AnimationPlayer::stopLayer(Uint32 layer){
+	if(layer < ANIM_MAX_LAYERS){
+		layers[layer].anim = nullptr;
+	}
+}
+
+//Advance every clip by delta seconds.
+void AnimationPlayer::update(float delta){
+	current.advance(delta);
+	if(previous.anim != nullptr){
+		previous.advance(delta);
+		fade += delta;
+		if(fade >= fadeTime){
+			previous.anim = nullptr;
+		}
+	}
+	for(unsigned int i=0;i<ANIM_MAX_LAYERS;i++){
+		layers[i].advance(delta);
+	}
+}
 
-			transMat = Mat4::translation(position);
-			rotMat = rotation.toMatrix();
-			scaleMat = Mat4::scale(scale);
+//Joint palette of the blended pose, of at most ANIM_MAX_BONES bones. Clips still streaming in are left out.
+void AnimationPlayer::calcJointTransforms(Mat4* joints, Uint32 numBones){
+	numBones = std::min(numBones, (Uint32)ANIM_MAX_BONES);
+	Uint32 size = POSE_FLOATS(numBones);
+	float storage[POSE_FLOATS(ANIM_MAX_BONES) * 3];
+	Pose pose, other, reference;
+	pose.init(numBones, storage);
+	other.init(numBones, &storage[size]);
+	reference.init(numBones, &storage[size * 2]);
+
+	pose.identity();
+	if(current.anim != nullptr && current.anim->resident){
+		current.sample(pose);
+	}
+	if(previous.anim != nullptr && previous.anim->resident){
+		other.identity();
+		previous.sample(other);
+		pose.blend(other, 1 - fade / fadeTime);
+	}
 
-			joints[i] = scaleMat * rotMat * transMat;
+	for(unsigned int i=0;i<ANIM_MAX_LAYERS;i++){
+		AnimationTrack& layer = layers[i];
+		if(layer.anim == nullptr || !layer.anim->resident || layer.weight == 0){
+			continue;
 		}
+		other.identity();
+		reference.identity();
+		layer.sample(other);
+		layer.anim->sample(0, 0, reference);
+		pose.add(other, reference, layer.weight);
 	}
+
+	pose.toMatrices(joints);
 }
 
 //---------------------------------------------------------------------------------------------
 
+//Upload indexed, packed vertices into a new vertex array. Skinned vertices get the bone attributes too.
+static void uploadMesh(MeshData& mesh, Uint32& vao, Uint32& vbo, Uint32& ebo){
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, mesh.numVertices * mesh.vertexSize, mesh.vertices, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.numIndices * mesh.indexSize, mesh.indices, GL_STATIC_DRAW);
+
+	Uint32 stride = mesh.vertexSize;
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, false, stride, (void*)offsetof(PackedSkinnedVertex, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_SHORT, true, stride, (void*)offsetof(PackedSkinnedVertex, uv));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_HALF_FLOAT, false, stride, (void*)offsetof(PackedSkinnedVertex, normal));
+	if(mesh.vertexSize == sizeof(PackedSkinnedVertex)){
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, false, stride, (void*)offsetof(PackedSkinnedVertex, bones));
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, true, stride, (void*)offsetof(PackedSkinnedVertex, weights));
+	}
+}
+
 //Create a drawable 3d model.
 bool StaticModel::init(const char* filename){
 	StaticModelLoader file(filename);
+	return init(file);
+}
+
+//Upload already parsed model data. Must run on the thread owning the GL context.
+bool StaticModel::init(StaticModelLoader& file){
 	if(!file.loaded){
 		return false;
 	}
 
 	gProgram.init(
-		(glsl_header() + glsl_commonUniforms() + glsl_deferredStaticModelVertex()).c_str(),
+		(glsl_header() + glsl_commonUniforms() + glsl_instanceModels() + glsl_deferredStaticModelVertex(file.mesh.uvScale)).c_str(),
 		(glsl_header() + glsl_commonUniforms() + glsl_deferredAllModelFragment()).c_str()
 	);
 
 	shadowProgram.init(
-		(glsl_header() + glsl_staticModelShadowVertex()).c_str(),
+		(glsl_header() + glsl_instanceModels() + glsl_staticModelShadowVertex(file.mesh.uvScale)).c_str(),
 		(glsl_header() + glsl_commonUniforms() + glsl_allModelShadowFragment()).c_str()
 	);
 
-	numVertices = file.attribLength / (9 * sizeof(float));
-
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-	glBufferData(GL_ARRAY_BUFFER, file.attribLength, file.attributes, GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, 9 * sizeof(float), (void*)(0));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, false, 9 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, false, 9 * sizeof(float), (void*)(6 * sizeof(float)));
+	uploadMesh(file.mesh, vao, vbo, ebo);
+	numVertices = file.mesh.numVertices;
+	numIndices = file.mesh.numIndices;
+	indexType = file.mesh.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
 	glGenTextures(1, &diffuse);
 	glBindTexture(GL_TEXTURE_2D_ARRAY, diffuse);
-	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA32F, file.texWidth, file.texHeight, file.texDepth, false, GL_RGBA, GL_FLOAT, file.diffuse);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, file.texWidth, file.texHeight, file.texDepth, false, GL_RGBA, GL_UNSIGNED_BYTE, file.diffuse);
 
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -121,13 +548,23 @@ bool StaticModel::init(const char* filename){
 	memcpy(centroid.ptr(), file.centroid, 3 * sizeof(float));
 	cullRadius = file.cullRadius;
 
+	numChunks = file.numChunks;
+	chunks = (ModelChunk*)malloc(numChunks * sizeof(ModelChunk));
+	memcpy(chunks, file.chunks, numChunks * sizeof(ModelChunk));
+	resident = true;
+
 	return true;
 }
 
 //Static model destructor.
 StaticModel::~StaticModel(){
+	if(!resident){
+		return;
+	}
+	free(chunks);
 	glDeleteTextures(1, &metalRough);
 	glDeleteTextures(1, &diffuse);
+	glDeleteBuffers(1, &ebo);
 	glDeleteBuffers(1, &vbo);
 	glDeleteVertexArrays(1, &vao);
 }
@@ -137,6 +574,11 @@ StaticModel::~StaticModel(){
 //Create a drawable 3d model.
 bool AnimatedModel::init(const char* filename){
 	AnimatedModelLoader file(filename);
+	return init(file);
+}
+
+//Upload already parsed model data. Must run on the thread owning the GL context.
+bool AnimatedModel::init(AnimatedModelLoader& file){
 	if(!file.loaded){
 		return false;
 	}
@@ -144,39 +586,23 @@ bool AnimatedModel::init(const char* filename){
 	numBones = file.numBones;
 
 	gProgram.init(
-		(glsl_header() + glsl_commonUniforms() + glsl_deferredAnimatedModelVertex(numBones)).c_str(),
+		(glsl_header() + glsl_commonUniforms() + glsl_instanceModels() + glsl_instanceJoints() + glsl_deferredAnimatedModelVertex(file.mesh.uvScale)).c_str(),
 		(glsl_header() + glsl_commonUniforms() + glsl_deferredAllModelFragment()).c_str()
 	);
 
 	shadowProgram.init(
-		(glsl_header() + glsl_animatedModelShadowVertex(numBones)).c_str(),
+		(glsl_header() + glsl_instanceModels() + glsl_instanceJoints() + glsl_animatedModelShadowVertex(file.mesh.uvScale)).c_str(),
 		(glsl_header() + glsl_emptyShader()).c_str()
 	);
 
-	numVertices = file.attribLength / (17 * sizeof(float));
-
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-	glBufferData(GL_ARRAY_BUFFER, file.attribLength, file.attributes, GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, 17 * sizeof(float), (void*)(0));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, false, 17 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, false, 17 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 4, GL_FLOAT, false, 17 * sizeof(float), (void*)(9 * sizeof(float)));
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 4, GL_FLOAT, false, 17 * sizeof(float), (void*)(13 * sizeof(float)));
+	uploadMesh(file.mesh, vao, vbo, ebo);
+	numVertices = file.mesh.numVertices;
+	numIndices = file.mesh.numIndices;
+	indexType = file.mesh.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
 	glGenTextures(1, &diffuse);
 	glBindTexture(GL_TEXTURE_2D_ARRAY, diffuse);
-	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA32F, file.texWidth, file.texHeight, file.texDepth, false, GL_RGBA, GL_FLOAT, file.diffuse);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, file.texWidth, file.texHeight, file.texDepth, false, GL_RGBA, GL_UNSIGNED_BYTE, file.diffuse);
 
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -194,14 +620,19 @@ bool AnimatedModel::init(const char* filename){
 
 	memcpy(centroid.ptr(), file.centroid, 3 * sizeof(float));
 	cullRadius = file.cullRadius;
+	resident = true;
 
 	return true;
 }
 
 //Animated model destructor.
 AnimatedModel::~AnimatedModel(){
+	if(!resident){
+		return;
+	}
 	glDeleteTextures(1, &metalRough);
 	glDeleteTextures(1, &diffuse);
+	glDeleteBuffers(1, &ebo);
 	glDeleteBuffers(1, &vbo);
 	glDeleteVertexArrays(1, &vao);
 }
@@ -209,19 +640,24 @@ AnimatedModel::~AnimatedModel(){
 //------------------------------------------------------------------------------------
 
 //Physics mesh init.
-bool PhysicsMesh::init(const char* filename){
+bool PhysicsMesh::init(const char* filename, bool climb){
 	PhysicsMeshLoader file(filename);
+	return init(file, climb);
+}
+
+//Build the mesh from already parsed data. With climb, convexes of CONVEX_CLIMB_MIN_VERTICES or more get the
+//adjacency of their hull, so support points are found by hill climbing instead of scanning every vertex.
+bool PhysicsMesh::init(PhysicsMeshLoader& file, bool climb){
 	if(!file.loaded){
 		return false;
 	}
 
 	numConvexes = file.numConvexes;
-	
-	vertices = (Vec3*)malloc(file.vertsLength);
-	memcpy(vertices, file.vertices, file.vertsLength);
 
-	indices = (Uint16*)malloc(file.indsLength);
-	memcpy(indices, file.indices, file.indsLength);
+	//Vertices and indices are used in place, so keep the mapping alive.
+	vertices = (Vec3*)file.vertices;
+	indices = file.indices;
+	source = std::move(file.file);
 
 	convexes = (BoundingConvex*)malloc(numConvexes * sizeof(BoundingConvex));
 	Uint32 counter = 0;
@@ -230,16 +666,51 @@ bool PhysicsMesh::init(const char* filename){
 		counter += indices[i];
 	}
 
+	if(climb){
+		buildAdjacency();
+	}
+
+	tree.build(convexes, numConvexes);
+	resident = true;
+
 	return true;
 }
 
+//Give the large convexes hull adjacency, with offsets and neighbors of all of them in two arrays sized from
+//the hulls built. Convexes are pointed into the arrays once they stop growing.
+void PhysicsMesh::buildAdjacency(){
+	std::vector<Uint32> climbing, firstOffsets, firstNeighbors;
+	for(unsigned int i=0;i<numConvexes;i++){
+		BoundingConvex& convex = convexes[i];
+		if(convex.numVertices < CONVEX_CLIMB_MIN_VERTICES){
+			continue;
+		}
+		Uint32 offset = adjacencyOffsets.size(), neighbor = adjacencyNeighbors.size();
+		if(!BoundingConvex::buildAdjacency(convex.vertices, convex.numVertices, adjacencyOffsets, adjacencyNeighbors)){
+			std::cout<<"WARNING: Convex "<<i<<" is flat or too large, support points fall back to scanning."<<std::endl;
+			continue;
+		}
+		climbing.push_back(i);
+		firstOffsets.push_back(offset);
+		firstNeighbors.push_back(neighbor);
+	}
+
+	for(unsigned int i=0;i<climbing.size();i++){
+		BoundingConvex& convex = convexes[climbing[i]];
+		convex.offsets = &adjacencyOffsets[firstOffsets[i]];
+		convex.neighbors = &adjacencyNeighbors[firstNeighbors[i]];
+		while(convex.offsets[convex.seed] == convex.offsets[convex.seed + 1]){
+			convex.seed++;
+		}
+	}
+}
+
 //Physics mesh destructor.
 PhysicsMesh::~PhysicsMesh(){
-	if(vertices){
+	if(resident){
 		free(convexes);
-		free(vertices);
-		free(indices);
 	}
+	source.close();
 }
 
 //------------------------------------------------------------------------------------------------------
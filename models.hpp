@@ -2,6 +2,12 @@
 
 #include "3Dphysics.hpp"
 #include "shader.hpp"
+#include "loaders.hpp"
+
+#define ANIM_MAX_LAYERS 4			//Additive layers of an animation player.
+
+//Floats of pose storage for a skeleton.
+#define POSE_FLOATS(numBones) (ANIM_CHANNELS * (((numBones) + 3) & ~3u))
 
 //Joint.
 struct Joint{
@@ -10,12 +16,31 @@ struct Joint{
 	Vec3 scaling;
 };
 
+//Joint transforms of a skeleton as one stream per channel, so bones are blended four at a time.
+//Every stream holds stride floats, the bone count rounded up to four. The storage belongs to the caller.
+struct Pose{
+	Pose(){};
+	void init(Uint32 numBones, float* storage);
+
+	void identity();
+	void blend(Pose& other, float weight);
+	void add(Pose& layer, Pose& reference, float weight);
+	void toMatrices(Mat4* joints);
+
+	Uint32 numBones = 0;
+	Uint32 stride = 0;
+	float* channels = nullptr;	//ANIM_CHANNELS streams of stride floats.
+};
+
 //Skeletal animation.
 struct Animation{
 	Animation(){};
 	bool init(const char* filename);
+	bool init(AnimationLoader& file);
 	~Animation();
 
+	void decode(Uint32 key, Pose& pose);
+	void sample(Uint32 frame, float fraction, Pose& pose);
 	void calcJointTransforms(Mat4* joints, float time);
 
 	float duration;
@@ -23,50 +48,102 @@ struct Animation{
 	Uint32 numFrames;
 	Uint32 numBones;
 	Uint32 animRate;
-	
-	Joint* transforms;
+
+	ClipData clip;				//Compressed keyframes, decoded as they are sampled.
+	MappedFile source;			//Compressed files the clip points into.
+	bool resident = false;		//False until loaded.
+};
+
+//Playback of one clip. The keyframe before the playhead is kept between updates.
+struct AnimationTrack{
+	void advance(float delta);
+	void sample(Pose& pose);
+
+	Animation* anim = nullptr;
+	float time = 0.0;
+	float weight = 1.0;
+	bool loop = true;
+	Uint32 frame = 0;
+	float fraction = 0.0;		//Position between frame and the next keyframe.
+};
+
+//Plays animations on one skeleton. The base clip cross-fades into the next one played, additive layers
+//add their motion relative to their first keyframe on top. Clips loop or hold their last keyframe.
+//Update once per frame before drawing, the renderer evaluates the pose on its workers.
+struct AnimationPlayer{
+	AnimationPlayer(){};
+	~AnimationPlayer(){};
+
+	void play(Animation* anim, float fadeTime = 0.0, bool loop = true);
+	void playLayer(Uint32 layer, Animation* anim, float weight = 1.0, bool loop = true);
+	void setLayerWeight(Uint32 layer, float weight);
+	void stopLayer(Uint32 layer);
+	void update(float delta);
+	void calcJointTransforms(Mat4* joints, Uint32 numBones);
+
+	AnimationTrack current;
+	AnimationTrack previous;	//Clip fading out.
+	float fade = 0.0;
+	float fadeTime = 0.0;
+	AnimationTrack layers[ANIM_MAX_LAYERS];
 };
 
 //A drawable 3d model.
 struct StaticModel{
 	StaticModel(){};
 	bool init(const char* filename);
+	bool init(StaticModelLoader& file);
 	~StaticModel();
 
-	Uint32 numVertices;
+	Uint32 numVertices, numIndices;
+	Uint32 indexType;		//GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
 
 	Shader gProgram, shadowProgram;
-	Uint32 vao, vbo;
+	Uint32 vao, vbo, ebo;
 	Uint32 diffuse, metalRough;
 
 	Vec3 centroid;
 	float cullRadius;
+	Uint32 numChunks = 0;
+	ModelChunk* chunks = nullptr;	//Index ranges drawn and culled separately.
+	bool resident = false;	//False until uploaded. Renderer skips the model before that.
 };
 
 //A drawable 3d model.
 struct AnimatedModel{
 	AnimatedModel(){};
 	bool init(const char* filename);
+	bool init(AnimatedModelLoader& file);
 	~AnimatedModel();
 
-	Uint32 numVertices, numBones;
+	Uint32 numVertices, numIndices, numBones;
+	Uint32 indexType;		//GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
 
 	Shader gProgram, shadowProgram;
-	Uint32 vao, vbo;
+	Uint32 vao, vbo, ebo;
 	Uint32 diffuse, metalRough;
 
 	Vec3 centroid;
 	float cullRadius;
+	bool resident = false;	//False until uploaded. Renderer skips the model before that.
 };
 
 //Physics mesh
 struct PhysicsMesh{
 	PhysicsMesh(){};	
-	bool init(const char* filename);
+	bool init(const char* filename, bool climb = true);
+	bool init(PhysicsMeshLoader& file, bool climb = true);
 	~PhysicsMesh();	
 
+	void buildAdjacency();
+
 	Uint32 numConvexes;
-	Vec3* vertices = nullptr;
-	Uint16* indices;
+	Vec3* vertices = nullptr;	//Points into the mapped source file.
+	Uint16* indices;			//Points into the mapped source file.
 	BoundingConvex* convexes;
+	std::vector<Uint32> adjacencyOffsets;	//Hull adjacency of the convexes large enough to hill climb,
+	std::vector<Uint16> adjacencyNeighbors;	//all of them one after the other.
+	AABBTree tree;
+	MappedFile source;
+	bool resident = false;		//False until loaded.
 };
@@ -4,6 +4,9 @@
 int Renderer::init(RendererSettings settings){
 	this->settings = settings;
 
+	//Pose workers. The render thread works too, so one core is left to it.
+	jobs.init(std::min(settings.rendererPoseWorkers, (Uint32)std::max(SDL_GetCPUCount() - 1, 0)));
+
 	//Init SDL.
 	SDL_Init(SDL_INIT_EVERYTHING);
 
@@ -142,7 +145,7 @@ int Renderer::init(RendererSettings settings){
 	//Setup shader programs.
 	deferredProgram.init(
 		(glsl_header() + glsl_displayQuadVertex()).c_str(),
-		(glsl_header() + glsl_commonUniforms() +
+		(glsl_header() + glsl_commonUniforms() + glsl_lightBuffers() + glsl_lightClusters() +
 			glsl_lightCalculations() + glsl_deferredLightPassFragment()).c_str()
 	);
 
@@ -195,18 +198,42 @@ int Renderer::init(RendererSettings settings){
 	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
 
 	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowImages, 0);
+
+	//Static shadow cache, copied into the shadow maps before dynamic casters are drawn.
+	glGenTextures(1, &staticShadowImages);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, staticShadowImages);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, settings.shadowWidth, settings.shadowHeight, NUM_SUN_CASCADES + MAX_SPOTLIGHTS, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenQueries(2, shadowQueries);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-	//Light queue stuff.
-	numPointlights = 0;
-	numSpotlights = 0;
-
-	//Draw queue stuff.
-	numRequests = 0;
-	mostBones = 0;
-	drawQueue = (DrawRequest*)malloc(settings.rendererDrawQueueSize * sizeof(DrawRequest));
+	//Light and draw queues live in the frame arena and grow when full.
+	arena.init(settings.rendererFrameArenaSize);
+	pointlightCapacity = settings.rendererLightQueueSize;
+	spotlightCapacity = settings.rendererLightQueueSize;
+	requestCapacity = settings.rendererDrawQueueSize;
+	beginFrame();
+
+	glGenBuffers(1, &pointlightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_POINTLIGHT_BASE, pointlightBuffer);
+	glGenBuffers(1, &spotlightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_SPOTLIGHT_BASE, spotlightBuffer);
+	glGenBuffers(1, &clusterCellBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_CLUSTER_CELL_BASE, clusterCellBuffer);
+	glGenBuffers(1, &clusterIndexBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_CLUSTER_INDEX_BASE, clusterIndexBuffer);
+
+	//Instance data, sized every frame for the G-buffer and shadow pass instances.
+	glGenBuffers(1, &instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_INSTANCE_BASE, instanceBuffer);
+	glGenBuffers(1, &instancePoseBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_INSTANCE_POSE_BASE, instancePoseBuffer);
+	glGenBuffers(1, &jointBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_JOINT_BASE, jointBuffer);
 
 	//Camera stuff.
 	pitch = 0.0;
@@ -215,16 +242,23 @@ int Renderer::init(RendererSettings settings){
 	camDirection.z = sin(pitch);
 	camDirection.y = sin(yaw) * cos(pitch);
 
-	camFrustum = BoundingConvex(frustumCorners, 8);
-
 	return 0;
 }
 
 //Renderer destructor.
 Renderer::~Renderer(){
-	free(drawQueue);
+	glDeleteBuffers(1, &instanceBuffer);
+	glDeleteBuffers(1, &instancePoseBuffer);
+	glDeleteBuffers(1, &jointBuffer);
+	glDeleteBuffers(1, &pointlightBuffer);
+	glDeleteBuffers(1, &spotlightBuffer);
+	glDeleteBuffers(1, &clusterCellBuffer);
+	glDeleteBuffers(1, &clusterIndexBuffer);
 
 	glDeleteFramebuffers(1, &shadowBuffer);
+	glDeleteTextures(1, &shadowImages);
+	glDeleteTextures(1, &staticShadowImages);
+	glDeleteQueries(2, shadowQueries);
 
 	glDeleteBuffers(1, &ubo);
 
@@ -262,60 +296,626 @@ void Renderer::bindDisplay(){
 	glViewport(0, 0, settings.frameWidth, settings.frameHeight);
 }
 
-//Deferred lighting pass.
-void Renderer::deferredPass(){
-	//Calculate shadow projections.
-	float scale = 8.0;
-	for(int i=0;i<NUM_SUN_CASCADES;i++){
-		uniforms.lights.sun.projViewCSM[i] = Mat4::lookAt(
-		Vec3::normalize(uniforms.lights.sun.direction) * 200 + (uniforms.common.camPosition),
-		(uniforms.common.camPosition), Vec3(0,0,1)) * 
-		Mat4::orthographic(-scale, scale, -scale, scale, 0.01, 400.0);
-		scale *= 2.0;
+//True when two requests can share an instanced draw. Poses are per instance, so animated requests need not match.
+static bool sameBatch(const DrawRequest& a, const DrawRequest& b){
+	return a.gProgram == b.gProgram && a.shadowProgram == b.shadowProgram && a.vao == b.vao &&
+		a.firstIndex == b.firstIndex && a.numIndices == b.numIndices && a.diffuse == b.diffuse && a.metalRough == b.metalRough;
+}
+
+//Byte offset of a request's first index in its model's index buffer.
+static void* indexOffset(const DrawRequest& request){
+	return (void*)(size_t)(request.firstIndex * (request.indexType == GL_UNSIGNED_SHORT ? 2 : 4));
+}
+
+//Sort keys together with their values. Least significant digit radix sort, 8 bits per pass.
+//Passes where all keys share the digit are skipped. Stable, so equal keys keep queue order.
+static void radixSort(Uint64* keys, Uint32* values, Uint64* tempKeys, Uint32* tempValues, Uint32 count){
+	if(count == 0){
+		return;
 	}
 
-	for(int i=0;i<uniforms.lights.numSpotlights;i++){
-		uniforms.lights.spotlights[i].projViewCSM = Mat4::lookAt(
-			uniforms.lights.spotlights[i].position,
-			Vec3::normalize(uniforms.lights.spotlights[i].direction) + uniforms.lights.spotlights[i].position,
-			Vec3(0,0,1)
-		) * Mat4::perspective(acos(uniforms.lights.spotlights[i].cutOff) * 2.0, 1, 0.01, 100.0);
+	Uint64* srcKeys = keys;
+	Uint32* srcValues = values;
+	for(unsigned int shift=0;shift<64;shift+=8){
+		Uint32 offsets[256] = {0};
+		for(unsigned int i=0;i<count;i++){
+			offsets[(srcKeys[i] >> shift) & 0xFF]++;
+		}
+		if(offsets[(srcKeys[0] >> shift) & 0xFF] == count){
+			continue;
+		}
+
+		Uint32 sum = 0;
+		for(unsigned int i=0;i<256;i++){
+			Uint32 digitCount = offsets[i];
+			offsets[i] = sum;
+			sum += digitCount;
+		}
+		for(unsigned int i=0;i<count;i++){
+			Uint32 destination = offsets[(srcKeys[i] >> shift) & 0xFF]++;
+			tempKeys[destination] = srcKeys[i];
+			tempValues[destination] = srcValues[i];
+		}
+
+		std::swap(srcKeys, tempKeys);
+		std::swap(srcValues, tempValues);
 	}
 
-	//Set all remaining uniforms.
+	if(srcKeys != keys){
+		memcpy(keys, srcKeys, count * sizeof(Uint64));
+		memcpy(values, srcValues, count * sizeof(Uint32));
+	}
+}
+
+//Fill order with the queue sorted by program, vao and material. The G-buffer order is front to
+//back within equal state, the shadow order ignores depth and uses the shadow program.
+void Renderer::sortRequests(bool shadow, Uint32* order){
+	for(unsigned int i=0;i<numRequests;i++){
+		Uint64 depthBucket = 0;
+		if(!shadow){
+			float depth = Vec3::dot(drawCentroids[i] - uniforms.common.camPosition, camDirection) - drawQueue[i].cullRadius;
+			depth = std::min(std::max(depth / settings.cameraFar, 0.0f), 1.0f);
+			depthBucket = (Uint64)(depth * SORT_KEY_DEPTH_BUCKETS);
+		}
+
+		Uint32 program = shadow ? drawQueue[i].shadowProgram : drawQueue[i].gProgram;
+		drawKeys[i] =
+			((Uint64)(program & 0xFFFF) << SORT_KEY_PROGRAM_SHIFT) |
+			((Uint64)(drawQueue[i].vao & 0xFFFF) << SORT_KEY_VAO_SHIFT) |
+			((Uint64)(drawQueue[i].diffuse & 0xFFFF) << SORT_KEY_MATERIAL_SHIFT) |
+			depthBucket;
+		order[i] = i;
+	}
+
+	radixSort(drawKeys, order, sortKeys, sortOrder, numRequests);
+}
+
+//Collect count requests in the given order into instanced batches, optionally dropping requests outside the camera frustum.
+//Model matrices and pose offsets of the batched requests are appended to the instance staging arrays.
+void Renderer::batchRequests(Uint32* order, Uint32 count, bool cull, Uint32& numInstances, Uint32& numBatches){
+	Uint32 firstBatch = numBatches;
+
+	for(unsigned int i=0;i<count;i++){
+		Uint32 index = order[i];
+		if(cull && !drawVisible[index]){
+			stats.requestsCulled++;
+			continue;
+		}
+
+		//Sorting puts equal requests next to each other, so only the previous batch can match.
+		if(numBatches == firstBatch || !sameBatch(drawQueue[drawBatches[numBatches - 1].request], drawQueue[index])){
+			drawBatches[numBatches].request = index;
+			drawBatches[numBatches].firstInstance = numInstances;
+			drawBatches[numBatches].numInstances = 0;
+			numBatches++;
+		}
+
+		instanceModels[numInstances] = drawModels[index];
+		instancePoses[numInstances++] = drawPoses[index];
+		drawBatches[numBatches - 1].numInstances++;
+	}
+}
+
+//Fold a request's shadow relevant state into a hash.
+static Uint64 hashRequest(Uint64 hash, const DrawRequest& request, const Mat4& model){
+	const Uint32 fields[4] = {request.vao, request.firstIndex, request.numIndices, request.diffuse};
+	const Uint8* bytes[2] = {(const Uint8*)fields, (const Uint8*)model.m};
+	const Uint32 sizes[2] = {sizeof(fields), sizeof(model.m)};
+	for(unsigned int i=0;i<2;i++){
+		for(unsigned int j=0;j<sizes[i];j++){
+			hash = (hash ^ bytes[i][j]) * 0x100000001B3;
+		}
+	}
+	return hash;
+}
+
+//Fill the visible lists of every shadow light with the requests touching its cascade box or spotlight frustum,
+//in shadow order. With the static cache on, static casters go to their own list, which is only kept for
+//layers whose light volume or static casters changed. Returns the number of caster and light pairs to draw.
+Uint32 Renderer::cullShadowCasters(Uint32 numShadowLights){
+	bool cache = settings.shadowStaticCache;
+	Uint32 numCasters = 0;
+	Uint32 numCached = 0;
+	Uint32 numGroups = 0;
+	for(unsigned int i=0;i<numRequests;i++){
+		if(i == 0 || !sameBatch(drawQueue[shadowOrder[i - 1]], drawQueue[shadowOrder[i]])){
+			numGroups++;
+		}
+	}
+
+	Uint8* inside = (Uint8*)arena.allocate(numRequests);
+	for(unsigned int i=0;i<numShadowLights;i++){
+		Mat4& lightProjView = i < NUM_SUN_CASCADES ?
+			uniforms.lights.sun.projViewCSM[i] : spotlights[i - NUM_SUN_CASCADES].projViewCSM;
+		Frustum(lightProjView).intersect(cullX, cullY, cullZ, cullRadius, inside, numRequests);
+
+		Uint32* visible = &shadowVisible[i * numRequests];
+		Uint32* staticVisible = &shadowStaticVisible[i * numRequests];
+		Uint32 count = 0;
+		Uint32 staticCount = 0;
+		Uint64 signature = 0xCBF29CE484222325;
+		for(unsigned int j=0;j<numRequests;j++){
+			Uint32 index = shadowOrder[j];
+
+			//Casters past a spotlight's radius cannot shade anything it lights.
+			if(i >= NUM_SUN_CASCADES){
+				Spotlight& spot = spotlights[i - NUM_SUN_CASCADES];
+				Vec3 offset = drawCentroids[index] - spot.position;
+				float reach = spot.radius + drawQueue[index].cullRadius;
+				if(Vec3::dot(offset, offset) > reach * reach){
+					continue;
+				}
+			}
+
+			if(!inside[index]){
+				continue;
+			}
+
+			if(cache && drawQueue[index].isStatic){
+				staticVisible[staticCount++] = index;
+				signature = hashRequest(signature, drawQueue[index], drawModels[index]);
+			}else{
+				visible[count++] = index;
+			}
+		}
+
+		//Layers follow the lit lights, so a light moving, turning or changing layer dirties the layer.
+		ShadowCacheEntry& entry = shadowCache[i];
+		shadowCacheDirty[i] = cache && (!entry.valid || entry.signature != signature ||
+			memcmp(entry.projView.m, lightProjView.m, sizeof(lightProjView.m)) != 0);
+		entry.valid = cache;
+		entry.signature = signature;
+		entry.projView = lightProjView;
+
+		if(!shadowCacheDirty[i]){
+			numCached += staticCount;
+			staticCount = 0;
+		}else{
+			stats.shadowLayersRebuilt++;
+		}
+
+		shadowVisibleCount[i] = count;
+		shadowStaticCount[i] = staticCount;
+		numCasters += count + staticCount;
+	}
+
+	stats.shadowCasters = numCasters;
+	stats.shadowCastersCached = numCached;
+	stats.shadowCastersCulled = numRequests * numShadowLights - numCasters - numCached;
+	stats.shadowDrawsUnculled = numGroups * numShadowLights;
+	return numCasters;
+}
+
+//Drop every cached static shadow layer, for when static geometry changes in a way requests do not show.
+void Renderer::invalidateShadowCache(){
+	for(unsigned int i=0;i<NUM_SUN_CASCADES + MAX_SPOTLIGHTS;i++){
+		shadowCache[i].valid = false;
+	}
+}
+
+//Draw a range of shadow batches into the attached layer.
+void Renderer::drawShadowBatches(Uint32 firstBatch, Uint32 endBatch, Mat4& lightProjView){
+	for(unsigned int i=firstBatch;i<endBatch;i++){
+		DrawRequest& request = drawQueue[drawBatches[i].request];
+		useProgram(request.shadowProgram);
+		glUniform1i(0, drawBatches[i].firstInstance);
+		glUniformMatrix4fv(1, 1, false, lightProjView.ptr());
+
+		bindVertexArray(request.vao);
+
+		//Alpha tested shadows read the diffuse alpha.
+		bindTexture(0, request.diffuse);
+
+		glDrawElementsInstanced(GL_TRIANGLES, request.numIndices, request.indexType, indexOffset(request), drawBatches[i].numInstances);
+		stats.drawCalls++;
+	}
+}
+
+//True when a request draws an evaluated pose.
+static bool posed(DrawRequest& request){
+	return request.anim != nullptr || request.player != nullptr;
+}
+
+//Joints in a request's palette. Clips are evaluated for all their bones, players for the model's.
+static Uint32 poseJoints(DrawRequest& request){
+	return request.player != nullptr ? request.numBones : std::max(request.numBones, request.anim->numBones);
+}
+
+//Evaluate the joint palettes of one worker's range of poses.
+static void evaluatePoseRange(void* data, Uint32 first, Uint32 end){
+	PoseJobData& poses = *(PoseJobData*)data;
+	for(unsigned int i=first;i<end;i++){
+		Uint32 index = poses.requests[i];
+		DrawRequest& request = poses.queue[index];
+		if(request.player != nullptr){
+			request.player->calcJointTransforms(&poses.palettes[poses.offsets[index]], request.numBones);
+		}else{
+			request.anim->calcJointTransforms(&poses.palettes[poses.offsets[index]], request.animTime);
+		}
+	}
+}
+
+//Find every distinct pose among the drawn animated requests and hand them to the pose workers, which fill
+//the frame's joint palettes while the render thread batches. Requests playing the same animation at the
+//same time, or drawn with the same player, share a palette. Each request gets the first joint of its palette.
+//Call finishPoses before uploading.
+void Renderer::evaluatePoses(){
+	Uint64 start = SDL_GetPerformanceCounter();
+	const Uint32 none = 0xFFFFFFFF;
+
+	//Only requests seen by the camera or casting into a shadow layer need their pose.
+	Uint8* drawn = (Uint8*)arena.allocate(numRequests);
+	memcpy(drawn, drawVisible, numRequests);
+	for(unsigned int i=0;i<NUM_SUN_CASCADES + numLitSpotlights;i++){
+		for(unsigned int j=0;j<shadowVisibleCount[i];j++){
+			drawn[shadowVisible[i * numRequests + j]] = 1;
+		}
+	}
+
+	//Palette storage for the worst case of no shared poses, and a hash table from pose to request.
+	Uint32 maxJoints = 0;
+	Uint32 numAnimated = 0;
+	for(unsigned int i=0;i<numRequests;i++){
+		DrawRequest& request = drawQueue[i];
+		if(posed(request) && drawn[i]){
+			maxJoints += poseJoints(request);
+			numAnimated++;
+		}
+	}
+	Uint32 tableSize = 1;
+	while(tableSize < numAnimated * 2){
+		tableSize <<= 1;
+	}
+	Uint32* table = (Uint32*)arena.allocate(tableSize * sizeof(Uint32));
+	memset(table, 0xFF, tableSize * sizeof(Uint32));
+	jointPalettes = (Mat4*)arena.allocate(std::max(maxJoints, 1u) * sizeof(Mat4));
+	Uint32* poseRequests = (Uint32*)arena.allocate(std::max(numAnimated, 1u) * sizeof(Uint32));
+	numJoints = 0;
+
+	for(unsigned int i=0;i<numRequests;i++){
+		DrawRequest& request = drawQueue[i];
+		drawPoses[i] = 0;
+		if(!posed(request) || !drawn[i]){
+			continue;
+		}
+
+		Uint32 timeBits;
+		memcpy(&timeBits, &request.animTime, 4);
+		Uint64 source = (Uint64)(size_t)request.anim ^ (Uint64)(size_t)request.player;
+		Uint64 hash = (source ^ ((Uint64)timeBits << 32)) * 0x9E3779B97F4A7C15;
+		Uint32 slot = (hash >> 32) & (tableSize - 1);
+		while(table[slot] != none){
+			DrawRequest& other = drawQueue[table[slot]];
+			if(other.anim == request.anim && other.player == request.player && other.animTime == request.animTime &&
+				other.numBones == request.numBones){
+				break;
+			}
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if(table[slot] != none){
+			drawPoses[i] = drawPoses[table[slot]];
+			stats.posesShared++;
+			continue;
+		}
+		table[slot] = i;
+		drawPoses[i] = numJoints;
+		poseRequests[stats.posesEvaluated++] = i;
+		numJoints += poseJoints(request);
+	}
+
+	//A couple of poses per job keeps stealing cheap next to the cost of a pose.
+	poseJobs = {drawQueue, poseRequests, drawPoses, jointPalettes};
+	jobs.parallelFor(evaluatePoseRange, &poseJobs, stats.posesEvaluated, 2, poseCounter);
+
+	stats.skinningMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+//Wait for the pose workers, helping with what is left.
+void Renderer::finishPoses(){
+	Uint64 start = SDL_GetPerformanceCounter();
+	jobs.wait(poseCounter);
+	stats.skinningMs += (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+//Use a program unless it already is in use.
+void Renderer::useProgram(Uint32 program){
+	if(program == boundProgram){
+		stats.skippedBinds++;
+		return;
+	}
+	glUseProgram(program);
+	boundProgram = program;
+	stats.programBinds++;
+}
+
+//Bind a vertex array unless it already is bound.
+void Renderer::bindVertexArray(Uint32 vao){
+	if(vao == boundVao){
+		stats.skippedBinds++;
+		return;
+	}
+	glBindVertexArray(vao);
+	boundVao = vao;
+	stats.vaoBinds++;
+}
+
+//Bind a texture array to a unit unless it already is bound there.
+void Renderer::bindTexture(Uint32 unit, Uint32 texture){
+	if(texture == boundTextures[unit]){
+		stats.skippedBinds++;
+		return;
+	}
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	boundTextures[unit] = texture;
+	stats.textureBinds++;
+}
+
+//Attach a shadow map layer as the depth target.
+void Renderer::bindShadowLayer(Uint32 texture, Uint32 layer){
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+	stats.layerBinds++;
+}
+
+//Allocate this frame's queues from the arena at their current capacities.
+void Renderer::beginFrame(){
+	numPointlights = 0;
+	numSpotlights = 0;
+	pointlights = (Pointlight*)arena.allocate(pointlightCapacity * sizeof(Pointlight));
+	spotlights = (Spotlight*)arena.allocate(spotlightCapacity * sizeof(Spotlight));
+
+	numRequests = 0;
+	drawQueue = (DrawRequest*)arena.allocate(requestCapacity * sizeof(DrawRequest));
+	drawModels = (Mat4*)arena.allocate(requestCapacity * sizeof(Mat4));
+	drawCentroids = (Vec3*)arena.allocate(requestCapacity * sizeof(Vec3));
+}
+
+//Double the draw queue capacity. The old arrays stay in the arena until the frame ends.
+void Renderer::growDrawQueue(){
+	requestCapacity *= 2;
+
+	DrawRequest* oldQueue = drawQueue;
+	Mat4* oldModels = drawModels;
+	Vec3* oldCentroids = drawCentroids;
+	drawQueue = (DrawRequest*)arena.allocate(requestCapacity * sizeof(DrawRequest));
+	drawModels = (Mat4*)arena.allocate(requestCapacity * sizeof(Mat4));
+	drawCentroids = (Vec3*)arena.allocate(requestCapacity * sizeof(Vec3));
+
+	for(unsigned int i=0;i<numRequests;i++){
+		drawQueue[i] = oldQueue[i];
+		drawModels[i] = oldModels[i];
+		drawCentroids[i] = oldCentroids[i];
+	}
+}
+
+//Rough screen contribution of a light: brightness scaled by the solid angle of its radius.
+//Lights outside the camera frustum get 0.
+float Renderer::lightPriority(Vec3 position, float radius, Vec3 diffuse){
+	if(!camFrustum.intersect(position, radius)){
+		return 0.0;
+	}
+
+	float brightness = 0.2126 * diffuse.x + 0.7152 * diffuse.y + 0.0722 * diffuse.z;
+	float distance = std::max((position - uniforms.common.camPosition).length(), radius);
+	return brightness * (radius * radius) / (distance * distance);
+}
+
+//Move the lights worth drawing to the front of the queue and return their count. Lights that
+//contribute nothing are dropped, past maxLights only the largest contributions are kept.
+template<typename T> Uint32 Renderer::selectLights(T* lights, Uint32 numLights, Uint32 maxLights){
+	float* priorities = (float*)arena.allocate(numLights * sizeof(float));
+	Uint32* order = (Uint32*)arena.allocate(numLights * sizeof(Uint32));
+
+	Uint32 numLit = 0;
+	for(unsigned int i=0;i<numLights;i++){
+		priorities[i] = lightPriority(lights[i].position, lights[i].radius, lights[i].diffuse);
+		if(priorities[i] > 0.0){
+			order[numLit++] = i;
+		}
+	}
+
+	if(numLit > maxLights){
+		std::nth_element(order, order + maxLights, order + numLit,
+			[priorities](Uint32 a, Uint32 b){return priorities[a] > priorities[b];});
+		numLit = maxLights;
+
+		//Keep queue order among the kept lights so shadow layers stay put between frames.
+		std::sort(order, order + numLit);
+	}
+
+	//Kept indices are ascending, so compacting in place never overwrites a light still to be read.
+	for(unsigned int i=0;i<numLit;i++){
+		lights[i] = lights[order[i]];
+	}
+	return numLit;
+}
+
+//Bin the lit lights into view clusters and upload the cluster lists.
+void Renderer::buildClusters(Mat4 view, Mat4 proj){
+	Uint32 numLights = numLitPointlights + numLitSpotlights;
+	float* x = (float*)arena.allocate(numLights * sizeof(float));
+	float* y = (float*)arena.allocate(numLights * sizeof(float));
+	float* z = (float*)arena.allocate(numLights * sizeof(float));
+	float* radius = (float*)arena.allocate(numLights * sizeof(float));
+
+	for(unsigned int i=0;i<numLitPointlights;i++){
+		x[i] = pointlights[i].position.x;
+		y[i] = pointlights[i].position.y;
+		z[i] = pointlights[i].position.z;
+		radius[i] = pointlights[i].radius;
+	}
+	for(unsigned int i=0;i<numLitSpotlights;i++){
+		x[numLitPointlights + i] = spotlights[i].position.x;
+		y[numLitPointlights + i] = spotlights[i].position.y;
+		z[numLitPointlights + i] = spotlights[i].position.z;
+		radius[numLitPointlights + i] = spotlights[i].radius;
+	}
+
+	clusters.build(view, proj, settings.cameraNear, settings.cameraFar, x, y, z, radius,
+		numLitPointlights, numLitSpotlights, arena);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterCellBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_CLUSTERS * 2 * sizeof(Uint32), clusters.cells, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterIndexBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(clusters.numIndices, 1u) * sizeof(Uint32), clusters.indices, GL_STREAM_DRAW);
+}
+
+//Camera view matrix.
+Mat4 Renderer::calcCameraView(){
+	return Mat4::lookAt(uniforms.common.camPosition, uniforms.common.camPosition + camDirection, Vec3(0.0, 0.0, 1.0));
+}
+
+//Camera projection matrix for the current window size.
+Mat4 Renderer::calcCameraProj(){
 	int width, height;
 	SDL_GetWindowSize(window, &width, &height);
 
 	float aspect = (float)width/(float)height;
 	//float vFov = 2 * atan(tan(settings.cameraFov*0.5)*aspect);
 
-	uniforms.common.projView = Mat4::lookAt(
-			uniforms.common.camPosition, uniforms.common.camPosition + camDirection, Vec3(0.0, 0.0, 1.0)
-		) * Mat4::perspective(settings.cameraFov, aspect, 0.1, 100.0);
+	return Mat4::perspective(settings.cameraFov, aspect, settings.cameraNear, settings.cameraFar);
+}
+
+//Shadow projection of a sun cascade. Cascades double in size and all center on the camera.
+Mat4 Renderer::calcSunProjView(Uint32 cascade){
+	float scale = 8.0 * (1 << cascade);
+	return Mat4::lookAt(
+		Vec3::normalize(uniforms.lights.sun.direction) * 200 + (uniforms.common.camPosition),
+		(uniforms.common.camPosition), Vec3(0,0,1)) *
+		Mat4::orthographic(-scale, scale, -scale, scale, 0.01, 400.0);
+}
+
+//Shadow projection of a spotlight.
+Mat4 Renderer::calcSpotProjView(Spotlight& spot){
+	return Mat4::lookAt(
+		spot.position,
+		Vec3::normalize(spot.direction) + spot.position,
+		Vec3(0,0,1)
+	) * Mat4::perspective(acos(spot.cutOff) * 2.0, 1, 0.01, 100.0);
+}
 
-	uniforms.lights.numPointlights = (float)numPointlights;
-	uniforms.lights.numSpotlights = (float)numSpotlights;
+//Volumes a model has to touch to be seen or to cast a shadow that can be seen: the camera, the widest
+//sun cascade, which holds the others, and every spotlight queued so far. Call after pushing the frame's lights.
+void Renderer::getViewVolumes(std::vector<Frustum>& volumes){
+	volumes.clear();
+	volumes.push_back(Frustum(calcCameraView() * calcCameraProj()));
+	volumes.push_back(Frustum(calcSunProjView(NUM_SUN_CASCADES - 1)));
+	for(unsigned int i=0;i<numSpotlights;i++){
+		volumes.push_back(Frustum(calcSpotProjView(spotlights[i])));
+	}
+}
+
+//Deferred lighting pass.
+void Renderer::deferredPass(){
+	//Calculate sun shadow projections.
+	for(int i=0;i<NUM_SUN_CASCADES;i++){
+		uniforms.lights.sun.projViewCSM[i] = calcSunProjView(i);
+	}
+
+	//Set all remaining uniforms.
+	Mat4 view = calcCameraView();
+	Mat4 proj = calcCameraProj();
+	uniforms.common.projView = view * proj;
+
+	//Update camera frustum.
+	camFrustum = Frustum(uniforms.common.projView);
+
+	//Pick the lights to draw. Spotlights are capped by the shadow map layers.
+	numLitPointlights = selectLights(pointlights, numPointlights, settings.rendererMaxPointlights);
+	numLitSpotlights = selectLights(spotlights, numSpotlights, MAX_SPOTLIGHTS);
+
+	for(unsigned int i=0;i<numLitSpotlights;i++){
+		spotlights[i].projViewCSM = calcSpotProjView(spotlights[i]);
+	}
+
+	uniforms.lights.numPointlights = (float)numLitPointlights;
+	uniforms.lights.numSpotlights = (float)numLitSpotlights;
 
 	//Update uniforms.
 	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
 	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(UniformBlock), &uniforms);
 
-	//Update camera frustum.
-	frustumCorners[0] = Vec3(-1, -1, -1);
-	frustumCorners[1] = Vec3( 1, -1, -1);
-	frustumCorners[2] = Vec3( 1,  1, -1);
-	frustumCorners[3] = Vec3(-1,  1, -1);
-	frustumCorners[4] = Vec3(-1, -1,  1);
-	frustumCorners[5] = Vec3( 1, -1,  1);
-	frustumCorners[6] = Vec3( 1,  1,  1);
-	frustumCorners[7] = Vec3(-1,  1,  1);
-
-	Mat4 invProjView = uniforms.common.projView.inverse();
-	float w = 0;
-	for(unsigned int i=0;i<8;i++){
-		frustumCorners[i] = invProjView.transform(frustumCorners[i], 1.0, w);
-		frustumCorners[i] = frustumCorners[i] / w;
+	//Upload lit lights. Buffers are respecified every frame, so they are only as big as the lights drawn.
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, pointlightBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(numLitPointlights, 1u) * sizeof(Pointlight), pointlights, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, spotlightBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(numLitSpotlights, 1u) * sizeof(Spotlight), spotlights, GL_STREAM_DRAW);
+
+	buildClusters(view, proj);
+
+	//Move queued centroids to world space.
+	Mat4::transform(drawModels, drawCentroids, drawCentroids, numRequests);
+
+	//Pass scratch data for this frame.
+	Uint32 numShadowLights = NUM_SUN_CASCADES + numLitSpotlights;
+	drawKeys = (Uint64*)arena.allocate(numRequests * sizeof(Uint64));
+	sortKeys = (Uint64*)arena.allocate(numRequests * sizeof(Uint64));
+	drawOrder = (Uint32*)arena.allocate(numRequests * sizeof(Uint32));
+	shadowOrder = (Uint32*)arena.allocate(numRequests * sizeof(Uint32));
+	sortOrder = (Uint32*)arena.allocate(numRequests * sizeof(Uint32));
+	shadowVisible = (Uint32*)arena.allocate(numRequests * numShadowLights * sizeof(Uint32));
+	shadowStaticVisible = (Uint32*)arena.allocate(numRequests * numShadowLights * sizeof(Uint32));
+	drawPoses = (Uint32*)arena.allocate(numRequests * sizeof(Uint32));
+	cullX = (float*)arena.allocate(numRequests * sizeof(float));
+	cullY = (float*)arena.allocate(numRequests * sizeof(float));
+	cullZ = (float*)arena.allocate(numRequests * sizeof(float));
+	cullRadius = (float*)arena.allocate(numRequests * sizeof(float));
+	drawVisible = (Uint8*)arena.allocate(numRequests);
+
+	//Cull against the camera four spheres at a time.
+	for(unsigned int i=0;i<numRequests;i++){
+		cullX[i] = drawCentroids[i].x;
+		cullY[i] = drawCentroids[i].y;
+		cullZ[i] = drawCentroids[i].z;
+		cullRadius[i] = drawQueue[i].cullRadius;
 	}
+	camFrustum.intersect(cullX, cullY, cullZ, cullRadius, drawVisible, numRequests);
+
+	//Sort the queue so requests sharing state are adjacent.
+	sortRequests(false, drawOrder);
+	sortRequests(true, shadowOrder);
+
+	//Anything may have changed GL state since the last frame.
+	stats = RendererStats();
+	stats.shadowPassMs = shadowPassMs;
+	boundProgram = 0;
+	boundVao = 0;
+	boundTextures[0] = 0;
+	boundTextures[1] = 0;
+
+	//Find the shadow casters of each light, keeping the shadow order.
+	Uint32 numShadowCasters = cullShadowCasters(numShadowLights);
+
+	//Start evaluating every pose drawn this frame once, the G-buffer and shadow passes share the palettes.
+	evaluatePoses();
+
+	//Group requests into instanced draws, G-buffer batches first and then the batches of each light.
+	instanceModels = (Mat4*)arena.allocate((numRequests + numShadowCasters) * sizeof(Mat4));
+	instancePoses = (Uint32*)arena.allocate((numRequests + numShadowCasters) * sizeof(Uint32));
+	drawBatches = (DrawBatch*)arena.allocate((numRequests + numShadowCasters) * sizeof(DrawBatch));
+
+	Uint32 numInstances = 0;
+	Uint32 numBatches = 0;
+	batchRequests(drawOrder, numRequests, true, numInstances, numBatches);
+	Uint32 numGBatches = numBatches;
+	for(unsigned int i=0;i<numShadowLights;i++){
+		batchRequests(&shadowStaticVisible[i * numRequests], shadowStaticCount[i], false, numInstances, numBatches);
+		shadowStaticBatchEnd[i] = numBatches;
+		batchRequests(&shadowVisible[i * numRequests], shadowVisibleCount[i], false, numInstances, numBatches);
+		shadowBatchEnd[i] = numBatches;
+	}
+
+	//Stream instance matrices. Respecifying the storage keeps the last frame's draws from stalling the upload.
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(numInstances, 1u) * sizeof(Mat4), instanceModels, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, instancePoseBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(numInstances, 1u) * sizeof(Uint32), instancePoses, GL_STREAM_DRAW);
+
+	//Joint palettes are complete once the pose workers are done.
+	finishPoses();
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, jointBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(numJoints, 1u) * sizeof(Mat4), jointPalettes, GL_STREAM_DRAW);
 
 	//Draw queued models.
 	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
@@ -328,33 +928,37 @@ void Renderer::deferredPass(){
 	glClearColor(0.0, 0.0, 0.0, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
-	Mat4 joints[mostBones];
-	BoundingSphere cullSphere(Vec3(0,0,0), 1.0, 1.0);
+	stats.shadowDrawsIssued = numBatches - numGBatches;
 
-	for(int i=0;i<numRequests;i++){
-		cullSphere.center = drawQueue[i].centroid;
-		cullSphere.radius = drawQueue[i].cullRadius;
-		if(gjk(camFrustum, cullSphere)){
-			glUseProgram(drawQueue[i].gProgram);
-			glUniformMatrix4fv(0, 1, false, drawQueue[i].model.ptr());
+	for(unsigned int i=0;i<numGBatches;i++){
+		DrawRequest& request = drawQueue[drawBatches[i].request];
+		useProgram(request.gProgram);
+		glUniform1i(0, drawBatches[i].firstInstance);
 
-			glBindVertexArray(drawQueue[i].vao);
+		bindVertexArray(request.vao);
+		bindTexture(0, request.diffuse);
+		bindTexture(1, request.metalRough);
 
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D_ARRAY, drawQueue[i].diffuse);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D_ARRAY, drawQueue[i].metalRough);
-
-			if(drawQueue[i].anim != nullptr){
-				drawQueue[i].anim->calcJointTransforms(joints, drawQueue[i].animTime);
-				glUniformMatrix4fv(2, drawQueue[i].numBones, false, joints[0].ptr());
-			}
+		glDrawElementsInstanced(GL_TRIANGLES, request.numIndices, request.indexType, indexOffset(request), drawBatches[i].numInstances);
+		stats.drawCalls++;
+	}
 
-			glDrawArrays(GL_TRIANGLES, 0, drawQueue[i].numVertices);
-		}
+	//Time the shadow pass. The query from the previous frame is read if the GPU is done with it.
+	Uint32 lastQuery = shadowQueries[(frameCount + 1) % 2];
+	int available = 0;
+	if(frameCount > 0){
+		glGetQueryObjectiv(lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+	}
+	if(available){
+		Uint64 elapsed;
+		glGetQueryObjectui64v(lastQuery, GL_QUERY_RESULT, &elapsed);
+		shadowPassMs = elapsed / 1000000.0;
 	}
+	glBeginQuery(GL_TIME_ELAPSED, shadowQueries[frameCount % 2]);
+	frameCount++;
 
-	//Clear shadow maps.
+	//Draw shadow maps, one layer at a time with only the casters inside that light's volume.
+	//Dirty cache layers get their static casters first. The cached layer is then copied in and dynamic casters drawn on top.
 	glBindFramebuffer(GL_FRAMEBUFFER, shadowBuffer);
 	glViewport(0, 0, settings.shadowWidth, settings.shadowHeight);
 
@@ -362,47 +966,33 @@ void Renderer::deferredPass(){
 	glEnable(GL_CULL_FACE);
 	glCullFace(GL_FRONT);
 
-	for(int i=0;i<NUM_SUN_CASCADES + uniforms.lights.numSpotlights;i++){
-		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowImages, 0, i);
-		glClearColor(0.0, 0.0, 0.0, 1.0);
-		glClear(GL_DEPTH_BUFFER_BIT);
-	}
-
-	BoundingSphere lightSphere(Vec3(0,0,0), 1.0, 1.0);
-
-	//Draw shadow maps.
-	for(int i=0;i<numRequests;i++){
-		glUseProgram(drawQueue[i].shadowProgram);
-		glUniformMatrix4fv(0, 1, false, drawQueue[i].model.ptr());
+	Uint32 firstBatch = numGBatches;
+	for(unsigned int i=0;i<numShadowLights;i++){
+		Mat4& lightProjView = i < NUM_SUN_CASCADES ?
+			uniforms.lights.sun.projViewCSM[i] : spotlights[i - NUM_SUN_CASCADES].projViewCSM;
 
-		if(drawQueue[i].anim != nullptr){
-			drawQueue[i].anim->calcJointTransforms(joints, drawQueue[i].animTime);
-			glUniformMatrix4fv(2, drawQueue[i].numBones, false, joints[0].ptr());
+		if(shadowCacheDirty[i]){
+			bindShadowLayer(staticShadowImages, i);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			drawShadowBatches(firstBatch, shadowStaticBatchEnd[i], lightProjView);
 		}
+		firstBatch = shadowStaticBatchEnd[i];
 
-		glBindVertexArray(drawQueue[i].vao);
-
-		for(int j=0;j<NUM_SUN_CASCADES;j++){
-			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowImages, 0, j);
-			glUniformMatrix4fv(1, 1, false, uniforms.lights.sun.projViewCSM[j].ptr());
-
-			glDrawArrays(GL_TRIANGLES, 0, drawQueue[i].numVertices);
-		}
-
-		for(int j=0;j<uniforms.lights.numSpotlights;j++){
-			lightSphere.center = uniforms.lights.spotlights[j].position;
-			lightSphere.radius = uniforms.lights.spotlights[j].radius;
-			if(gjk(camFrustum, lightSphere)){
-				glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowImages, 0, j + NUM_SUN_CASCADES);
-				glUniformMatrix4fv(1, 1, false, uniforms.lights.spotlights[j].projViewCSM.ptr());
-
-				glDrawArrays(GL_TRIANGLES, 0, drawQueue[i].numVertices);
+		if(settings.shadowStaticCache){
+			glCopyImageSubData(staticShadowImages, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i,
+				shadowImages, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, settings.shadowWidth, settings.shadowHeight, 1);
+			if(firstBatch < shadowBatchEnd[i]){
+				bindShadowLayer(shadowImages, i);
 			}
+		}else{
+			bindShadowLayer(shadowImages, i);
+			glClear(GL_DEPTH_BUFFER_BIT);
 		}
+		drawShadowBatches(firstBatch, shadowBatchEnd[i], lightProjView);
+		firstBatch = shadowBatchEnd[i];
 	}
 
-	numRequests = 0;
-	mostBones = 0;
+	glEndQuery(GL_TIME_ELAPSED);
 
 	//Deferred pass.
 	glDisable(GL_DEPTH_TEST);
@@ -412,6 +1002,8 @@ void Renderer::deferredPass(){
 	glBindFramebuffer(GL_FRAMEBUFFER, displayBuffer);
 
 	deferredProgram.use();
+	glUniform3f(0, camDirection.x, camDirection.y, camDirection.z);
+	glUniform2f(1, clusters.sliceScale, clusters.sliceBias);
 	glBindVertexArray(nullVao);
 
 	glActiveTexture(GL_TEXTURE0);
@@ -425,9 +1017,9 @@ void Renderer::deferredPass(){
 
 	glDrawArrays(GL_TRIANGLES, 0, 6);
 
-	//Reset light uniforms.
-	numPointlights = 0;
-	numSpotlights = 0;
+	//Release this frame's queues and scratch data.
+	arena.reset();
+	beginFrame();
 }
 
 //Apply bloom to current image.
@@ -519,66 +1111,117 @@ void Renderer::displayFrame(){
 	SDL_GL_SwapWindow(window);
 }
 
-//Add a pointlight.
+//Print the state changes of the last frame.
+void Renderer::printStats(){
+	std::cout<<"Draw calls: "<<stats.drawCalls<<", program binds: "<<stats.programBinds<<
+		", vao binds: "<<stats.vaoBinds<<", texture binds: "<<stats.textureBinds<<
+		", shadow layer binds: "<<stats.layerBinds<<", skipped binds: "<<stats.skippedBinds<<
+		", requests culled: "<<stats.requestsCulled<<std::endl;
+	std::cout<<"Shadow draws issued: "<<stats.shadowDrawsIssued<<", skipped: "<<
+		stats.shadowDrawsUnculled - stats.shadowDrawsIssued<<", casters drawn: "<<stats.shadowCasters<<
+		", culled: "<<stats.shadowCastersCulled<<", cached: "<<stats.shadowCastersCached<<std::endl;
+	std::cout<<"Shadow pass GPU ms: "<<stats.shadowPassMs<<", static layers rebuilt: "<<stats.shadowLayersRebuilt<<
+		(settings.shadowStaticCache ? "" : " (cache off)")<<std::endl;
+	std::cout<<"Poses evaluated: "<<stats.posesEvaluated<<", shared: "<<stats.posesShared<<
+		", skinning CPU ms: "<<stats.skinningMs<<std::endl;
+}
+
+//Add a pointlight. The queue doubles when full.
 void Renderer::pushLight(Pointlight light){
-	if(uniforms.lights.numPointlights < MAX_POINTLIGHTS){
-		uniforms.lights.pointlights[numPointlights++] = light;
-	}else{
-		std::cout<<"WARNING: Pointlight capacity full. Cannot add more."<<std::endl;
+	if(numPointlights == pointlightCapacity){
+		Pointlight* old = pointlights;
+		pointlightCapacity *= 2;
+		pointlights = (Pointlight*)arena.allocate(pointlightCapacity * sizeof(Pointlight));
+		for(unsigned int i=0;i<numPointlights;i++){
+			pointlights[i] = old[i];
+		}
 	}
+	pointlights[numPointlights++] = light;
 }
 
-//Add a spotlight.
+//Add a spotlight. The queue doubles when full.
 void Renderer::pushLight(Spotlight light){
-	if(uniforms.lights.numSpotlights < MAX_SPOTLIGHTS){
-		uniforms.lights.spotlights[numSpotlights++] = light;
-	}else{
-		std::cout<<"WARNING: Spotlight capacity full. Cannot add more."<<std::endl;
+	if(numSpotlights == spotlightCapacity){
+		Spotlight* old = spotlights;
+		spotlightCapacity *= 2;
+		spotlights = (Spotlight*)arena.allocate(spotlightCapacity * sizeof(Spotlight));
+		for(unsigned int i=0;i<numSpotlights;i++){
+			spotlights[i] = old[i];
+		}
 	}
+	spotlights[numSpotlights++] = light;
 }
 
-//Add static model to the draw queue.
-void Renderer::drawModel(StaticModel* mesh, Mat4 model){
-	if(numRequests < settings.rendererDrawQueueSize){
-		DrawRequest request;
-		request.gProgram = mesh->gProgram.program;
-		request.shadowProgram = mesh->shadowProgram.program;
-		request.vao = mesh->vao;
-		request.numVertices = mesh->numVertices;
-		request.diffuse = mesh->diffuse;
-		request.metalRough = mesh->metalRough;
-		request.anim = nullptr;
-		request.numBones = 0;
-		request.animTime = 0.0;
-		request.model = model;
-		request.centroid = model * mesh->centroid;
-		request.cullRadius = mesh->cullRadius;
+//Add static model to the draw queue. Models still streaming in are skipped.
+//Static models never move and cast their shadows from the static shadow cache.
+//Every chunk of the model is queued as its own request, so they are culled one by one.
+void Renderer::drawModel(StaticModel* mesh, Mat4 model, bool isStatic){
+	if(!mesh->resident){
+		return;
+	}
+
+	DrawRequest request;
+	request.gProgram = mesh->gProgram.program;
+	request.shadowProgram = mesh->shadowProgram.program;
+	request.vao = mesh->vao;
+	request.indexType = mesh->indexType;
+	request.diffuse = mesh->diffuse;
+	request.metalRough = mesh->metalRough;
+	request.anim = nullptr;
+	request.numBones = 0;
+	request.animTime = 0.0;
+	request.isStatic = isStatic;
+
+	for(unsigned int i=0;i<mesh->numChunks;i++){
+		if(numRequests == requestCapacity){
+			growDrawQueue();
+		}
+
+		ModelChunk& chunk = mesh->chunks[i];
+		request.firstIndex = chunk.firstIndex;
+		request.numIndices = chunk.numIndices;
+		request.cullRadius = chunk.cullRadius;
 
+		drawModels[numRequests] = model;
+		drawCentroids[numRequests] = Vec3(chunk.centroid[0], chunk.centroid[1], chunk.centroid[2]);
 		drawQueue[numRequests++] = request;
 	}
 }
 
 //Add static model to the draw queue.
 void Renderer::drawModel(AnimatedModel* mesh, Mat4 model, Animation* anim, float animTime){
-	if(numRequests < settings.rendererDrawQueueSize){
-		DrawRequest request;
-		request.gProgram = mesh->gProgram.program;
-		request.shadowProgram = mesh->shadowProgram.program;
-		request.vao = mesh->vao;
-		request.numVertices = mesh->numVertices;
-		request.diffuse = mesh->diffuse;
-		request.metalRough = mesh->metalRough;
-		request.anim = anim;
-		request.numBones = mesh->numBones;
-		request.animTime = animTime;
-		request.model = model;
-		request.centroid = model * mesh->centroid;
-		request.cullRadius = mesh->cullRadius;
+	if(!mesh->resident || (anim != nullptr && !anim->resident)){
+		return;
+	}
+	if(numRequests == requestCapacity){
+		growDrawQueue();
+	}
 
-		drawQueue[numRequests++] = request;
+	DrawRequest request;
+	request.gProgram = mesh->gProgram.program;
+	request.shadowProgram = mesh->shadowProgram.program;
+	request.vao = mesh->vao;
+	request.numIndices = mesh->numIndices;
+	request.indexType = mesh->indexType;
+	request.diffuse = mesh->diffuse;
+	request.metalRough = mesh->metalRough;
+	request.anim = anim;
+	request.numBones = mesh->numBones;
+	request.animTime = animTime;
+	request.cullRadius = mesh->cullRadius;
+
+	drawModels[numRequests] = model;
+	drawCentroids[numRequests] = mesh->centroid;
+	drawQueue[numRequests++] = request;
+}
 
-		mostBones = std::max(mostBones, request.numBones);
+//Add animated model posed by a player. The player must not be updated until the frame is rendered.
+void Renderer::drawModel(AnimatedModel* mesh, Mat4 model, AnimationPlayer* player){
+	if(!mesh->resident){
+		return;
 	}
+	drawModel(mesh, model, nullptr, 0.0);
+	drawQueue[numRequests - 1].player = player;
 }
 
 //Set camera heading.
@@ -621,3 +1264,8 @@ Vec3 Renderer::getCameraRight(){
 Vec3 Renderer::getCameraFront(){
 	return Vec3::normalize(Vec3(camDirection.x, camDirection.y, 0.0));
 }
+
+//Get the worker pool, for frame work outside the renderer. Its jobs must be finished before drawing.
+JobPool* Renderer::getJobPool(){
+	return &jobs;
+}
@@ -7,9 +7,19 @@
 #include "shader.hpp"
 #include "models.hpp"
 #include "3Dphysics.hpp"
+#include "system.hpp"
+#include "clusters.hpp"
+#include "jobs.hpp"
 
 #define UBO_BINDING 0
 
+//Draw sort key layout, most significant field first. GL names are truncated to 16 bits,
+//a collision only costs a bind, batching still compares the full state.
+#define SORT_KEY_PROGRAM_SHIFT 48
+#define SORT_KEY_VAO_SHIFT 32
+#define SORT_KEY_MATERIAL_SHIFT 16
+#define SORT_KEY_DEPTH_BUCKETS 0xFFFF
+
 //Sun data.
 struct Sun{
 	Vec3 direction;
@@ -47,15 +57,13 @@ struct CommonUniforms{
 	float time = 0.0;
 };
 
-//Light uniforms.
+//Light uniforms. Pointlights and spotlights themselves live in SSBOs.
 struct LightUniforms{
 	Sun sun;
 	float numPointlights = 0.0;
 	float numSpotlights = 0.0;
 	float gamma = 1.0;
 	float exposure = 1.1;
-	Pointlight pointlights[MAX_POINTLIGHTS];	
-	Spotlight spotlights[MAX_SPOTLIGHTS];	
 };
 
 //Block of common uniform data.
@@ -69,15 +77,63 @@ struct DrawRequest{
 	Uint32 gProgram = 0;
 	Uint32 shadowProgram = 0;
 	Uint32 vao = 0;	
-	Uint32 numVertices = 0;
+	Uint32 firstIndex = 0;		//Index range drawn, a chunk of the model or all of it.
+	Uint32 numIndices = 0;
+	Uint32 indexType = 0;		//GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
 	Uint32 diffuse = 0;
 	Uint32 metalRough = 0;
 	Animation* anim = nullptr;
+	AnimationPlayer* player = nullptr;	//Blended pose, set instead of anim.
 	Uint32 numBones = 0;
 	float animTime = 0.0;
-	Mat4 model;
-	Vec3 centroid;
 	float cullRadius = 1.0;
+	bool isStatic = false;		//Never moves, shadows come from the static shadow cache.
+};
+
+//State changes issued by the model passes of the last frame.
+struct RendererStats{
+	Uint32 drawCalls = 0;
+	Uint32 programBinds = 0;
+	Uint32 vaoBinds = 0;
+	Uint32 textureBinds = 0;
+	Uint32 layerBinds = 0;		//Shadow map layer attachments.
+	Uint32 skippedBinds = 0;	//Binds left out because the state was already set.
+	Uint32 requestsCulled = 0;	//Queued requests or model chunks outside the camera frustum.
+
+	Uint32 shadowDrawsIssued = 0;	//Instanced shadow draws over all shadow layers.
+	Uint32 shadowDrawsUnculled = 0;	//Shadow draws needed without per light culling.
+	Uint32 shadowCasters = 0;		//Request and shadow layer pairs drawn.
+	Uint32 shadowCastersCulled = 0;	//Request and shadow layer pairs skipped.
+	Uint32 shadowCastersCached = 0;	//Static request and shadow layer pairs taken from the cache.
+	Uint32 shadowLayersRebuilt = 0;	//Static shadow layers rendered again.
+	float shadowPassMs = 0.0;		//GPU time of the shadow pass, a frame or two old.
+
+	Uint32 posesEvaluated = 0;		//Distinct animation poses evaluated.
+	Uint32 posesShared = 0;			//Drawn animated requests that reused another request's pose.
+	float skinningMs = 0.0;			//Render thread time in the pose stage, including waiting for pose workers.
+};
+
+//Static shadow layer kept between frames.
+struct ShadowCacheEntry{
+	Mat4 projView;			//Light volume the layer was rendered with.
+	Uint64 signature = 0;	//Hash of the static casters drawn into it.
+	bool valid = false;
+};
+
+//Poses for the pose workers to evaluate. Pose i is the one of request requests[i].
+struct PoseJobData{
+	DrawRequest* queue;
+	Uint32* requests;
+	Uint32* offsets;		//First joint of each request's palette.
+	Mat4* palettes;
+};
+
+//Queued requests sharing vao, programs and material. Drawn with one instanced call per pass.
+//Animated instances may differ in pose, each reads its own joint palette.
+struct DrawBatch{
+	Uint32 request = 0;			//Request the batch state is taken from.
+	Uint32 firstInstance = 0;	//First model matrix in the instance buffer.
+	Uint32 numInstances = 0;
 };
 
 //Settings for the renderer.
@@ -98,11 +154,18 @@ struct RendererSettings{
 
 	Uint32 shadowWidth = 1024;
 	Uint32 shadowHeight = 1024;
+	bool shadowStaticCache = true;	//Keep static casters in cached shadow layers.
 
-	Uint32 rendererDrawQueueSize = 128;
+	Uint32 rendererDrawQueueSize = 128;			//Initial capacity, the queue grows as needed.
+	Uint32 rendererLightQueueSize = 64;			//Initial capacity of both light queues.
+	Uint32 rendererMaxPointlights = MAX_POINTLIGHTS;	//Most pointlights lit per frame, at most 65535.
+	Uint32 rendererFrameArenaSize = 256 * 1024;	//Initial frame arena size in bytes.
+	Uint32 rendererPoseWorkers = JOB_MAX_WORKERS;	//Threads evaluating poses with the render thread, at most one per spare core.
 
 	float cameraSensitivity = 0.002;
 	float cameraFov = 1.7;
+	float cameraNear = 0.1;
+	float cameraFar = 100.0;
 };
 
 //Renderer.
@@ -117,21 +180,27 @@ struct Renderer{
 	void deferredPass();
 	void applyBloom(Uint32 blurPasses);
 	void displayFrame();
+	void printStats();
+	void invalidateShadowCache();
 
 	void pushLight(Pointlight light);
 	void pushLight(Spotlight light);
 
-	void drawModel(StaticModel* mesh, Mat4 model);
+	void drawModel(StaticModel* mesh, Mat4 model, bool isStatic = false);
 	void drawModel(AnimatedModel* mesh, Mat4 model, Animation* anim, float animTime);
+	void drawModel(AnimatedModel* mesh, Mat4 model, AnimationPlayer* player);
 
 	void setCameraView(float yaw, float pitch);
 	void updateCameraView(float Xrelative, float Yrelative);
 	Vec3 getCameraDirection();
 	Vec3 getCameraRight();
 	Vec3 getCameraFront();
+	void getViewVolumes(std::vector<Frustum>& volumes);
+	JobPool* getJobPool();
 
 	UniformBlock uniforms;
 	RendererSettings settings;
+	RendererStats stats;
 
 	private:
 	SDL_Window* window;			//SDL Window.
@@ -146,16 +215,89 @@ struct Renderer{
 	Shader deferredProgram, displayProgram, moveProgram, combineProgram, kernelProgram, blurProgram;
 
 	Uint32 ubo;
-	Uint32 numPointlights;
-	Uint32 numSpotlights;
+	Uint32 pointlightBuffer, spotlightBuffer;	//Light SSBOs.
+
+	FrameArena arena;				//Per frame storage for queues and pass scratch data.
+	void beginFrame();
+
+	Uint32 numPointlights, pointlightCapacity;
+	Uint32 numSpotlights, spotlightCapacity;
+	Pointlight* pointlights = nullptr;	//Queued pointlights, lit ones first after selectLights.
+	Spotlight* spotlights = nullptr;	//Queued spotlights, lit ones first after selectLights.
+	Uint32 numLitPointlights, numLitSpotlights;
+
+	LightClusters clusters;
+	Uint32 clusterCellBuffer, clusterIndexBuffer;	//Cluster SSBOs.
+	void buildClusters(Mat4 view, Mat4 proj);
+
+	Mat4 calcCameraView();
+	Mat4 calcCameraProj();
+	Mat4 calcSunProjView(Uint32 cascade);
+	Mat4 calcSpotProjView(Spotlight& spot);
+
+	float lightPriority(Vec3 position, float radius, Vec3 diffuse);
+	template<typename T> Uint32 selectLights(T* lights, Uint32 numLights, Uint32 maxLights);
 
 	Uint32 shadowBuffer, shadowImages;
+	Uint32 staticShadowImages;		//Cached static casters of each shadow layer.
+	ShadowCacheEntry shadowCache[NUM_SUN_CASCADES + MAX_SPOTLIGHTS];
+	bool shadowCacheDirty[NUM_SUN_CASCADES + MAX_SPOTLIGHTS];	//Static layers to render this frame.
+
+	Uint32 shadowQueries[2];		//Shadow pass timer queries, alternating between frames.
+	Uint32 frameCount = 0;
+	float shadowPassMs = 0.0;
 
-	Uint32 numRequests, mostBones;
+	Uint32 numRequests, requestCapacity;
+	void growDrawQueue();
 	DrawRequest* drawQueue = nullptr;
+	Mat4* drawModels = nullptr;		//Model matrices of queued requests.
+	Vec3* drawCentroids = nullptr;	//Centroids of queued requests, model space until deferredPass.
+	Uint64* drawKeys = nullptr;		//Sort keys of queued requests.
+	Uint64* sortKeys = nullptr;		//Scratch keys for the radix sort.
+	Uint32* drawOrder = nullptr;	//Queue indices in G-buffer order: state, then front to back.
+	Uint32* shadowOrder = nullptr;	//Queue indices in shadow pass order.
+	Uint32* sortOrder = nullptr;	//Scratch indices for the radix sort.
+	Uint32* drawPoses = nullptr;	//First joint of the palette of each queued animated request.
+	float* cullX = nullptr;			//World space bounding spheres of queued requests, split per component
+	float* cullY = nullptr;			//for the batched frustum tests.
+	float* cullZ = nullptr;
+	float* cullRadius = nullptr;
+	Uint8* drawVisible = nullptr;	//Camera frustum test of each queued request.
+
+	Uint32* shadowVisible = nullptr;	//Dynamic casters of each shadow layer, numRequests apart, in shadow order.
+	Uint32* shadowStaticVisible = nullptr;	//Static casters to render into dirty cache layers, laid out the same.
+	Uint32 shadowVisibleCount[NUM_SUN_CASCADES + MAX_SPOTLIGHTS];
+	Uint32 shadowStaticCount[NUM_SUN_CASCADES + MAX_SPOTLIGHTS];
+	Uint32 shadowStaticBatchEnd[NUM_SUN_CASCADES + MAX_SPOTLIGHTS];	//End of each layer's static batches.
+	Uint32 shadowBatchEnd[NUM_SUN_CASCADES + MAX_SPOTLIGHTS];	//End of each layer's dynamic batches.
+
+	Uint32 instanceBuffer;			//SSBO streaming model matrices of instanced draws.
+	Mat4* instanceModels = nullptr;	//Staging for the instance buffer, G-buffer instances then shadow instances.
+	Uint32 instancePoseBuffer;		//SSBO streaming the first joint of each instance's palette.
+	Uint32* instancePoses = nullptr;//Staging for the instance pose buffer, laid out like instanceModels.
+	Uint32 jointBuffer;				//SSBO streaming the joint palettes of the frame's poses.
+	Mat4* jointPalettes = nullptr;	//Staging for the joint buffer.
+	Uint32 numJoints = 0;
+	DrawBatch* drawBatches = nullptr;	//G-buffer batches followed by shadow batches.
+
+	void sortRequests(bool shadow, Uint32* order);
+	void batchRequests(Uint32* order, Uint32 count, bool cull, Uint32& numInstances, Uint32& numBatches);
+	Uint32 cullShadowCasters(Uint32 numShadowLights);
+	void drawShadowBatches(Uint32 firstBatch, Uint32 endBatch, Mat4& lightProjView);
+	void evaluatePoses();
+	void finishPoses();
+
+	JobPool jobs;					//Workers evaluating poses while the render thread batches.
+	JobCounter poseCounter;
+	PoseJobData poseJobs;
+
+	Uint32 boundProgram, boundVao, boundTextures[2];	//State cache for the model passes.
+	void useProgram(Uint32 program);
+	void bindVertexArray(Uint32 vao);
+	void bindTexture(Uint32 unit, Uint32 texture);
+	void bindShadowLayer(Uint32 texture, Uint32 layer);
 
 	float pitch, yaw;
 	Vec3 camDirection;
-	Vec3 frustumCorners[8];
-	BoundingConvex camFrustum;
+	Frustum camFrustum;
 };
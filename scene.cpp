@@ -0,0 +1,326 @@
+#include "scene.hpp"
+
+//Squared distance from a point to the loose bounds of a node.
+static float nodeDistance2(SceneNode& node, Vec3 point){
+	float loose = node.halfSize * 2.0;
+	Vec3 outside = Vec3::max((point - node.center).abs() - Vec3(loose, loose, loose), Vec3(0, 0, 0));
+	return Vec3::dot(outside, outside);
+}
+
+//Loose bounds of a node.
+static AABB nodeBox(SceneNode& node){
+	float loose = node.halfSize * 2.0;
+	return AABB(node.center - Vec3(loose, loose, loose), node.center + Vec3(loose, loose, loose));
+}
+
+//Create a tree covering the cube at center with the given half size. Objects outside it are kept
+//in the root and tested one by one.
+void SceneTree::init(Vec3 center, float halfSize, Uint32 maxDepth){
+	this->maxDepth = std::min(maxDepth, (Uint32)SCENE_MAX_DEPTH);
+
+	SceneNode root;
+	root.center = center;
+	root.halfSize = halfSize;
+	for(unsigned int i=0;i<8;i++){
+		root.children[i] = SCENE_NONE;
+	}
+	nodes.clear();
+	nodes.push_back(root);
+
+	objects.clear();
+	freeHandles.clear();
+	waiting.clear();
+}
+
+//Add a static model. Static objects are meant to stay where they are inserted.
+Uint32 SceneTree::insert(StaticModel* mesh, Mat4 model, bool isStatic){
+	SceneObject object;
+	object.staticModel = mesh;
+	object.model = model;
+	object.isStatic = isStatic;
+	return add(object);
+}
+
+//Add an animated model.
+Uint32 SceneTree::insert(AnimatedModel* mesh, Mat4 model, Animation* anim, float animTime){
+	SceneObject object;
+	object.animatedModel = mesh;
+	object.anim = anim;
+	object.animTime = animTime;
+	object.model = model;
+	return add(object);
+}
+
+//Add an animated model posed by a player.
+Uint32 SceneTree::insert(AnimatedModel* mesh, Mat4 model, AnimationPlayer* player){
+	SceneObject object;
+	object.animatedModel = mesh;
+	object.player = player;
+	object.model = model;
+	return add(object);
+}
+
+//Take a handle for an object and place it, or park it until its model is resident.
+Uint32 SceneTree::add(SceneObject& object){
+	Uint32 handle;
+	if(freeHandles.size() > 0){
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		objects[handle] = object;
+	}else{
+		handle = objects.size();
+		objects.push_back(object);
+	}
+	objects[handle].alive = true;
+
+	if(bounds(objects[handle])){
+		link(handle, findNode(objects[handle].center, objects[handle].radius));
+	}else{
+		objects[handle].slot = waiting.size();
+		waiting.push_back(handle);
+	}
+	return handle;
+}
+
+//Remove an object. Its handle may be given out again.
+void SceneTree::remove(Uint32 handle){
+	SceneObject& object = objects[handle];
+	if(object.node != SCENE_NONE){
+		unlink(handle);
+	}else{
+		objects[waiting.back()].slot = object.slot;
+		waiting[object.slot] = waiting.back();
+		waiting.pop_back();
+	}
+	object.alive = false;
+	freeHandles.push_back(handle);
+}
+
+//Change an object's transform. Only relinks it when it leaves its cell or no longer fits there.
+void SceneTree::move(Uint32 handle, Mat4 model){
+	SceneObject& object = objects[handle];
+	object.model = model;
+	if(object.node == SCENE_NONE){
+		return;
+	}
+
+	bounds(object);
+	Uint32 node = findNode(object.center, object.radius);
+	if(node != object.node){
+		unlink(handle);
+		link(handle, node);
+	}
+}
+
+//Change the pose time of an animated object.
+void SceneTree::setAnimTime(Uint32 handle, float animTime){
+	objects[handle].animTime = animTime;
+}
+
+//Object of a handle.
+SceneObject& SceneTree::get(Uint32 handle){
+	return objects[handle];
+}
+
+//Handles of objects touching a frustum.
+void SceneTree::query(Frustum& frustum, std::vector<Uint32>& result){
+	place();
+	nodesVisited = 0;
+	objectsTested = 0;
+	collect(frustum, ++queryMark, result);
+}
+
+//Handles of objects touching a sphere, such as a pointlight's reach.
+void SceneTree::query(Vec3 center, float radius, std::vector<Uint32>& result){
+	place();
+	nodesVisited = 0;
+	objectsTested = 0;
+	Uint32 mark = ++queryMark;
+
+	Uint32 stack[SCENE_MAX_DEPTH * 7 + 1];
+	Uint32 numStack = 0;
+	stack[numStack++] = 0;
+	while(numStack > 0){
+		SceneNode& node = nodes[stack[--numStack]];
+		nodesVisited++;
+
+		for(unsigned int i=0;i<node.objects.size();i++){
+			SceneObject& object = objects[node.objects[i]];
+			Vec3 offset = object.center - center;
+			float reach = object.radius + radius;
+			objectsTested++;
+			if(object.mark != mark && Vec3::dot(offset, offset) <= reach * reach){
+				object.mark = mark;
+				result.push_back(node.objects[i]);
+			}
+		}
+
+		for(unsigned int i=0;i<8;i++){
+			Uint32 child = node.children[i];
+			if(child != SCENE_NONE && nodeDistance2(nodes[child], center) <= radius * radius){
+				stack[numStack++] = child;
+			}
+		}
+	}
+}
+
+//Queue every object that can be seen or can cast a visible shadow this frame. Call after pushing the frame's lights.
+void SceneTree::draw(Renderer* renderer){
+	place();
+	nodesVisited = 0;
+	objectsTested = 0;
+
+	//One mark for all volumes, so objects in several of them are drawn once.
+	Uint32 mark = ++queryMark;
+	renderer->getViewVolumes(volumes);
+	visible.clear();
+	for(unsigned int i=0;i<volumes.size();i++){
+		collect(volumes[i], mark, visible);
+	}
+
+	for(unsigned int i=0;i<visible.size();i++){
+		SceneObject& object = objects[visible[i]];
+		if(object.staticModel != nullptr){
+			renderer->drawModel(object.staticModel, object.model, object.isStatic);
+		}else if(object.player != nullptr){
+			renderer->drawModel(object.animatedModel, object.model, object.player);
+		}else{
+			renderer->drawModel(object.animatedModel, object.model, object.anim, object.animTime);
+		}
+	}
+}
+
+//Append objects touching a frustum that do not carry the mark yet, and mark them.
+//Subtrees whose loose bounds lie inside the frustum are taken whole without testing.
+void SceneTree::collect(Frustum& frustum, Uint32 mark, std::vector<Uint32>& result){
+	Uint32 stack[SCENE_MAX_DEPTH * 7 + 1];
+	bool inside[SCENE_MAX_DEPTH * 7 + 1];
+	Uint32 numStack = 0;
+	stack[numStack] = 0;
+	inside[numStack++] = false;
+	while(numStack > 0){
+		numStack--;
+		SceneNode& node = nodes[stack[numStack]];
+		bool nodeInside = inside[numStack];
+		nodesVisited++;
+
+		for(unsigned int i=0;i<node.objects.size();i++){
+			SceneObject& object = objects[node.objects[i]];
+			if(object.mark == mark){
+				continue;
+			}
+			if(!nodeInside){
+				objectsTested++;
+				if(!frustum.intersect(object.center, object.radius)){
+					continue;
+				}
+			}
+			object.mark = mark;
+			result.push_back(node.objects[i]);
+		}
+
+		for(unsigned int i=0;i<8;i++){
+			Uint32 child = node.children[i];
+			if(child == SCENE_NONE){
+				continue;
+			}
+			if(nodeInside){
+				stack[numStack] = child;
+				inside[numStack++] = true;
+				continue;
+			}
+			AABB box = nodeBox(nodes[child]);
+			if(frustum.intersect(box)){
+				stack[numStack] = child;
+				inside[numStack++] = frustum.contains(box);
+			}
+		}
+	}
+}
+
+//Place waiting objects whose models have become resident.
+void SceneTree::place(){
+	for(unsigned int i=0;i<waiting.size();){
+		Uint32 handle = waiting[i];
+		if(!bounds(objects[handle])){
+			i++;
+			continue;
+		}
+
+		objects[waiting.back()].slot = i;
+		waiting[i] = waiting.back();
+		waiting.pop_back();
+		link(handle, findNode(objects[handle].center, objects[handle].radius));
+	}
+}
+
+//Update the world space bounding sphere of an object, the same one the renderer culls with.
+//False while the model is not resident and has no bounds yet.
+bool SceneTree::bounds(SceneObject& object){
+	Vec3 centroid;
+	if(object.staticModel != nullptr){
+		if(!object.staticModel->resident){return false;}
+		centroid = object.staticModel->centroid;
+		object.radius = object.staticModel->cullRadius;
+	}else{
+		if(!object.animatedModel->resident){return false;}
+		centroid = object.animatedModel->centroid;
+		object.radius = object.animatedModel->cullRadius;
+	}
+	Mat4::transform(&object.model, &centroid, &object.center, 1);
+	return true;
+}
+
+//Deepest node whose cell holds the center and whose loose bounds hold the sphere, creating nodes on the way.
+//A loose cell holds any sphere centered in it that is at most as big as the cell's half size.
+Uint32 SceneTree::findNode(Vec3 center, float radius){
+	Uint32 index = 0;
+	SceneNode& root = nodes[0];
+	if(fabs(center.x - root.center.x) > root.halfSize ||
+		fabs(center.y - root.center.y) > root.halfSize ||
+		fabs(center.z - root.center.z) > root.halfSize){
+		return 0;
+	}
+
+	for(unsigned int depth=0;depth<maxDepth;depth++){
+		float childHalf = nodes[index].halfSize * 0.5;
+		if(radius > childHalf){
+			break;
+		}
+
+		Vec3 parentCenter = nodes[index].center;
+		Uint32 octant = (center.x >= parentCenter.x ? 1 : 0) | (center.y >= parentCenter.y ? 2 : 0) | (center.z >= parentCenter.z ? 4 : 0);
+		if(nodes[index].children[octant] == SCENE_NONE){
+			SceneNode child;
+			child.center = Vec3(
+				parentCenter.x + (octant & 1 ? childHalf : -childHalf),
+				parentCenter.y + (octant & 2 ? childHalf : -childHalf),
+				parentCenter.z + (octant & 4 ? childHalf : -childHalf));
+			child.halfSize = childHalf;
+			for(unsigned int i=0;i<8;i++){
+				child.children[i] = SCENE_NONE;
+			}
+			nodes[index].children[octant] = nodes.size();
+			nodes.push_back(child);
+		}
+		index = nodes[index].children[octant];
+	}
+	return index;
+}
+
+//Add an object to a node's list.
+void SceneTree::link(Uint32 handle, Uint32 node){
+	objects[handle].node = node;
+	objects[handle].slot = nodes[node].objects.size();
+	nodes[node].objects.push_back(handle);
+}
+
+//Take an object out of its node's list.
+void SceneTree::unlink(Uint32 handle){
+	SceneObject& object = objects[handle];
+	std::vector<Uint32>& list = nodes[object.node].objects;
+	objects[list.back()].slot = object.slot;
+	list[object.slot] = list.back();
+	list.pop_back();
+	object.node = SCENE_NONE;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "renderer.hpp"
+
+#include <vector>
+
+#define SCENE_MAX_DEPTH 8			//Deepest tree init accepts, sizes the traversal stacks.
+#define SCENE_DEFAULT_DEPTH 5
+#define SCENE_NONE 0xFFFFFFFF
+
+//Model placed in a scene. Either the static or the animated model is set.
+struct SceneObject{
+	StaticModel* staticModel = nullptr;
+	AnimatedModel* animatedModel = nullptr;
+	Animation* anim = nullptr;
+	AnimationPlayer* player = nullptr;	//Poses the animated model instead of anim when set.
+	float animTime = 0.0;
+	Mat4 model;
+	bool isStatic = false;
+
+	Vec3 center;				//World space bounding sphere, set once the model is resident.
+	float radius = 0.0;
+	Uint32 node = SCENE_NONE;	//Node holding the object, SCENE_NONE while waiting for its model.
+	Uint32 slot = 0;			//Position in the node's object list, or in the waiting list.
+	Uint32 mark = 0;			//Last query that returned the object.
+	bool alive = false;
+};
+
+//Cell of the loose octree. Its loose bounds reach half a cell past every side.
+struct SceneNode{
+	Vec3 center;
+	float halfSize;
+	Uint32 children[8];			//SCENE_NONE where no child was needed yet.
+	std::vector<Uint32> objects;
+};
+
+//Loose octree of renderable objects. Objects sit in the deepest cell that holds their center and whose
+//loose bounds hold their bounding sphere, so moving one only relinks it when it leaves that cell.
+//Static objects are inserted once, dynamic ones are moved when they change. Queries skip whole subtrees
+//outside the volume and return object handles.
+struct SceneTree{
+	SceneTree(){};
+	void init(Vec3 center, float halfSize, Uint32 maxDepth = SCENE_DEFAULT_DEPTH);
+	~SceneTree(){};
+
+	Uint32 insert(StaticModel* mesh, Mat4 model, bool isStatic = false);
+	Uint32 insert(AnimatedModel* mesh, Mat4 model, Animation* anim, float animTime = 0.0);
+	Uint32 insert(AnimatedModel* mesh, Mat4 model, AnimationPlayer* player);
+	void remove(Uint32 handle);
+	void move(Uint32 handle, Mat4 model);
+	void setAnimTime(Uint32 handle, float animTime);
+
+	void query(Frustum& frustum, std::vector<Uint32>& result);
+	void query(Vec3 center, float radius, std::vector<Uint32>& result);
+	void draw(Renderer* renderer);
+
+	SceneObject& get(Uint32 handle);
+	Uint32 nodesVisited = 0;	//Nodes entered by the last query or draw.
+	Uint32 objectsTested = 0;	//Bounding spheres tested by the last query or draw.
+
+	private:
+	Uint32 add(SceneObject& object);
+	void place();
+	bool bounds(SceneObject& object);
+	Uint32 findNode(Vec3 center, float radius);
+	void link(Uint32 handle, Uint32 node);
+	void unlink(Uint32 handle);
+	void collect(Frustum& frustum, Uint32 mark, std::vector<Uint32>& result);
+
+	std::vector<SceneNode> nodes;
+	std::vector<SceneObject> objects;
+	std::vector<Uint32> freeHandles;
+	std::vector<Uint32> waiting;	//Objects whose model is still streaming in.
+	std::vector<Uint32> visible;	//Scratch list for draw.
+	std::vector<Frustum> volumes;	//Scratch list for draw.
+	Uint32 maxDepth;
+	Uint32 queryMark = 0;
+};
@@ -164,8 +164,6 @@ std::string glsl_commonUniforms(){
 
 			Sun sun;
 			vec4 NLightsGamExp;
-			Pointlight pointlights[MAX_POINTLIGHTS];
-			Spotlight spotlights[MAX_SPOTLIGHTS];
 		};
 
 		#define PI 3.14159265358979323846264
@@ -199,15 +197,130 @@ std::string glsl_commonUniforms(){
 		std::string("UBO_BINDING").length(),
 		std::to_string(UBO_COMMON_BASE)
 	);
+	return str;
+}
+
+//------------------------------------------------------------------------------------------
+
+//Lit pointlights and spotlights in ssbos, counts are in NLightsGamExp.
+std::string glsl_lightBuffers(){
+	std::string str = R"(
+		layout(std430, binding = POINTLIGHT_BINDING) readonly buffer P{
+			Pointlight pointlights[];
+		};
+
+		layout(std430, binding = SPOTLIGHT_BINDING) readonly buffer S{
+			Spotlight spotlights[];
+		};
+	)";
 	str.replace(
-		str.find("MAX_POINTLIGHTS"),
-		std::string("MAX_POINTLIGHTS").length(),
-		std::to_string(MAX_POINTLIGHTS)
+		str.find("POINTLIGHT_BINDING"),
+		std::string("POINTLIGHT_BINDING").length(),
+		std::to_string(SSBO_POINTLIGHT_BASE)
 	);
 	str.replace(
-		str.find("MAX_SPOTLIGHTS"),
-		std::string("MAX_SPOTLIGHTS").length(),
-		std::to_string(MAX_SPOTLIGHTS)
+		str.find("SPOTLIGHT_BINDING"),
+		std::string("SPOTLIGHT_BINDING").length(),
+		std::to_string(SSBO_SPOTLIGHT_BASE)
+	);
+	return str;
+}
+
+//------------------------------------------------------------------------------------------
+
+//Clustered light lists. Cells hold the first index and the pointlight | spotlight << 16 counts of a cluster.
+std::string glsl_lightClusters(){
+	std::string str = R"(
+		#define TILES_X NUM_TILES_X
+		#define TILES_Y NUM_TILES_Y
+		#define SLICES NUM_SLICES
+
+		layout(std430, binding = CELL_BINDING) readonly buffer C{
+			uvec2 clusterCells[];
+		};
+
+		layout(std430, binding = INDEX_BINDING) readonly buffer L{
+			uint clusterIndices[];
+		};
+
+		layout(location = 0) uniform vec3 u_viewDirection;
+		layout(location = 1) uniform vec2 u_clusterSlices;	//Depth slice = log(depth) * x + y.
+
+		uvec2 findCluster(vec2 uv, vec3 position){
+			float depth = max(dot(position - posTime.rgb, u_viewDirection), 0.0001);
+			int x = clamp(int(uv.x * TILES_X), 0, TILES_X - 1);
+			int y = clamp(int(uv.y * TILES_Y), 0, TILES_Y - 1);
+			int z = clamp(int(floor(log(depth) * u_clusterSlices.x + u_clusterSlices.y)), 0, SLICES - 1);
+			return clusterCells[(z * TILES_Y + y) * TILES_X + x];
+		}
+	)";
+	str.replace(
+		str.find("CELL_BINDING"),
+		std::string("CELL_BINDING").length(),
+		std::to_string(SSBO_CLUSTER_CELL_BASE)
+	);
+	str.replace(
+		str.find("INDEX_BINDING"),
+		std::string("INDEX_BINDING").length(),
+		std::to_string(SSBO_CLUSTER_INDEX_BASE)
+	);
+	str.replace(
+		str.find("NUM_TILES_X"),
+		std::string("NUM_TILES_X").length(),
+		std::to_string(CLUSTER_TILES_X)
+	);
+	str.replace(
+		str.find("NUM_TILES_Y"),
+		std::string("NUM_TILES_Y").length(),
+		std::to_string(CLUSTER_TILES_Y)
+	);
+	str.replace(
+		str.find("NUM_SLICES"),
+		std::string("NUM_SLICES").length(),
+		std::to_string(CLUSTER_SLICES)
+	);
+	return str;
+}
+
+//------------------------------------------------------------------------------------------
+
+//Model matrices of instanced draws in an ssbo. Instance i of a draw uses instanceModels[u_firstInstance + i].
+std::string glsl_instanceModels(){
+	std::string str = R"(
+		layout(std430, binding = INSTANCE_BINDING) readonly buffer I{
+			mat4 instanceModels[];
+		};
+
+		layout(location = 0) uniform int u_firstInstance;
+	)";
+	str.replace(
+		str.find("INSTANCE_BINDING"),
+		std::string("INSTANCE_BINDING").length(),
+		std::to_string(SSBO_INSTANCE_BASE)
+	);
+	return str;
+}
+
+//Joint palettes of the frame's poses in an ssbo, and the first joint of each instance's pose in another.
+std::string glsl_instanceJoints(){
+	std::string str = R"(
+		layout(std430, binding = JOINT_BINDING) readonly buffer J{
+			mat4 joints[];
+		};
+
+		layout(std430, binding = POSE_BINDING) readonly buffer P{
+			uint instancePoses[];
+		};
+	)";
+	str.replace(
+		str.find("JOINT_BINDING"),
+		std::string("JOINT_BINDING").length(),
+		std::to_string(SSBO_JOINT_BASE)
+	);
+	str.replace(
+		str.find("POSE_BINDING"),
+		std::string("POSE_BINDING").length(),
+		std::to_string(SSBO_INSTANCE_POSE_BASE)
 	);
 	return str;
 }
@@ -250,12 +363,13 @@ std::string glsl_commonLightStructs(){
 */
 //------------------------------------------------------------------------------------------------------
 
-//Vertex shader program for static models.
-std::string glsl_deferredStaticModelVertex(){
+//Vertex shader program for static models. Vertices are packed, UVs are fractions of uvScale and
+//the texture layer rides in the fourth normal component.
+std::string glsl_deferredStaticModelVertex(float uvScale){
 	std::string str = R"(
 		layout(location = 0) in vec3 POSITION;
-		layout(location = 1) in vec3 UV_COORD;
-		layout(location = 2) in vec3 NORMAL;
+		layout(location = 1) in vec2 UV;
+		layout(location = 2) in vec4 NORMAL;
 
 		out VS_OUT{
 			vec4 position;
@@ -263,18 +377,22 @@ std::string glsl_deferredStaticModelVertex(){
 			vec3 normal;
 		} F;
 
-		layout(location = 0) uniform mat4 u_model;
-
 		void main(){
+			mat4 u_model = instanceModels[u_firstInstance + gl_InstanceID];
 			vec4 transform = u_model * vec4(POSITION, 1.0);
 			vec4 result = projView * transform;
 			gl_Position = result;
 
 			F.position = vec4(transform.rgb/transform.a, result.z);
-			F.uv_coord = UV_COORD;
+			F.uv_coord = vec3(UV * UV_SCALE, NORMAL.w);
 			F.normal = normalize(mat3(transpose(inverse(u_model))) * NORMAL.xyz);
 		}
 	)";	
+	str.replace(
+		str.find("UV_SCALE"),
+		std::string("UV_SCALE").length(),
+		std::to_string(uvScale)
+	);
 	return str;
 }
 
@@ -319,23 +437,29 @@ std::string glsl_deferredAllModelFragment(){
 	return str;
 }
 
-std::string glsl_staticModelShadowVertex(){
+std::string glsl_staticModelShadowVertex(float uvScale){
 	std::string str = R"(
 	layout(location = 0) in vec3 POSITION;
-	layout(location = 1) in vec3 UV_COORD;
+	layout(location = 1) in vec2 UV;
+	layout(location = 2) in vec4 NORMAL;
 
 	out VS_OUT{
 		vec3 uv_coord;
 	} F;
 
-	layout(location = 0) uniform mat4 u_model;
 	layout(location = 1) uniform mat4 u_lightSpace;
 
 	void main(){
+		mat4 u_model = instanceModels[u_firstInstance + gl_InstanceID];
 		gl_Position = u_lightSpace * u_model * vec4(POSITION, 1.0);
-		F.uv_coord = UV_COORD;
+		F.uv_coord = vec3(UV * UV_SCALE, NORMAL.w);
 	}
 	)";	
+	str.replace(
+		str.find("UV_SCALE"),
+		std::string("UV_SCALE").length(),
+		std::to_string(uvScale)
+	);
 	return str;
 }
 
@@ -398,12 +522,13 @@ std::string glsl_allModelShadowGeometry(){
 
 //------------------------------------------------------------------------------------------------------
 
-//Vertex shader program for animated models.
-std::string glsl_deferredAnimatedModelVertex(Uint32 numBones){
+//Vertex shader program for animated models. Packed like static ones, bones are bytes and weights normalized bytes.
+//Joints come from the frame's joint palettes, each instance reading the palette of its own pose.
+std::string glsl_deferredAnimatedModelVertex(float uvScale){
 	std::string str = R"(
 		layout(location = 0) in vec3 POSITION;
-		layout(location = 1) in vec3 UV_COORD;
-		layout(location = 2) in vec3 NORMAL;
+		layout(location = 1) in vec2 UV;
+		layout(location = 2) in vec4 NORMAL;
 		layout(location = 3) in vec4 BONES;
 		layout(location = 4) in vec4 WEIGHTS;
 
@@ -413,45 +538,47 @@ std::string glsl_deferredAnimatedModelVertex(Uint32 numBones){
 			vec3 normal;
 		} F;
 
-		layout(location = 0) uniform mat4 u_model;
-		layout(location = 2) uniform mat4 u_joints[NUM_BONES];
-
 		void main(){
-			
+			mat4 u_model = instanceModels[u_firstInstance + gl_InstanceID];
+			uint pose = instancePoses[u_firstInstance + gl_InstanceID];
+			mat4 joint0 = joints[pose + uint(BONES.r)];
+			mat4 joint1 = joints[pose + uint(BONES.g)];
+			mat4 joint2 = joints[pose + uint(BONES.b)];
+			mat4 joint3 = joints[pose + uint(BONES.a)];
 			vec4 transform = u_model * (
-				u_joints[int(BONES.r)] * vec4(POSITION, 1.0) * WEIGHTS.r +
-				u_joints[int(BONES.g)] * vec4(POSITION, 1.0) * WEIGHTS.g +
-				u_joints[int(BONES.b)] * vec4(POSITION, 1.0) * WEIGHTS.b +
-				u_joints[int(BONES.a)] * vec4(POSITION, 1.0) * WEIGHTS.a
+				joint0 * vec4(POSITION, 1.0) * WEIGHTS.r +
+				joint1 * vec4(POSITION, 1.0) * WEIGHTS.g +
+				joint2 * vec4(POSITION, 1.0) * WEIGHTS.b +
+				joint3 * vec4(POSITION, 1.0) * WEIGHTS.a
 			);
 			
 			vec4 result = projView * transform;
 			gl_Position = result;
 
 			F.position = vec4(transform.rgb/transform.a, result.z);
-			F.uv_coord = UV_COORD;
+			F.uv_coord = vec3(UV * UV_SCALE, NORMAL.w);
 			
 			F.normal = normalize(mat3(transpose(inverse(u_model))) * (
-				mat3(transpose(inverse(u_joints[int(BONES.r)]))) * NORMAL.xyz * WEIGHTS.r +
-				mat3(transpose(inverse(u_joints[int(BONES.g)]))) * NORMAL.xyz * WEIGHTS.g +
-				mat3(transpose(inverse(u_joints[int(BONES.b)]))) * NORMAL.xyz * WEIGHTS.b +
-				mat3(transpose(inverse(u_joints[int(BONES.a)]))) * NORMAL.xyz * WEIGHTS.a
+				mat3(transpose(inverse(joint0))) * NORMAL.xyz * WEIGHTS.r +
+				mat3(transpose(inverse(joint1))) * NORMAL.xyz * WEIGHTS.g +
+				mat3(transpose(inverse(joint2))) * NORMAL.xyz * WEIGHTS.b +
+				mat3(transpose(inverse(joint3))) * NORMAL.xyz * WEIGHTS.a
 			));
 		}
 	)";	
 	str.replace(
-		str.find("NUM_BONES"),
-		std::string("NUM_BONES").length(),
-		std::to_string(numBones)
+		str.find("UV_SCALE"),
+		std::string("UV_SCALE").length(),
+		std::to_string(uvScale)
 	);
 	return str;
 }
 
-std::string glsl_animatedModelShadowVertex(Uint32 numBones){
+std::string glsl_animatedModelShadowVertex(float uvScale){
 	std::string str = R"(
 	layout(location = 0) in vec3 POSITION;
-	layout(location = 1) in vec3 UV_COORD;
-	layout(location = 2) in vec3 NORMAL;
+	layout(location = 1) in vec2 UV;
+	layout(location = 2) in vec4 NORMAL;
 	layout(location = 3) in vec4 BONES;
 	layout(location = 4) in vec4 WEIGHTS;
 
@@ -459,26 +586,25 @@ std::string glsl_animatedModelShadowVertex(Uint32 numBones){
 		vec3 uv_coord;
 	} F;
 
-	layout(location = 0) uniform mat4 u_model;
 	layout(location = 1) uniform mat4 u_lightSpace;
-	layout(location = 2) uniform mat4 u_joints[NUM_BONES];
 
 	void main(){
-		
+		mat4 u_model = instanceModels[u_firstInstance + gl_InstanceID];
+		uint pose = instancePoses[u_firstInstance + gl_InstanceID];
 		vec4 pos = u_model * (
-			u_joints[int(BONES.r)] * vec4(POSITION, 1.0) * WEIGHTS.r +
-			u_joints[int(BONES.g)] * vec4(POSITION, 1.0) * WEIGHTS.g +
-			u_joints[int(BONES.b)] * vec4(POSITION, 1.0) * WEIGHTS.b +
-			u_joints[int(BONES.a)] * vec4(POSITION, 1.0) * WEIGHTS.a
+			joints[pose + uint(BONES.r)] * vec4(POSITION, 1.0) * WEIGHTS.r +
+			joints[pose + uint(BONES.g)] * vec4(POSITION, 1.0) * WEIGHTS.g +
+			joints[pose + uint(BONES.b)] * vec4(POSITION, 1.0) * WEIGHTS.b +
+			joints[pose + uint(BONES.a)] * vec4(POSITION, 1.0) * WEIGHTS.a
 		);
 		gl_Position = u_lightSpace * pos;
-		F.uv_coord = UV_COORD;
+		F.uv_coord = vec3(UV * UV_SCALE, NORMAL.w);
 	}
 	)";	
 	str.replace(
-		str.find("NUM_BONES"),
-		std::string("NUM_BONES").length(),
-		std::to_string(numBones)
+		str.find("UV_SCALE"),
+		std::string("UV_SCALE").length(),
+		std::to_string(uvScale)
 	);
 	return str;
 }
@@ -789,15 +915,22 @@ std::string glsl_deferredLightPassFragment(){
 					//Sunlight
 					result += calcSunlight(sun, position.rgb, normal.rgb, albedo.rgb, V, F0, metalRough, NUM_SUN_CASCADES, u_shadowMap);
 
+					//Only the lights binned into this pixel's cluster can reach it.
+					uvec2 cluster = findCluster(F.uv_coord, position.rgb);
+					uint numPoint = cluster.y & 0xFFFFu;
+					uint numSpot = cluster.y >> 16;
+
 					//Pointlights
-					for(int i=0;i<NLightsGamExp.r;i++){
-						result += calcPointlight(pointlights[i], position.rgb, normal.rgb, albedo.rgb, V, F0, metalRough);
+					for(uint i=0;i<numPoint;i++){
+						uint index = clusterIndices[cluster.x + i];
+						result += calcPointlight(pointlights[index], position.rgb, normal.rgb, albedo.rgb, V, F0, metalRough);
 					}
 
 					offset += NUM_SUN_CASCADES;
 					//Spotlights
-					for(int i=0;i<NLightsGamExp.g;i++){
-						result += calcSpotlight(spotlights[i], offset + i, position.rgb, normal.rgb, albedo.rgb, V, F0, metalRough, u_shadowMap);
+					for(uint i=0;i<numSpot;i++){
+						uint index = clusterIndices[cluster.x + numPoint + i];
+						result += calcSpotlight(spotlights[index], offset + int(index), position.rgb, normal.rgb, albedo.rgb, V, F0, metalRough, u_shadowMap);
 					}
 				}
 				
@@ -11,11 +11,24 @@
 #define UBO_COMMON_BASE 0
 #define UBO_LIGHT_BASE 1
 
+#define SSBO_INSTANCE_BASE 0
+#define SSBO_POINTLIGHT_BASE 1
+#define SSBO_SPOTLIGHT_BASE 2
+#define SSBO_CLUSTER_CELL_BASE 3
+#define SSBO_CLUSTER_INDEX_BASE 4
+#define SSBO_JOINT_BASE 5
+#define SSBO_INSTANCE_POSE_BASE 6
+
 #define SHADOW_BASE 3
 
 #define NUM_SUN_CASCADES 4
-#define MAX_POINTLIGHTS 64
-#define MAX_SPOTLIGHTS 32
+#define MAX_POINTLIGHTS 64	//Default cap on lit pointlights per frame.
+#define MAX_SPOTLIGHTS 32	//Spotlight shadow map layers, caps lit spotlights per frame.
+
+//Light cluster grid: screen tiles times exponential depth slices.
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
 
 //Shader program for hardware accelerated drawing.
 struct Shader{
@@ -46,21 +59,33 @@ std::string glsl_emptyShader();
 //Common uniforms ubo in glsl.
 std::string glsl_commonUniforms();
 
+//Pointlight and spotlight ssbos in glsl.
+std::string glsl_lightBuffers();
+
+//Light cluster lookup in glsl.
+std::string glsl_lightClusters();
+
+//Per instance model matrices in glsl.
+std::string glsl_instanceModels();
+
+//Joint palettes and per instance pose offsets in glsl.
+std::string glsl_instanceJoints();
+
 //Common light structs and ubo in glsl.
 //std::string glsl_commonLightStructs();
 
 //Shader program for static models.
-std::string glsl_deferredStaticModelVertex();
+std::string glsl_deferredStaticModelVertex(float uvScale);
 std::string glsl_deferredAllModelFragment();
 
-std::string glsl_staticModelShadowVertex();
+std::string glsl_staticModelShadowVertex(float uvScale);
 std::string glsl_allModelShadowFragment();
 //std::string glsl_allModelShadowGeometry();
 
 //Shader program for animated models.
-std::string glsl_deferredAnimatedModelVertex(Uint32 numBones);
+std::string glsl_deferredAnimatedModelVertex(float uvScale);
 
-std::string glsl_animatedModelShadowVertex(Uint32 numBones);
+std::string glsl_animatedModelShadowVertex(float uvScale);
 
 //Simple shaders for drawing a screen sized quad.
 std::string glsl_displayQuadVertex();
@@ -0,0 +1,207 @@
+#include "streamer.hpp"
+
+#include <iostream>
+
+//Start the worker threads.
+void AssetStreamer::init(Uint32 numWorkers, Uint32 uploadBudget){
+	this->uploadBudget = uploadBudget;
+	running = true;
+
+	for(unsigned int i=0;i<numWorkers;i++){
+		workers.push_back(std::thread(&AssetStreamer::work, this));
+	}
+}
+
+//Stop the workers and drop whatever was not uploaded yet.
+AssetStreamer::~AssetStreamer(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	wake.notify_all();
+
+	for(unsigned int i=0;i<workers.size();i++){
+		workers[i].join();
+	}
+
+	for(unsigned int i=0;i<uploadQueue.size();i++){
+		release(uploadQueue[i]);
+	}
+}
+
+//Queue a static model.
+void AssetStreamer::load(StaticModel* model, const char* filename){
+	push(ASSET_STATIC_MODEL, model, filename);
+}
+
+//Queue an animated model.
+void AssetStreamer::load(AnimatedModel* model, const char* filename){
+	push(ASSET_ANIMATED_MODEL, model, filename);
+}
+
+//Queue a skeletal animation.
+void AssetStreamer::load(Animation* anim, const char* filename){
+	push(ASSET_ANIMATION, anim, filename);
+}
+
+//Queue a physics mesh.
+void AssetStreamer::load(PhysicsMesh* mesh, const char* filename){
+	push(ASSET_PHYSICS_MESH, mesh, filename);
+}
+
+//Run queued uploads until the frame budget is spent. Call once per frame from the render thread.
+//At least one job runs per call, so assets larger than the budget still get through.
+void AssetStreamer::update(){
+	Uint32 spent = 0;
+	while(spent < uploadBudget){
+		StreamJob job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(uploadQueue.empty()){
+				return;
+			}
+			job = uploadQueue.front();
+			uploadQueue.pop_front();
+		}
+
+		upload(job);
+		release(job);
+		spent += job.size;
+	}
+}
+
+//Block until every queued asset is resident.
+void AssetStreamer::finish(){
+	std::unique_lock<std::mutex> lock(mutex);
+	while(!loadQueue.empty() || !uploadQueue.empty() || numParsing > 0){
+		if(uploadQueue.empty()){
+			parsed.wait(lock);
+			continue;
+		}
+		StreamJob job = uploadQueue.front();
+		uploadQueue.pop_front();
+
+		lock.unlock();
+		upload(job);
+		release(job);
+		lock.lock();
+	}
+}
+
+//Number of queued assets that are not resident yet.
+Uint32 AssetStreamer::pending(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return loadQueue.size() + uploadQueue.size() + numParsing;
+}
+
+//Add a job for the workers.
+void AssetStreamer::push(Uint32 type, void* target, const char* filename){
+	StreamJob job;
+	job.type = type;
+	job.filename = filename;
+	job.target = target;
+	job.loader = nullptr;
+	job.size = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		loadQueue.push_back(job);
+	}
+	wake.notify_one();
+}
+
+//Worker loop. Parses files and hands them to the render thread.
+void AssetStreamer::work(){
+	std::unique_lock<std::mutex> lock(mutex);
+	while(true){
+		wake.wait(lock, [this]{return !running || !loadQueue.empty();});
+		if(!running){
+			return;
+		}
+
+		StreamJob job = loadQueue.front();
+		loadQueue.pop_front();
+		numParsing++;
+
+		lock.unlock();
+		parse(job);
+		lock.lock();
+
+		numParsing--;
+		uploadQueue.push_back(job);
+		parsed.notify_all();
+	}
+}
+
+//Parse the file of a job. Runs on a worker, so no GL calls here.
+void AssetStreamer::parse(StreamJob& job){
+	switch(job.type){
+		case ASSET_STATIC_MODEL:{
+			StaticModelLoader* file = new StaticModelLoader(job.filename.c_str());
+			job.size = file->loaded ? file->mesh.numVertices * file->mesh.vertexSize + file->mesh.numIndices * file->mesh.indexSize + file->texLength + file->metalRoughLength : 0;
+			job.loader = file;
+			break;
+		}
+		case ASSET_ANIMATED_MODEL:{
+			AnimatedModelLoader* file = new AnimatedModelLoader(job.filename.c_str());
+			job.size = file->loaded ? file->mesh.numVertices * file->mesh.vertexSize + file->mesh.numIndices * file->mesh.indexSize + file->texLength + file->metalRoughLength : 0;
+			job.loader = file;
+			break;
+		}
+		case ASSET_ANIMATION:
+			job.loader = new AnimationLoader(job.filename.c_str());
+			break;
+
+		case ASSET_PHYSICS_MESH:
+			job.loader = new PhysicsMeshLoader(job.filename.c_str());
+			break;
+	}
+}
+
+//Move parsed data into the target. Runs on the render thread.
+void AssetStreamer::upload(StreamJob& job){
+	bool loaded = false;
+	switch(job.type){
+		case ASSET_STATIC_MODEL:
+			loaded = ((StaticModel*)job.target)->init(*(StaticModelLoader*)job.loader);
+			break;
+
+		case ASSET_ANIMATED_MODEL:
+			loaded = ((AnimatedModel*)job.target)->init(*(AnimatedModelLoader*)job.loader);
+			break;
+
+		case ASSET_ANIMATION:
+			loaded = ((Animation*)job.target)->init(*(AnimationLoader*)job.loader);
+			break;
+
+		case ASSET_PHYSICS_MESH:
+			loaded = ((PhysicsMesh*)job.target)->init(*(PhysicsMeshLoader*)job.loader);
+			break;
+	}
+
+	if(!loaded){
+		std::cout<<"WARNING: Failed to load "<<job.filename<<"."<<std::endl;
+	}
+}
+
+//Free the parsed file of a job.
+void AssetStreamer::release(StreamJob& job){
+	switch(job.type){
+		case ASSET_STATIC_MODEL:
+			delete (StaticModelLoader*)job.loader;
+			break;
+
+		case ASSET_ANIMATED_MODEL:
+			delete (AnimatedModelLoader*)job.loader;
+			break;
+
+		case ASSET_ANIMATION:
+			delete (AnimationLoader*)job.loader;
+			break;
+
+		case ASSET_PHYSICS_MESH:
+			delete (PhysicsMeshLoader*)job.loader;
+			break;
+	}
+	job.loader = nullptr;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "models.hpp"
+#include "loaders.hpp"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define STREAM_NUM_WORKERS 2
+#define STREAM_UPLOAD_BUDGET (16 * 1024 * 1024)	//Bytes of GL uploads per frame.
+
+#define ASSET_STATIC_MODEL 0
+#define ASSET_ANIMATED_MODEL 1
+#define ASSET_ANIMATION 2
+#define ASSET_PHYSICS_MESH 3
+
+//A queued asset. Parsed by a worker, finished on the render thread.
+struct StreamJob{
+	Uint32 type;			//One of the ASSET_ types.
+	std::string filename;
+	void* target;			//Model, animation or mesh receiving the data.
+	void* loader;			//Parsed file, created by a worker.
+	Uint32 size;			//Bytes to upload, counted against the frame budget.
+};
+
+//Loads assets in the background. Workers parse files and expand palettes,
+//GL uploads are queued and done in update() within a per frame budget.
+//Targets stay non resident until their upload has run.
+struct AssetStreamer{
+	AssetStreamer(){};
+	void init(Uint32 numWorkers = STREAM_NUM_WORKERS, Uint32 uploadBudget = STREAM_UPLOAD_BUDGET);
+	~AssetStreamer();
+
+	void load(StaticModel* model, const char* filename);
+	void load(AnimatedModel* model, const char* filename);
+	void load(Animation* anim, const char* filename);
+	void load(PhysicsMesh* mesh, const char* filename);
+
+	void update();
+	void finish();
+	Uint32 pending();
+
+	private:
+	void push(Uint32 type, void* target, const char* filename);
+	void work();
+	static void parse(StreamJob& job);
+	static void upload(StreamJob& job);
+	static void release(StreamJob& job);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;		//Signals workers about new jobs.
+	std::condition_variable parsed;		//Signals the render thread about parsed jobs.
+	std::deque<StreamJob> loadQueue;	//Waiting for a worker.
+	std::deque<StreamJob> uploadQueue;	//Parsed, waiting for the render thread.
+	Uint32 numParsing = 0;				//Jobs currently held by workers.
+	Uint32 uploadBudget;
+	bool running = false;
+};
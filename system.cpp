@@ -70,16 +70,69 @@ void Camera::updateFrustum(Mat4 invProjView){
 Clock::Clock(){
 	now = SDL_GetPerformanceCounter();
 	prev = now;
-	dt = 1/144;
+	dt = 1.0 / 144;
 }
 
 //Update clock.
 void Clock::update(){
 	now = SDL_GetPerformanceCounter();
-	dt = (now - prev) / SDL_GetPerformanceFrequency();
+	dt = (now - prev) / (double)SDL_GetPerformanceFrequency();
 	prev = now;
 }
 
+//--------------------------------------------------------------------------------------------------------
+
+//Allocate the arena block.
+void FrameArena::init(size_t capacity){
+	this->capacity = capacity;
+	block = (char*)malloc(capacity);
+	offset = 0;
+}
+
+//Free the block and any overflow.
+FrameArena::~FrameArena(){
+	for(unsigned int i=0;i<overflow.size();i++){
+		free(overflow[i]);
+	}
+	free(block);
+}
+
+//Get memory for this frame. Aligned to FRAME_ARENA_ALIGNMENT.
+void* FrameArena::allocate(size_t size){
+	size = (size + FRAME_ARENA_ALIGNMENT - 1) & ~(size_t)(FRAME_ARENA_ALIGNMENT - 1);
+	if(offset + size <= capacity){
+		void* result = block + offset;
+		offset += size;
+		return result;
+	}
+
+	void* result = malloc(size);
+	overflow.push_back(result);
+	overflowSize += size;
+	return result;
+}
+
+//Release everything allocated this frame. Grows the block if the frame overflowed it.
+void FrameArena::reset(){
+	if(overflowSize > 0){
+		for(unsigned int i=0;i<overflow.size();i++){
+			free(overflow[i]);
+		}
+		overflow.clear();
+
+		free(block);
+		capacity += overflowSize;
+		block = (char*)malloc(capacity);
+		overflowSize = 0;
+	}
+	offset = 0;
+}
+
+//Bytes allocated this frame.
+size_t FrameArena::used(){
+	return offset + overflowSize;
+}
+
 //--------------------------------------------------------------------------------------------------------
 /*
 //SDL Window wrapper init.
@@ -7,6 +7,10 @@
 #include "3Dmaths.hpp"
 #include "3Dphysics.hpp"
 
+#include <vector>
+
+#define FRAME_ARENA_ALIGNMENT 16
+
 /*
 //Camera
 struct Camera{
@@ -37,7 +41,29 @@ struct Clock{
 
 	void update();
 
-	float now, prev, dt;
+	Uint64 now, prev;	//Performance counter ticks, kept whole so dt stays exact however long the game runs.
+	float dt;
+};
+
+//Linear allocator for data that only lives for one frame. Allocations bump an offset and
+//are all released by reset(). What does not fit the block is malloc'd, and reset() grows
+//the block by that much, so once the frame sizes settle no frame allocates.
+struct FrameArena{
+	FrameArena(){};
+	void init(size_t capacity);
+	~FrameArena();
+
+	void* allocate(size_t size);
+	void reset();
+
+	size_t used();
+
+	private:
+	char* block = nullptr;
+	size_t capacity = 0;
+	size_t offset = 0;
+	std::vector<void*> overflow;	//Allocations that did not fit the block this frame.
+	size_t overflowSize = 0;
 };
 
 /*
@@ -0,0 +1,62 @@
+//Rewrites .ad files as compressed clips, so loading them skips keyframe reduction and quantization.
+//Files already compressed are left alone.
+//Usage: compress_animations res/*.ad
+
+#include "loaders.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <cstdio>
+
+//Convert one file. The new file is written next to the old one and moved over it when complete.
+static bool convert(std::string filename){
+	AnimationLoader file(filename.c_str());
+	if(!file.loaded){
+		std::cout<<"WARNING: Could not read "<<filename<<", skipped."<<std::endl;
+		return false;
+	}
+	if(file.compressed){
+		std::cout<<filename<<" already compressed."<<std::endl;
+		return true;
+	}
+
+	std::string temporary = filename + ".tmp";
+	std::ofstream out(temporary, std::ios::out|std::ios::binary|std::ios::trunc);
+	Uint32 magic = ANIM_COMPRESSED_MAGIC;
+	out.write((char*)&magic, 4);
+	out.write((char*)&file.numFrames, 4);
+	out.write((char*)&file.numBones, 4);
+	out.write((char*)&file.animRate, 4);
+	out.write((char*)&file.clip.numKeys, 4);
+	out.write((char*)file.clip.numTracks, 12);
+	out.write((char*)&file.clip.size, 4);
+	out.write((char*)file.clip.built, file.clip.size);
+
+	out.close();
+	if(out.fail() || rename(temporary.c_str(), filename.c_str()) != 0){
+		std::cout<<"WARNING: Could not write "<<filename<<"."<<std::endl;
+		remove(temporary.c_str());
+		return false;
+	}
+
+	std::cout<<filename<<" compressed, "<<file.numFrames<<" -> "<<file.clip.numKeys<<" keyframes, "<<file.animLength
+		<<" -> "<<file.clip.size<<" bytes."<<std::endl;
+	return true;
+}
+
+int main(int argc, const char* argv[]){
+	if(argc < 2){
+		std::cout<<"Usage: "<<argv[0]<<" <animation files>"<<std::endl;
+		return 1;
+	}
+
+	int failed = 0;
+	for(int i=1;i<argc;i++){
+		if(!convert(argv[i])){
+			failed++;
+		}
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+//Rewrites .sm and .am files so their diffuse texture is stored as RGBA8 texels instead of an
+//indexed float palette. Files already converted, indexed ones included, are left alone.
+//Usage: convert_textures res/*.sm res/*.am
+
+#include "loaders.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <cstdio>
+
+//Write the parts shared by both model formats.
+static void writeModel(std::ofstream& out, Uint32 attribLength, float* attributes, Uint32 texWidth, Uint32 texHeight,
+	Uint32 texDepth, Uint32 texLength, Uint8* diffuse, Uint32 metalRoughLength, float* metalRough, float* centroid, float cullRadius){
+
+	Uint32 magic = MODEL_PACKED_MAGIC;
+	out.write((char*)&magic, 4);
+
+	out.write((char*)&attribLength, 4);
+	out.write((char*)attributes, attribLength);
+
+	out.write((char*)&texWidth, 4);
+	out.write((char*)&texHeight, 4);
+	out.write((char*)&texDepth, 4);
+
+	out.write((char*)&texLength, 4);
+	out.write((char*)diffuse, texLength);
+
+	out.write((char*)&metalRoughLength, 4);
+	out.write((char*)metalRough, metalRoughLength);
+
+	out.write((char*)centroid, 12);
+	out.write((char*)&cullRadius, 4);
+}
+
+//Convert one file. The new file is written next to the old one and moved over it when complete.
+static bool convert(std::string filename){
+	std::string temporary = filename + ".tmp";
+	std::ofstream out;
+	bool animated = filename.size() > 3 && filename.compare(filename.size() - 3, 3, ".am") == 0;
+
+	if(animated){
+		AnimatedModelLoader file(filename.c_str());
+		if(!file.loaded){
+			std::cout<<"WARNING: Could not read "<<filename<<", skipped."<<std::endl;
+			return false;
+		}
+		if(file.packed){
+			std::cout<<filename<<" already converted."<<std::endl;
+			return true;
+		}
+
+		out.open(temporary, std::ios::out|std::ios::binary|std::ios::trunc);
+		writeModel(out, file.attribLength, file.attributes, file.texWidth, file.texHeight, file.texDepth,
+			file.texLength, file.diffuse, file.metalRoughLength, file.metalRough, file.centroid, file.cullRadius);
+		out.write((char*)&file.numBones, 4);
+	}else{
+		StaticModelLoader file(filename.c_str());
+		if(!file.loaded){
+			std::cout<<"WARNING: Could not read "<<filename<<", skipped."<<std::endl;
+			return false;
+		}
+		if(file.packed){
+			std::cout<<filename<<" already converted."<<std::endl;
+			return true;
+		}
+
+		out.open(temporary, std::ios::out|std::ios::binary|std::ios::trunc);
+		writeModel(out, file.attribLength, file.attributes, file.texWidth, file.texHeight, file.texDepth,
+			file.texLength, file.diffuse, file.metalRoughLength, file.metalRough, file.centroid, file.cullRadius);
+	}
+
+	out.close();
+	if(out.fail() || rename(temporary.c_str(), filename.c_str()) != 0){
+		std::cout<<"WARNING: Could not write "<<filename<<"."<<std::endl;
+		remove(temporary.c_str());
+		return false;
+	}
+
+	std::cout<<filename<<" converted."<<std::endl;
+	return true;
+}
+
+int main(int argc, const char* argv[]){
+	if(argc < 2){
+		std::cout<<"Usage: "<<argv[0]<<" <model files>"<<std::endl;
+		return 1;
+	}
+
+	int failed = 0;
+	for(int i=1;i<argc;i++){
+		if(!convert(argv[i])){
+			failed++;
+		}
+	}
+
+	return failed ? 1 : 0;
+}
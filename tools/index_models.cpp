@@ -0,0 +1,121 @@
+//Rewrites .sm and .am files with indexed, packed vertices, so loading them skips deduplicating and
+//cache ordering the triangles. Static models keep the chunks built at load. Textures are stored as
+//RGBA8 texels like packed files. Files already indexed are left alone.
+//Usage: index_models res/*.sm res/*.am
+
+#include "loaders.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <cstdio>
+
+//Write the indexed vertices of a model. Index data is padded to whole words so what follows stays aligned.
+static void writeMesh(std::ofstream& out, MeshData& mesh){
+	Uint32 magic = MODEL_INDEXED_MAGIC;
+	out.write((char*)&magic, 4);
+
+	out.write((char*)&mesh.vertexSize, 4);
+	out.write((char*)&mesh.numVertices, 4);
+	out.write((char*)mesh.vertices, mesh.numVertices * mesh.vertexSize);
+
+	Uint32 indexLength = mesh.numIndices * mesh.indexSize;
+	Uint32 padding = 0;
+	out.write((char*)&mesh.indexSize, 4);
+	out.write((char*)&mesh.numIndices, 4);
+	out.write((char*)mesh.indices, indexLength);
+	out.write((char*)&padding, ((indexLength + 3) & ~3u) - indexLength);
+
+	out.write((char*)&mesh.uvScale, 4);
+}
+
+//Write the material and bounds, the same in both model formats.
+static void writeMaterial(std::ofstream& out, Uint32 texWidth, Uint32 texHeight, Uint32 texDepth, Uint32 texLength,
+	Uint8* diffuse, Uint32 metalRoughLength, float* metalRough, float* centroid, float cullRadius){
+
+	out.write((char*)&texWidth, 4);
+	out.write((char*)&texHeight, 4);
+	out.write((char*)&texDepth, 4);
+
+	out.write((char*)&texLength, 4);
+	out.write((char*)diffuse, texLength);
+
+	out.write((char*)&metalRoughLength, 4);
+	out.write((char*)metalRough, metalRoughLength);
+
+	out.write((char*)centroid, 12);
+	out.write((char*)&cullRadius, 4);
+}
+
+//Convert one file. The new file is written next to the old one and moved over it when complete.
+static bool convert(std::string filename){
+	std::string temporary = filename + ".tmp";
+	std::ofstream out;
+	bool animated = filename.size() > 3 && filename.compare(filename.size() - 3, 3, ".am") == 0;
+	Uint32 before, after;
+
+	if(animated){
+		AnimatedModelLoader file(filename.c_str());
+		if(!file.loaded){
+			std::cout<<"WARNING: Could not read "<<filename<<", skipped."<<std::endl;
+			return false;
+		}
+		if(file.indexed){
+			std::cout<<filename<<" already indexed."<<std::endl;
+			return true;
+		}
+
+		out.open(temporary, std::ios::out|std::ios::binary|std::ios::trunc);
+		writeMesh(out, file.mesh);
+		writeMaterial(out, file.texWidth, file.texHeight, file.texDepth, file.texLength, file.diffuse,
+			file.metalRoughLength, file.metalRough, file.centroid, file.cullRadius);
+		out.write((char*)&file.numBones, 4);
+		before = file.attribLength;
+		after = file.mesh.numVertices * file.mesh.vertexSize + file.mesh.numIndices * file.mesh.indexSize;
+	}else{
+		StaticModelLoader file(filename.c_str());
+		if(!file.loaded){
+			std::cout<<"WARNING: Could not read "<<filename<<", skipped."<<std::endl;
+			return false;
+		}
+		if(file.indexed){
+			std::cout<<filename<<" already indexed."<<std::endl;
+			return true;
+		}
+
+		out.open(temporary, std::ios::out|std::ios::binary|std::ios::trunc);
+		writeMesh(out, file.mesh);
+		out.write((char*)&file.numChunks, 4);
+		out.write((char*)file.chunks, file.numChunks * sizeof(ModelChunk));
+		writeMaterial(out, file.texWidth, file.texHeight, file.texDepth, file.texLength, file.diffuse,
+			file.metalRoughLength, file.metalRough, file.centroid, file.cullRadius);
+		before = file.attribLength;
+		after = file.mesh.numVertices * file.mesh.vertexSize + file.mesh.numIndices * file.mesh.indexSize;
+	}
+
+	out.close();
+	if(out.fail() || rename(temporary.c_str(), filename.c_str()) != 0){
+		std::cout<<"WARNING: Could not write "<<filename<<"."<<std::endl;
+		remove(temporary.c_str());
+		return false;
+	}
+
+	std::cout<<filename<<" indexed, vertex data "<<before<<" -> "<<after<<" bytes."<<std::endl;
+	return true;
+}
+
+int main(int argc, const char* argv[]){
+	if(argc < 2){
+		std::cout<<"Usage: "<<argv[0]<<" <model files>"<<std::endl;
+		return 1;
+	}
+
+	int failed = 0;
+	for(int i=1;i<argc;i++){
+		if(!convert(argv[i])){
+			failed++;
+		}
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,311 @@
+#include "world.hpp"
+
+//Furthest point of the body's collider.
+Vec3 PhysicsBody::furthest(Vec3 direction){
+	if(type == BODY_SPHERE){
+		return sphere.furthest(direction);
+	}
+	return convex.furthest(direction);
+}
+
+//Box around both ends of the body's sweep.
+AABB PhysicsBody::createBox(){
+	if(type == BODY_SPHERE){
+		return sphere.createBox();
+	}
+	return convex.createBox();
+}
+
+//Center of one end of the sweep.
+Vec3 PhysicsBody::getCenter(unsigned int end){
+	if(type == BODY_SPHERE){
+		return sphere.colliders[end].center;
+	}
+	return convex.positions[end];
+}
+
+//Position the body is moving to.
+Vec3 PhysicsBody::getPosition(){
+	if(type == BODY_SPHERE){
+		return sphere.getNext()->center;
+	}
+	return *convex.getNext();
+}
+
+//Position between the start and the end of the last step's sweep, alpha from 0 to 1.
+Vec3 PhysicsBody::getPosition(float alpha){
+	if(type == BODY_SPHERE){
+		return Vec3::interpolate(sphere.getPrev()->center, sphere.getNext()->center, alpha);
+	}
+	return Vec3::interpolate(*convex.getPrev(), *convex.getNext(), alpha);
+}
+
+//Start a new sweep from where the last one ended.
+void PhysicsBody::swapEnds(){
+	if(type == BODY_SPHERE){
+		sphere.swapSpheres();
+	}else{
+		convex.swapPositions();
+	}
+}
+
+//Sweep the body from its last position by offset.
+void PhysicsBody::advance(Vec3 offset){
+	if(type == BODY_SPHERE){
+		sphere.getNext()->center = sphere.getPrev()->center + offset;
+	}else{
+		*convex.getNext() = *convex.getPrev() + offset;
+	}
+}
+
+//Move both ends of the sweep.
+void PhysicsBody::push(Vec3 offset){
+	if(type == BODY_SPHERE){
+		sphere.getNext()->center = sphere.getNext()->center + offset;
+		sphere.getPrev()->center = sphere.getPrev()->center + offset;
+	}else{
+		*convex.getNext() = *convex.getNext() + offset;
+		*convex.getPrev() = *convex.getPrev() + offset;
+	}
+}
+
+//Take the velocity into the surface off the body, landing it on ground facing up enough.
+void PhysicsBody::respond(Vec3 normal){
+	velocity.x -= velocity.x * fabs(normal.x);
+	velocity.y -= velocity.y * fabs(normal.y);
+	if(normal.z > ANGLE_THRESHOLD && velocity.z < 0){
+		velocity.z = 0;
+		onGround = true;
+	}else if(normal.z < -ANGLE_THRESHOLD && velocity.z > 0){
+		velocity.z = 0;
+	}else{
+		velocity.z -= velocity.z * normal.z * normal.z * 0.03;
+	}
+}
+
+//------------------------------------------------------------------------------------
+
+//World init. Without a job pool steps run on the calling thread alone.
+void PhysicsWorld::init(PhysicsMesh* mesh, JobPool* jobs){
+	this->mesh = mesh;
+	this->jobs = jobs;
+}
+
+//Add a sphere body, stretched vertically by aspect.
+Uint32 PhysicsWorld::addSphere(Vec3 position, float radius, float aspect, float inverseMass){
+	PhysicsBody body;
+	body.type = BODY_SPHERE;
+	body.sphere = SweptSphere(position, radius, aspect);
+	body.inverseMass = inverseMass;
+	bodies.push_back(body);
+	order.push_back(bodies.size() - 1);
+	return bodies.size() - 1;
+}
+
+//Add a convex body. The shape must outlive the world.
+Uint32 PhysicsWorld::addConvex(BoundingConvex* shape, Vec3 position, float inverseMass){
+	PhysicsBody body;
+	body.type = BODY_CONVEX;
+	body.convex = SweptConvex(shape, position);
+	body.inverseMass = inverseMass;
+	bodies.push_back(body);
+	order.push_back(bodies.size() - 1);
+	return bodies.size() - 1;
+}
+
+PhysicsBody& PhysicsWorld::getBody(Uint32 handle){
+	return bodies[handle];
+}
+
+Uint32 PhysicsWorld::numBodies(){
+	return bodies.size();
+}
+
+//Body pairs with overlapping boxes in the last step.
+Uint32 PhysicsWorld::numPairs(){
+	return pairs.size();
+}
+
+//Position to draw a body at, as far between its last two steps as the time not simulated yet.
+Vec3 PhysicsWorld::getDrawPosition(Uint32 handle){
+	return bodies[handle].getPosition(accumulator / PHYSICS_STEP);
+}
+
+//Run the fixed steps that fit in the time built up, at most PHYSICS_MAX_SUBSTEPS. After a frame too slow
+//for that the rest is dropped rather than carried over, so one slow frame does not make the next ones
+//slow too. Returns the steps run.
+Uint32 PhysicsWorld::update(float frameTime){
+	accumulator += frameTime;
+	Uint32 steps = 0;
+	while(accumulator >= PHYSICS_STEP && steps < PHYSICS_MAX_SUBSTEPS){
+		step(PHYSICS_STEP);
+		accumulator -= PHYSICS_STEP;
+		steps++;
+	}
+	if(accumulator >= PHYSICS_STEP){
+		accumulator = fmod(accumulator, PHYSICS_STEP);
+	}
+	return steps;
+}
+
+//Advance every body by delta.
+void PhysicsWorld::step(float delta){
+	this->delta = delta;
+	boxes.resize(bodies.size());
+
+	//Bodies only touch themselves and the level here.
+	if(jobs != nullptr){
+		JobCounter counter;
+		jobs->parallelFor(moveRange, this, bodies.size(), WORLD_BODY_GRAIN, counter);
+		jobs->wait(counter);
+	}else{
+		moveRange(this, 0, bodies.size());
+	}
+
+	findPairs();
+
+	//Queries read the bodies and write their own pair, the pushes come after all of them in pair order.
+	if(jobs != nullptr){
+		JobCounter counter;
+		jobs->parallelFor(pairRange, this, pairs.size(), WORLD_PAIR_GRAIN, counter);
+		jobs->wait(counter);
+	}else{
+		pairRange(this, 0, pairs.size());
+	}
+	for(unsigned int i=0;i<pairs.size();i++){
+		if(pairs[i].hit){
+			resolvePair(pairs[i]);
+		}
+	}
+}
+
+//Move a range of bodies and resolve them against the level.
+void PhysicsWorld::moveRange(void* data, Uint32 first, Uint32 end){
+	PhysicsWorld& world = *(PhysicsWorld*)data;
+	for(unsigned int i=first;i<end;i++){
+		PhysicsBody& body = world.bodies[i];
+		body.swapEnds();
+		body.onGround = false;
+		if(body.inverseMass > 0){
+			body.velocity.z += GRAVITY * world.delta;
+			body.velocity.z = fmin(body.velocity.z, 50.0);
+		}
+		body.advance(body.velocity * world.delta);
+
+		if(world.mesh != nullptr && world.mesh->resident){
+			world.collideLevel(body);
+		}
+		world.boxes[i] = body.createBox();
+	}
+}
+
+//Resolve a body against the level's convexes near it, skipping the ones the cache shows out of reach.
+//Queries try the last separating axis, then start from the velocity as the first one would, and climbs on
+//large convexes start from the last vertex found. None of it changes a result, so the step depends only on
+//the bodies.
+void PhysicsWorld::collideLevel(PhysicsBody& body){
+	Vec3 initDir = Vec3::cross(Vec3::normalize(Vec3(body.velocity.x+0.01, body.velocity.y, 0.0)), Vec3(0.0, 0.0, 1.0));
+
+	AABB box = body.createBox();
+	box.expand(BROADPHASE_MARGIN);
+	mesh->tree.query(box, body.candidates);
+
+	for(unsigned int i=0;i<body.candidates.size();i++){
+		BoundingConvex& convex = mesh->convexes[body.candidates[i]];
+		CachedContact& cached = body.contactCache.find(convex);
+		if(cached.separated(body.getCenter(0), body.getCenter(1))){
+			continue;
+		}
+		cached.anchor(body.getCenter(0), body.getCenter(1));
+
+		float distance = 0.0;
+		Vec3 normal(0.0, 0.0, 0.0);
+		bool hit;
+		if(convex.neighbors != nullptr){
+			WarmConvex warm(convex, cached.vertex);
+			hit = gjk(body, warm, normal, distance, initDir, cached.gjk);
+		}else{
+			hit = gjk(body, convex, normal, distance, initDir, cached.gjk);
+		}
+		if(hit){
+			body.respond(normal);
+			body.push(normal * distance);
+		}
+	}
+}
+
+//Sort the bodies along x by the low end of their boxes and sweep for boxes overlapping on every axis.
+//The order is kept between steps, so insertion sort has little to move. Pairs come out in the same order
+//for the same bodies, whatever ran the step.
+void PhysicsWorld::findPairs(){
+	for(unsigned int i=1;i<order.size();i++){
+		Uint32 body = order[i];
+		float x = boxes[body].min.x;
+		unsigned int j = i;
+		while(j > 0 && boxes[order[j - 1]].min.x > x){
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = body;
+	}
+
+	pairs.clear();
+	for(unsigned int i=0;i<order.size();i++){
+		Uint32 a = order[i];
+		AABB& boxA = boxes[a];
+		for(unsigned int j=i+1;j<order.size() && boxes[order[j]].min.x <= boxA.max.x;j++){
+			Uint32 b = order[j];
+			if(bodies[a].inverseMass == 0 && bodies[b].inverseMass == 0){
+				continue;
+			}
+			if(AABB::intersect(boxA, boxes[b])){
+				BodyPair pair;
+				pair.a = std::min(a, b);
+				pair.b = std::max(a, b);
+				pair.hit = false;
+				pairs.push_back(pair);
+			}
+		}
+	}
+}
+
+//Run GJK / EPA on a range of pairs.
+void PhysicsWorld::pairRange(void* data, Uint32 first, Uint32 end){
+	PhysicsWorld& world = *(PhysicsWorld*)data;
+	for(unsigned int i=first;i<end;i++){
+		BodyPair& pair = world.pairs[i];
+		PhysicsBody& a = world.bodies[pair.a];
+		PhysicsBody& b = world.bodies[pair.b];
+		Vec3 initDir = a.getPosition() - b.getPosition();
+		if(initDir.length() == 0){
+			initDir = Vec3(1, 0, 0);
+		}
+		pair.distance = 0.0;
+		pair.hit = gjk(a, b, pair.normal, pair.distance, initDir);
+	}
+}
+
+//Push a touching pair apart by their inverse masses and take their closing speed along the contact.
+void PhysicsWorld::resolvePair(BodyPair& pair){
+	PhysicsBody& a = bodies[pair.a];
+	PhysicsBody& b = bodies[pair.b];
+	float total = a.inverseMass + b.inverseMass;
+	if(total <= 0){
+		return;
+	}
+	float shareA = a.inverseMass / total;
+	float shareB = b.inverseMass / total;
+	a.push(pair.normal * (pair.distance * shareA));
+	b.push(pair.normal * (-pair.distance * shareB));
+
+	float closing = Vec3::dot(a.velocity - b.velocity, pair.normal);
+	if(closing < 0){
+		a.velocity = a.velocity - pair.normal * (closing * shareA);
+		b.velocity = b.velocity + pair.normal * (closing * shareB);
+	}
+	if(pair.normal.z > ANGLE_THRESHOLD){
+		a.onGround = true;
+	}else if(pair.normal.z < -ANGLE_THRESHOLD){
+		b.onGround = true;
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "3Dmaths.hpp"
+#include "3Dphysics.hpp"
+#include "models.hpp"
+#include "jobs.hpp"
+
+#include <vector>
+
+#define GRAVITY -9.81 * 2
+#define ANGLE_THRESHOLD 0.7
+#define BROADPHASE_MARGIN 0.5
+
+#define BODY_SPHERE 0
+#define BODY_CONVEX 1
+
+#define PHYSICS_STEP (1.0f / 120.0f)	//Time every step simulates, whatever the frame rate.
+#define PHYSICS_MAX_SUBSTEPS 8			//Steps a frame may run. Time past that is dropped, slowing the world down.
+
+#define WORLD_BODY_GRAIN 16		//Bodies per job moving and colliding with the level.
+#define WORLD_PAIR_GRAIN 64		//Body pairs per narrow phase job.
+
+//A moving body, swept from its last position to its next one each step.
+struct PhysicsBody{
+	PhysicsBody(){};
+	~PhysicsBody(){};
+
+	Vec3 furthest(Vec3 direction);
+	AABB createBox();
+	Vec3 getCenter(unsigned int end);
+	Vec3 getPosition();
+	Vec3 getPosition(float alpha);
+	void swapEnds();
+	void advance(Vec3 offset);
+	void push(Vec3 offset);
+	void respond(Vec3 normal);
+
+	Uint8 type;
+	SweptSphere sphere;			//Collider of sphere bodies.
+	SweptConvex convex;			//Collider of convex bodies.
+	Vec3 velocity;
+	float inverseMass;			//0 for bodies nothing pushes.
+	bool onGround = false;
+
+	ContactCache contactCache;	//Last queries on the level's convexes.
+	std::vector<Uint32> candidates;
+};
+
+//Two bodies whose boxes overlap, and their contact once the narrow phase ran.
+struct BodyPair{
+	Uint32 a, b;
+	bool hit;
+	Vec3 normal;				//Pushes a out of b.
+	float distance;
+};
+
+//Bodies moving through a level. Frames feed their time to update, which runs as many steps of PHYSICS_STEP
+//as have built up. Drawing places bodies between the last two steps by the time left over, so motion is
+//smooth at any frame rate. Each step moves every body and resolves it against the level, finds
+//overlapping bodies by sweep and prune, then runs GJK / EPA on the pairs and pushes them apart.
+//Moving and the pair queries run on the job pool. Every job writes only its own bodies or pairs and the
+//pushes between bodies are applied in pair order on the calling thread, so results do not depend on
+//how many threads there are. Contact caches only skip queries that would find nothing, so a step depends
+//on the bodies alone, not on what earlier steps cached.
+struct PhysicsWorld{
+	PhysicsWorld(){};
+	void init(PhysicsMesh* mesh, JobPool* jobs = nullptr);
+	~PhysicsWorld(){};
+
+	Uint32 addSphere(Vec3 position, float radius, float aspect, float inverseMass = 1.0);
+	Uint32 addConvex(BoundingConvex* shape, Vec3 position, float inverseMass = 1.0);
+	PhysicsBody& getBody(Uint32 handle);
+	Uint32 numBodies();
+	Uint32 numPairs();
+	Vec3 getDrawPosition(Uint32 handle);
+
+	Uint32 update(float frameTime);
+	void step(float delta);
+
+	private:
+	static void moveRange(void* data, Uint32 first, Uint32 end);
+	static void pairRange(void* data, Uint32 first, Uint32 end);
+	void collideLevel(PhysicsBody& body);
+	void findPairs();
+	void resolvePair(BodyPair& pair);
+
+	std::vector<PhysicsBody> bodies;
+	std::vector<AABB> boxes;	//Swept box of every body this step.
+	std::vector<Uint32> order;	//Bodies by the low x of their boxes, nearly sorted from the last step.
+	std::vector<BodyPair> pairs;
+	PhysicsMesh* mesh = nullptr;
+	JobPool* jobs = nullptr;
+	float delta = 0.0;
+	float accumulator = 0.0;	//Frame time not simulated yet, less than a step after update.
+};